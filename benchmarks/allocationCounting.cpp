@@ -0,0 +1,35 @@
+#include "../src/allocations.hpp"
+#include <benchmark/benchmark.h>
+#include <optional>
+
+// Reports the cv::Mat allocations of every benchmark, Google Benchmark runs each of them once more
+// with the manager attached and adds allocs_per_iter and max_bytes_used to the results.
+namespace {
+class MatMemoryManager : public benchmark::MemoryManager {
+public:
+  void Start() override { measurement.emplace(); }
+
+  void Stop(Result &result) override {
+    allocations::Counters counters = measurement->stop();
+    measurement.reset();
+    result.num_allocs = static_cast<int64_t>(counters.count);
+    result.max_bytes_used = counters.peak;
+    result.total_allocated_bytes = static_cast<int64_t>(counters.bytes);
+    result.net_heap_growth = counters.growth;
+  }
+
+  // older versions of Google Benchmark only call this one
+  void Stop(Result *result) { Stop(*result); }
+
+private:
+  std::optional<allocations::Measurement> measurement;
+};
+
+MatMemoryManager memoryManager;
+
+const bool registered = []() {
+  allocations::install();
+  benchmark::RegisterMemoryManager(&memoryManager);
+  return true;
+}();
+} // namespace
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "../src/perfCounters.hpp"
+#include "../src/syntheticImages.hpp"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <opencv2/opencv.hpp>
+#include <tuple>
+
+// kinds of images the kernels are measured on, their content affects e.g. LUTs' cache hits
+// and the number of skeletonization iterations
+const synthetic::Kind CONTENTS[] = {synthetic::Kind::Noise, synthetic::Kind::Gradient,
+                                    synthetic::Kind::TextEdges, synthetic::Kind::BinaryBlobs};
+
+// square-ish image with `megapixels` million pixels, the last generated one is kept
+// so that all arguments of a benchmark with the same image don't generate it again
+inline const cv::Mat &benchmarkImage(int megapixels, int channels, int content) {
+  static std::tuple<int, int, int> cachedKey{-1, -1, -1};
+  static cv::Mat cached;
+
+  auto key = std::make_tuple(megapixels, channels, content);
+  if (key == cachedKey)
+    return cached;
+
+  synthetic::Spec spec;
+  spec.kind = CONTENTS[content];
+  spec.size.width = static_cast<int>(std::sqrt(megapixels * 1e6 * 4 / 3));
+  spec.size.height = static_cast<int>(megapixels * 1e6 / spec.size.width);
+  spec.channels = channels;
+  spec.seed = 42;
+
+  cached.release();
+  cached = synthetic::generate(spec);
+  cachedKey = key;
+  return cached;
+}
+
+inline const cv::Mat &benchmarkImage(const benchmark::State &state) {
+  return benchmarkImage(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)),
+                        static_cast<int>(state.range(2)));
+}
+
+// every image size, channel count and content type
+inline void allImages(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"MP", "channels", "content"});
+  b->ArgsProduct({{1, 10, 100}, {1, 3}, {0, 1, 2, 3}});
+  b->Unit(benchmark::kMillisecond);
+  b->UseRealTime();
+}
+
+// the same for kernels taking seconds per call even on small images
+inline void smallImages(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"MP", "channels", "content"});
+  b->ArgsProduct({{1, 10}, {1, 3}, {0, 1, 2, 3}});
+  b->Unit(benchmark::kMillisecond);
+  b->UseRealTime();
+}
+
+inline void setProcessed(benchmark::State &state, const cv::Mat &mat) {
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(mat.total()));
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(mat.total() * mat.elemSize()));
+  state.SetLabel(synthetic::toString(CONTENTS[state.range(2)]));
+}
+
+// Adds hardware counters of the benchmark loop to the results, per pixel where it makes sense:
+// IPC (instructions per cycle), cycles/px, memBytes/px (cache lines loaded from the memory) and
+// branchMisses/px. Counters that aren't available are left out, and as only the benchmark's
+// own thread is counted they cover a part of the work for kernels running in parallel.
+class HardwareCounters {
+public:
+  HardwareCounters(benchmark::State &state, std::size_t pixels)
+      : state(state), pixels(pixels), start(perfCounters::read()) {}
+
+  ~HardwareCounters() {
+    perfCounters::Sample counted = perfCounters::difference(start, perfCounters::read());
+    const auto total = static_cast<std::uint64_t>(state.iterations()) * pixels;
+    if (total == 0)
+      return;
+    if (auto ipc = counted.ipc())
+      state.counters["IPC"] = ipc.value();
+    if (counted.cycles)
+      state.counters["cycles/px"] = static_cast<double>(counted.cycles.value()) / total;
+    if (auto bytes = counted.memoryBytesPerPixel(total))
+      state.counters["memBytes/px"] = bytes.value();
+    if (counted.branchMisses)
+      state.counters["branchMisses/px"] = static_cast<double>(counted.branchMisses.value()) / total;
+  }
+  HardwareCounters(const HardwareCounters &) = delete;
+  HardwareCounters &operator=(const HardwareCounters &) = delete;
+
+private:
+  benchmark::State &state;
+  std::size_t pixels;
+  perfCounters::Sample start;
+};
@@ -0,0 +1,65 @@
+#include "../src/UI/dialogs/PreviewCache.hpp"
+#include "../src/operations.hpp"
+#include "benchmarkImages.hpp"
+
+// Dialogs recompute the preview for every change of a parameter, unless it's found in
+// the PreviewCache, and return the last preview when accepted if the parameters didn't change.
+// These compare the cost of the lookups with recomputing the result.
+namespace {
+using BlurParams = std::tuple<int, int, double>;
+using MaskParams = std::tuple<cv::Mat, int>;
+
+cv::Mat sharpenMask() { return (cv::Mat_<char>(3, 3) << 0, -1, 0, -1, 5, -1, 0, -1, 0); }
+
+void BM_previewRecompute(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(operations::blurGaussian(mat, 5, cv::BORDER_REFLECT_101, 1.5));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_previewRecompute)
+    ->ArgNames({"MP", "channels", "content"})
+    ->ArgsProduct({{1, 10, 100}, {1, 3}, {0}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// going back to parameters that were already previewed, with other previews in the cache
+void BM_previewCacheHit(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  PreviewCache<BlurParams> cache;
+  for (int k : {1, 3, 5, 7})
+    cache.insert({k, cv::BORDER_REFLECT_101, 1.5}, mat);
+  int k = 1;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cache.find({k, cv::BORDER_REFLECT_101, 1.5}));
+    k = k == 7 ? 1 : k + 2;
+  }
+}
+BENCHMARK(BM_previewCacheHit)
+    ->ArgNames({"MP", "channels", "content"})
+    ->Args({1, 1, 0});
+
+// masks are compared by their contents
+void BM_previewCacheMaskHit(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  PreviewCache<MaskParams> cache;
+  cache.insert({cv::Mat::ones(3, 3, CV_8S), cv::BORDER_REFLECT_101}, mat);
+  cache.insert({sharpenMask(), cv::BORDER_REFLECT_101}, mat);
+  const MaskParams key{sharpenMask(), cv::BORDER_REFLECT_101};
+  for (auto _ : state)
+    benchmark::DoNotOptimize(cache.find(key));
+}
+BENCHMARK(BM_previewCacheMaskHit)
+    ->ArgNames({"MP", "channels", "content"})
+    ->Args({1, 1, 0});
+
+// the check done when a dialog is accepted before returning the last preview
+void BM_acceptReusesPreview(benchmark::State &state) {
+  const MaskParams shown{sharpenMask(), cv::BORDER_REFLECT_101};
+  const MaskParams accepted{sharpenMask(), cv::BORDER_REFLECT_101};
+  for (auto _ : state)
+    benchmark::DoNotOptimize(PreviewCacheUtils::tupleEquals(shown, accepted));
+}
+BENCHMARK(BM_acceptReusesPreview);
+} // namespace
@@ -0,0 +1,220 @@
+#include "../src/autoThreshold.hpp"
+#include "../src/cpuDispatch.hpp"
+#include "../src/imageProcessor.hpp"
+#include "../src/integralHistogram.hpp"
+#include "../src/operations.hpp"
+#include "../src/pipeline.hpp"
+#include "../src/roiMeasurement.hpp"
+#include "benchmarkImages.hpp"
+
+namespace {
+// results of different levels can only be compared when it's known which one they were run with
+const bool isaRecorded = []() {
+  benchmark::AddCustomContext("isa", cpuDispatch::name(cpuDispatch::active()));
+  return true;
+}();
+
+void BM_histogram(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::histogram(mat));
+  setProcessed(state, mat);
+}
+// histograms are only computed for grayscale images
+BENCHMARK(BM_histogram)
+    ->ArgNames({"MP", "channels", "content"})
+    ->ArgsProduct({{1, 10, 100}, {1}, {0, 1, 2, 3}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void BM_channelHistograms(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::channelHistograms(mat));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_channelHistograms)->Apply(allImages);
+
+void BM_sampleHistograms(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::sampleHistograms(mat));
+  state.SetLabel(synthetic::toString(CONTENTS[state.range(2)]));
+}
+BENCHMARK(BM_sampleHistograms)->Apply(allImages);
+
+void BM_integralHistogramBuild(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(IntegralHistogram(mat));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_integralHistogramBuild)->Apply(allImages);
+
+// a region of half the image's width and height not aligned to the tiles, compare with
+// BM_channelHistograms of a quarter of the image
+void BM_integralHistogramQuery(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  IntegralHistogram index(mat);
+  cv::Rect region(mat.cols / 4 + 5, mat.rows / 4 + 7, mat.cols / 2, mat.rows / 2);
+  for (auto _ : state)
+    benchmark::DoNotOptimize(index.histograms(region));
+  state.SetLabel(synthetic::toString(CONTENTS[state.range(2)]));
+}
+BENCHMARK(BM_integralHistogramQuery)->Apply(allImages)->Unit(benchmark::kMicrosecond);
+
+// a 100 x 100 grid of rectangles covering the whole image
+void BM_measureRoiGrid(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  std::vector<roi::Roi> rois = roi::grid(cv::Rect(0, 0, mat.cols, mat.rows), 100, 100);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(roi::measure(mat, rois));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_measureRoiGrid)->Apply(allImages);
+
+// every method picking thresholds from known histograms, which is what switching between them
+// in the dialog costs
+void BM_autoThresholdMethods(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  std::vector<std::vector<int>> hists = imageProcessor::channelHistograms(mat);
+  for (auto _ : state)
+    for (autoThreshold::Method method : autoThreshold::METHODS)
+      benchmark::DoNotOptimize(autoThreshold::thresholds(hists, method));
+  state.SetLabel(synthetic::toString(CONTENTS[state.range(2)]));
+}
+BENCHMARK(BM_autoThresholdMethods)->Apply(smallImages)->Unit(benchmark::kMicrosecond);
+
+void BM_multiOtsu(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  std::vector<std::vector<int>> hists = imageProcessor::channelHistograms(mat);
+  for (auto _ : state)
+    for (const std::vector<int> &hist : hists)
+      benchmark::DoNotOptimize(autoThreshold::multiOtsu(hist, 4));
+  state.SetLabel(synthetic::toString(CONTENTS[state.range(2)]));
+}
+BENCHMARK(BM_multiOtsu)->Apply(smallImages)->Unit(benchmark::kMicrosecond);
+
+// a histogram pass and a compare pass
+void BM_thresholdOtsu(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(operations::thresholdOtsu(mat));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_thresholdOtsu)->Apply(allImages);
+
+void BM_applyLUTcv(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  const imageProcessor::LUT lut = imageProcessor::negate();
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::applyLUTcv(mat, lut));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_applyLUTcv)->Apply(allImages);
+
+void BM_equalizeChannels(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::equalizeChannels(mat));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_equalizeChannels)->Apply(allImages);
+
+// edge detection mask sums up to 0 and goes straight to filter2D,
+// the blurring one has to be normalized in floating point
+void BM_convolveEdges(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  const cv::Mat kernel = (cv::Mat_<char>(3, 3) << -1, -1, -1, 0, 0, 0, 1, 1, 1);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::convolve(mat, kernel, cv::BORDER_REFLECT_101));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_convolveEdges)->Apply(allImages);
+
+void BM_convolveNormalized(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  const cv::Mat kernel = (cv::Mat_<char>(3, 3) << 1, 2, 1, 2, 4, 2, 1, 2, 1);
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::convolve(mat, kernel, cv::BORDER_REFLECT_101));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_convolveNormalized)->Apply(allImages);
+
+void BM_skeletonize(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  const cv::Mat element = cv::getStructuringElement(cv::MORPH_CROSS, {3, 3});
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::skeletonize(mat, element, cv::BORDER_CONSTANT));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_skeletonize)->Apply(smallImages);
+
+void BM_affineTransform(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  const float w = static_cast<float>(mat.cols), h = static_cast<float>(mat.rows);
+  const std::vector<cv::Point2f> src{{0, 0}, {w, 0}, {0, h}};
+  const std::vector<cv::Point2f> dst{{w * 0.1f, h * 0.05f}, {w * 0.9f, h * 0.1f}, {0, h * 0.9f}};
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(imageProcessor::affineTransform(mat, src, dst));
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_affineTransform)->Apply(allImages);
+
+// blur -> convolve -> threshold -> LUT run step by step and fused into tiles
+Pipeline fusablePipeline() {
+  const cv::Mat kernel = (cv::Mat_<char>(3, 3) << 0, -1, 0, -1, 5, -1, 0, -1, 0);
+  Pipeline pipeline;
+  pipeline.append({"blurGaussian", ParamCodec::encodeParams(std::make_tuple(5, 4, 1.5))});
+  pipeline.append({"convolve", ParamCodec::encodeParams(std::make_tuple(kernel, 4))});
+  pipeline.append({"thresholdManual", ParamCodec::encodeParams(std::make_tuple(128))});
+  pipeline.append({"negate", {}});
+  return pipeline;
+}
+
+void BM_pipelineStepByStep(benchmark::State &state) {
+  const ImageWrapper image(benchmarkImage(state));
+  const Pipeline pipeline = fusablePipeline();
+  HardwareCounters counters(state, image.getMat().total());
+  for (auto _ : state) {
+    std::optional<ImageWrapper> current;
+    for (const PipelineStep &step : pipeline.getSteps()) {
+      Pipeline single;
+      single.append(step);
+      current = single.apply(current.has_value() ? current.value() : image);
+    }
+    benchmark::DoNotOptimize(current->getMat().data);
+  }
+  setProcessed(state, image.getMat());
+}
+BENCHMARK(BM_pipelineStepByStep)
+    ->ArgNames({"MP", "channels", "content"})
+    ->ArgsProduct({{1, 10, 100}, {1}, {0}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void BM_pipelineFused(benchmark::State &state) {
+  const ImageWrapper image(benchmarkImage(state));
+  const Pipeline pipeline = fusablePipeline();
+  HardwareCounters counters(state, image.getMat().total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(pipeline.apply(image).getMat().data);
+  setProcessed(state, image.getMat());
+}
+BENCHMARK(BM_pipelineFused)
+    ->ArgNames({"MP", "channels", "content"})
+    ->ArgsProduct({{1, 10, 100}, {1}, {0}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+} // namespace
@@ -0,0 +1,50 @@
+#include "../src/imageWrapper.hpp"
+#include "benchmarkImages.hpp"
+
+namespace {
+// conversions between colour spaces only make sense for colour images,
+// except for the conversion to RGB which also accepts grayscale ones
+void colourImages(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"MP", "channels", "content"});
+  b->ArgsProduct({{1, 10, 100}, {3}, {0, 1, 2, 3}});
+  b->Unit(benchmark::kMillisecond);
+  b->UseRealTime();
+}
+
+template <ImageWrapper (ImageWrapper::*convert)() const>
+void BM_convert(benchmark::State &state) {
+  const ImageWrapper image(benchmarkImage(state));
+  HardwareCounters counters(state, image.getMat().total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize((image.*convert)().getMat().data);
+  setProcessed(state, image.getMat());
+}
+BENCHMARK_TEMPLATE(BM_convert, &ImageWrapper::toRGB)->Apply(allImages);
+BENCHMARK_TEMPLATE(BM_convert, &ImageWrapper::toGrayscale)->Apply(colourImages);
+BENCHMARK_TEMPLATE(BM_convert, &ImageWrapper::toHSV)->Apply(colourImages);
+BENCHMARK_TEMPLATE(BM_convert, &ImageWrapper::toLab)->Apply(colourImages);
+
+// generating an image to display involves converting it to RGB first, so every format is measured
+void BM_generateQImage(benchmark::State &state) {
+  const cv::Mat &mat = benchmarkImage(state);
+  ImageWrapper image(mat);
+  switch (state.range(3)) {
+  case 1:
+    image = image.toHSV();
+    break;
+  case 2:
+    image = image.toLab();
+    break;
+  }
+  HardwareCounters counters(state, mat.total());
+  for (auto _ : state)
+    benchmark::DoNotOptimize(image.generateQImage().constBits());
+  setProcessed(state, mat);
+}
+BENCHMARK(BM_generateQImage)
+    ->ArgNames({"MP", "channels", "content", "format"})
+    ->ArgsProduct({{1, 10, 100}, {1}, {0, 1, 2, 3}, {0}})
+    ->ArgsProduct({{1, 10, 100}, {3}, {0, 1, 2, 3}, {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+} // namespace
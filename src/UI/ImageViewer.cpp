@@ -20,11 +20,36 @@ ImageViewer::ImageViewer(QWidget *parent) : QGraphicsView(parent), zoomFactor(1.
 }
 
 void ImageViewer::setImage(const QPixmap &pixmap) {
+  // the scene deletes the line and the rectangle along with everything else
   scene.clear();
+  lineItem = nullptr;
+  firstPointItem = secondPointItem = nullptr;
+  roiItem = nullptr;
+  polygonItem = overlayItem = nullptr;
   imageItem = scene.addPixmap(pixmap);
   imageItem->setZValue(0);
   scene.setSceneRect(pixmap.rect());
   cancelGetLineFromUser();
+  cancelGetPolygonFromUser();
+  drawOverlay();
+}
+
+void ImageViewer::setImagePart(const QPixmap &pixmap, const QRectF &target,
+                               const QSizeF &imageSize) {
+  if (imageItem == nullptr) {
+    imageItem = scene.addPixmap(pixmap);
+    imageItem->setZValue(0);
+  } else {
+    imageItem->setPixmap(pixmap);
+  }
+  imageItem->setPos(target.topLeft());
+  imageItem->setTransform(QTransform::fromScale(target.width() / pixmap.width(),
+                                                target.height() / pixmap.height()));
+  scene.setSceneRect(QRectF(QPointF(0, 0), imageSize));
+}
+
+QRectF ImageViewer::getVisibleImageRect() const {
+  return mapToScene(viewport()->rect()).boundingRect() & scene.sceneRect();
 }
 
 void ImageViewer::useImageTransform(const ImageViewer &other) {
@@ -35,22 +60,46 @@ void ImageViewer::useImageTransform(const ImageViewer &other) {
 
 void ImageViewer::fit() {
   if (imageItem) {
-    QRectF bounds = imageItem->boundingRect();
-    scene.setSceneRect(bounds);
+    // scene is always as big as the whole image, even if just a part of it is rendered
+    QRectF bounds = scene.sceneRect();
     setSceneRect(bounds);
-    fitInView(imageItem, Qt::KeepAspectRatio);
+    fitInView(bounds, Qt::KeepAspectRatio);
+    emit visibleAreaChanged();
   }
 }
 
-void ImageViewer::clear() { scene.clear(); }
+void ImageViewer::clear() {
+  scene.clear();
+  imageItem = nullptr;
+  lineItem = nullptr;
+  firstPointItem = secondPointItem = nullptr;
+  roiItem = nullptr;
+  polygonItem = overlayItem = nullptr;
+}
 
-QPixmap ImageViewer::getImage() const { return imageItem->pixmap(); }
+QPixmap ImageViewer::getImage() const { return imageItem ? imageItem->pixmap() : QPixmap(); }
 
 void ImageViewer::wheelEvent(QWheelEvent *event) {
   if (event->angleDelta().y() > 0)
     scale(zoomFactor, zoomFactor); // zoom in
   else
     scale(1 / zoomFactor, 1 / zoomFactor); // zoom out
+  emit visibleAreaChanged();
+}
+
+void ImageViewer::scrollContentsBy(int dx, int dy) {
+  QGraphicsView::scrollContentsBy(dx, dy);
+  emit visibleAreaChanged();
+}
+
+void ImageViewer::resizeEvent(QResizeEvent *event) {
+  QGraphicsView::resizeEvent(event);
+  emit visibleAreaChanged();
+}
+
+void ImageViewer::paintEvent(QPaintEvent *event) {
+  QGraphicsView::paintEvent(event);
+  emit painted();
 }
 
 QGraphicsEllipseItem *ImageViewer::drawPoint(QPointF point, const double radius, //
@@ -68,15 +117,13 @@ const QBrush brush = QBrush(Qt::SolidPattern);
 } // namespace
 
 QPointF ImageViewer::getPosInImage(QMouseEvent *event) {
-  QPointF scenePos = mapToScene(event->pos());
-  QPointF imagePos = imageItem->mapFromScene(scenePos);
-  return imagePos;
+  // the scene spans exactly the image, so they share coordinates
+  return mapToScene(event->pos());
 }
 
 void ImageViewer::mousePressEvent(QMouseEvent *event) {
   if (selectingLine && event->button() == Qt::LeftButton) {
-    QPointF scenePos = mapToScene(event->pos());
-    QPointF imagePos = imageItem->mapFromScene(scenePos);
+    QPointF imagePos = mapToScene(event->pos());
 
     if (firstPoint.isNull()) {
       firstPoint = imagePos;
@@ -92,6 +139,16 @@ void ImageViewer::mousePressEvent(QMouseEvent *event) {
       emit lineSelected(line);
       cancelGetLineFromUser();
     }
+  } else if (selectingPolygon) {
+    if (event->button() == Qt::LeftButton) {
+      QPointF imagePos = mapToScene(event->pos());
+      polygonPoints.emplace_back(imagePos.x(), imagePos.y());
+      drawPolygon();
+    } else if (event->button() == Qt::RightButton && polygonPoints.size() >= 3) {
+      std::vector<cv::Point> polygon = std::move(polygonPoints);
+      cancelGetPolygonFromUser();
+      emit polygonSelected(polygon);
+    }
   } else if (selectingROI) {
     origin = event->pos();
     rubberBand->setGeometry(QRect(origin, QSize()));
@@ -113,8 +170,8 @@ void ImageViewer::mouseReleaseEvent(QMouseEvent *event) {
   if (selectingROI) {
     rubberBand->hide();
     QRect selected = rubberBand->geometry();
-    QPointF topLeftQPoint = imageItem->mapFromScene(mapToScene(selected.topLeft()));
-    QPointF bottomRightQPoint = imageItem->mapFromScene(mapToScene(selected.bottomRight()));
+    QPointF topLeftQPoint = mapToScene(selected.topLeft());
+    QPointF bottomRightQPoint = mapToScene(selected.bottomRight());
     QPen pen = QPen(Qt::red, 5);
     QBrush brush = QBrush(Qt::BrushStyle::NoBrush);
 
@@ -180,3 +237,51 @@ void ImageViewer::clearROI() {
     roiItem = nullptr;
   }
 }
+
+void ImageViewer::getPolygonFromUser() {
+  cancelGetPolygonFromUser();
+  setDragMode(QGraphicsView::NoDrag);
+  selectingPolygon = true;
+}
+
+void ImageViewer::cancelGetPolygonFromUser() {
+  selectingPolygon = false;
+  polygonPoints.clear();
+  drawPolygon();
+  setDragMode(QGraphicsView::ScrollHandDrag);
+}
+
+void ImageViewer::drawPolygon() {
+  if (polygonItem != nullptr) {
+    scene.removeItem(polygonItem);
+    delete polygonItem;
+    polygonItem = nullptr;
+  }
+  if (polygonPoints.empty())
+    return;
+  QPainterPath path(QPointF(polygonPoints[0].x, polygonPoints[0].y));
+  for (const cv::Point &p : polygonPoints)
+    path.lineTo(p.x, p.y);
+  polygonItem = scene.addPath(path, QPen(Qt::red, 2));
+  polygonItem->setZValue(1);
+}
+
+void ImageViewer::setOverlay(const QPainterPath &path) {
+  overlay = path;
+  drawOverlay();
+}
+
+void ImageViewer::drawOverlay() {
+  if (overlayItem != nullptr) {
+    scene.removeItem(overlayItem);
+    delete overlayItem;
+    overlayItem = nullptr;
+  }
+  if (overlay.isEmpty())
+    return;
+  // a single item for all the outlines, there may be thousands of them
+  QPen pen(Qt::yellow, 1);
+  pen.setCosmetic(true);
+  overlayItem = scene.addPath(overlay, pen);
+  overlayItem->setZValue(1);
+}
@@ -3,6 +3,7 @@
 #include <QGraphicsPixmapItem>
 #include <QGraphicsView>
 #include <QLabel>
+#include <QPainterPath>
 #include <QPixmap>
 #include <QWheelEvent>
 #include <opencv2/core/types.hpp>
@@ -18,6 +19,9 @@ class ImageViewer : public QGraphicsView {
 public:
   explicit ImageViewer(QWidget *parent = nullptr);
   void setImage(const QPixmap &pixmap);
+  // shows `pixmap` stretched over `target` of an image of size `imageSize`,
+  // used when only the visible part of the image is rendered
+  void setImagePart(const QPixmap &pixmap, const QRectF &target, const QSizeF &imageSize);
   void useImageTransform(const ImageViewer &other);
   void fit();
   void clear();
@@ -33,13 +37,27 @@ public:
   void cancelGetROIFromUser();
   void clearROI();
 
+  // will allow polygonSelected signal to be emitted once a right click closes the polygon
+  void getPolygonFromUser();
+  void cancelGetPolygonFromUser();
+
+  // outlines drawn over the image until replaced, kept when the image changes
+  void setOverlay(const QPainterPath &path);
+
   QPixmap getImage() const;
+  // part of the image currently visible, in image coordinates
+  QRectF getVisibleImageRect() const;
+  // how many screen pixels a pixel of the image takes
+  double getDisplayScale() const { return transform().m11(); }
 
 protected:
   void wheelEvent(QWheelEvent *event) override;
   void mousePressEvent(QMouseEvent *event) override;
   void mouseMoveEvent(QMouseEvent *event) override;
   void mouseReleaseEvent(QMouseEvent *event) override;
+  void scrollContentsBy(int dx, int dy) override;
+  void resizeEvent(QResizeEvent *event) override;
+  void paintEvent(QPaintEvent *event) override;
 
   QGraphicsEllipseItem *drawPoint(QPointF point, const double radius, const QPen &pen,
                                   const QBrush &brush);
@@ -52,6 +70,11 @@ protected:
 signals:
   void lineSelected(QLineF line);
   void roiSelected(cv::Rect roi);
+  void polygonSelected(std::vector<cv::Point> polygon);
+  // zooming, scrolling or resizing changed the visible part of the image
+  void visibleAreaChanged();
+  // the view has been painted on screen
+  void painted();
 
 private:
   const qreal zoomFactor;
@@ -68,4 +91,14 @@ private:
   QRubberBand *rubberBand = nullptr;
   QGraphicsRectItem *roiItem = nullptr;
   QPoint origin;
+
+  // polygon selection
+  bool selectingPolygon = false;
+  std::vector<cv::Point> polygonPoints;
+  QGraphicsPathItem *polygonItem = nullptr;
+  void drawPolygon();
+
+  QPainterPath overlay;
+  QGraphicsPathItem *overlayItem = nullptr;
+  void drawOverlay();
 };
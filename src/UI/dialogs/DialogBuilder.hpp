@@ -1,8 +1,12 @@
 #pragma once
 
 #include "../../imageWrapper.hpp"
+#include "../../interactionLatency.hpp"
+#include "../../trace.hpp"
 #include "../ImageViewer.hpp"
 #include "MaskEditor.hpp"
+#include "PreviewCache.hpp"
+#include <QElapsedTimer>
 #include <QMessageBox>
 #include <QPushButton>
 #include <opencv2/core/base.hpp>
@@ -177,6 +181,7 @@ public:
   Dialog(QWidget *parent, QString title, InputSpec<Params>... inputs) {
     dialog = new QDialog(parent);
     dialog->setWindowTitle(title);
+    name = title.toStdString();
 
     QFormLayout *form = new QFormLayout(dialog);
     dialog->setLayout(form);
@@ -193,22 +198,41 @@ public:
     paramChanged = [this, buttons]() {
       if (previewFn == nullptr)
         return;
+      TRACE_SCOPE("Dialog::preview");
+      changeTimer.start();
+      pendingLatency.reset();
       auto params = readParams();
       if (!params.has_value()) {
         previewImage->clear();
         buttons->button(QDialogButtonBox::Ok)->setEnabled(false);
         return;
       }
-      auto mat =
-          std::apply([this](const auto &...param) { return previewFn(param...); }, params.value());
+      // toggling a parameter back and forth shouldn't recompute the filter every time
+      auto mat = previewCache.find(params.value());
       if (!mat.has_value()) {
+        TRACE_SCOPE("Dialog::computePreview");
+        mat = std::apply([this](const auto &...param) { return previewFn(param...); },
+                         params.value());
+        if (mat.has_value())
+          previewCache.insert(params.value(), mat.value());
+      }
+      if (!mat.has_value()) {
+        lastPreview.reset();
         previewImage->clear();
         buttons->button(QDialogButtonBox::Ok)->setEnabled(false);
         return;
       }
+      lastPreview = {params.value(), mat.value()};
+      double computed = changeTimer.nsecsElapsed() / 1e6;
+      TRACE_SCOPE("Dialog::showPreview");
       QPixmap pixmap = ImageWrapper(mat.value()).generateQPixmap();
+      double converted = changeTimer.nsecsElapsed() / 1e6;
       previewImage->setImage(pixmap);
       buttons->button(QDialogButtonBox::Ok)->setEnabled(true);
+      previewLatency = converted;
+      // the first preview is painted together with the whole dialog, that's not an interaction
+      if (dialog->isVisible())
+        pendingLatency = interactionLatency::Sample{computed, converted, 0};
     };
   }
 
@@ -247,25 +271,59 @@ public:
   using PreviewFunction = std::function<std::optional<cv::Mat>(ResultType<Params>...)>;
   std::optional<cv::Mat> runWithPreview(PreviewFunction previewFn,
                                         PreviewFunction finalFn = nullptr) {
-    if (finalFn == nullptr)
+    // preview is already computed at the full resolution, so if the final result is computed
+    // the same way there's no need to run the (possibly expensive) operation once again
+    bool finalIsPreview = finalFn == nullptr;
+    if (finalIsPreview)
       finalFn = previewFn;
 
     this->previewFn = previewFn;
+    previewCache.clear();
     dialog->resize(800, 800);
     paramChanged();
 
+    // a new preview is on screen only once it's painted back in the event loop
+    auto painted = QObject::connect(previewImage, &ImageViewer::painted, [this]() {
+      if (!pendingLatency.has_value())
+        return;
+      pendingLatency->painted = changeTimer.nsecsElapsed() / 1e6;
+      previewLatency = pendingLatency->painted;
+      interactionLatency::record(name, pendingLatency.value());
+      pendingLatency.reset();
+    });
     auto params = run();
+    QObject::disconnect(painted);
+    acceptedParams = params;
     if (!params.has_value())
       return std::nullopt;
+    if (finalIsPreview && lastPreview.has_value() &&
+        PreviewCacheUtils::tupleEquals(lastPreview->first, params.value()))
+      return lastPreview->second;
     return std::apply([finalFn](const auto &...param) { return finalFn(param...); },
                       params.value());
   }
 
+  // parameters with which the dialog got accepted by the last call to `runWithPreview`
+  const std::optional<ResultTuple> &getAcceptedParams() const { return acceptedParams; }
+  // milliseconds it took to paint the preview after the last change of the parameters
+  double getPreviewLatency() const { return previewLatency; }
+
 private:
   QDialog *dialog;
+  // latencies are reported under the title of the dialog
+  std::string name;
   ImageViewer *previewImage;
   std::function<void()> paramChanged = {};
   PreviewFunction previewFn = {};
+  PreviewCache<ResultTuple> previewCache;
+  // result currently shown in the preview along with parameters that produced it
+  std::optional<std::pair<ResultTuple, cv::Mat>> lastPreview;
+  std::optional<ResultTuple> acceptedParams;
+  double previewLatency = 0;
+  // started by the last change of the parameters
+  QElapsedTimer changeTimer;
+  // stages of the last preview which is yet to be painted
+  std::optional<interactionLatency::Sample> pendingLatency;
 
   template <typename Param>
   using Accessor = std::function<std::optional<typename InputSpec<Param>::MappedResult>()>;
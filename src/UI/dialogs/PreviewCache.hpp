@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <list>
+#include <opencv2/core/mat.hpp>
+#include <optional>
+#include <tuple>
+
+// upper bound of memory that a single dialog may spend on remembering its previews
+const std::size_t PREVIEW_CACHE_BUDGET_BYTES = 256 * 1024 * 1024;
+
+namespace PreviewCacheUtils {
+template <typename T> bool paramEquals(const T &a, const T &b) { return a == b; }
+
+// cv::Mat's operator== is an element-wise operation returning another Mat,
+// so masks have to be compared by their contents manually
+inline bool paramEquals(const cv::Mat &a, const cv::Mat &b) {
+  if (a.type() != b.type() || a.size() != b.size())
+    return false;
+
+  const std::size_t rowBytes = a.cols * a.elemSize();
+  for (int y = 0; y < a.rows; ++y) {
+    if (std::memcmp(a.ptr(y), b.ptr(y), rowBytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+template <typename... Ts> bool tupleEquals(const std::tuple<Ts...> &a, const std::tuple<Ts...> &b) {
+  return std::apply(
+      [&b](const auto &...lhs) {
+        return std::apply([&](const auto &...rhs) { return (paramEquals(lhs, rhs) && ...); }, b);
+      },
+      a);
+}
+
+inline std::size_t matBytes(const cv::Mat &mat) { return mat.total() * mat.elemSize(); }
+} // namespace PreviewCacheUtils
+
+// Least recently used cache of preview results keyed by a tuple of dialog parameters.
+// Size is limited by the number of bytes held by the cached images, not by the number of entries.
+// Dialogs have only a handful of entries so a linear lookup is cheaper than hashing masks.
+template <typename Key> class PreviewCache {
+public:
+  explicit PreviewCache(std::size_t budgetBytes = PREVIEW_CACHE_BUDGET_BYTES)
+      : budgetBytes(budgetBytes) {}
+
+  std::optional<cv::Mat> find(const Key &key) {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      if (PreviewCacheUtils::tupleEquals(it->key, key)) {
+        // mark as the most recently used one
+        entries.splice(entries.begin(), entries, it);
+        return entries.front().mat;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void insert(const Key &key, const cv::Mat &mat) {
+    std::size_t bytes = PreviewCacheUtils::matBytes(mat);
+    // an image that wouldn't fit even into an empty cache isn't worth evicting everything else
+    if (bytes > budgetBytes)
+      return;
+
+    while (!entries.empty() && usedBytes + bytes > budgetBytes) {
+      usedBytes -= PreviewCacheUtils::matBytes(entries.back().mat);
+      entries.pop_back();
+    }
+    entries.push_front({key, mat});
+    usedBytes += bytes;
+  }
+
+  void clear() {
+    entries.clear();
+    usedBytes = 0;
+  }
+
+  std::size_t getUsedBytes() const { return usedBytes; }
+  std::size_t getBudgetBytes() const { return budgetBytes; }
+
+private:
+  struct Entry {
+    Key key;
+    cv::Mat mat;
+  };
+  // most recently used entry is at the front
+  std::list<Entry> entries;
+  std::size_t budgetBytes;
+  std::size_t usedBytes = 0;
+};
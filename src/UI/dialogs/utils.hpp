@@ -1,4 +1,5 @@
 #pragma once
+#include "../../operations.hpp"
 #include "DialogBuilder.hpp"
 #include <opencv2/core/types.hpp>
 #include <opencv2/opencv.hpp>
@@ -47,10 +48,7 @@ const auto inputSpec = InputSpec<DialogParam<DialogValue::EnumVariant, ValueType
 } // namespace KernelSizes
 
 namespace SobelDirections {
-enum Enum {
-  Horizontal,
-  Vertical,
-};
+using Enum = operations::SobelDirection;
 const std::vector<Enum> values{Enum::Horizontal, Enum::Vertical};
 const std::vector<QString> strings{"Horizontal", "Vertical"};
 const auto inputSpec = InputSpec<DialogParam<DialogValue::EnumVariant, Enum>>{
@@ -106,6 +104,13 @@ const std::vector<ValueType> values{cv::ADAPTIVE_THRESH_MEAN_C, cv::ADAPTIVE_THR
 const auto inputSpec = InputSpec<DialogParam<DialogValue::EnumVariant, ValueType>>{
     "Method", {names}, 0, [](uint index) { return values[index]; }};
 } // namespace AdaptiveThresholdTypes
+namespace AutoThresholdMethods {
+using ValueType = autoThreshold::Method;
+// in the order of autoThreshold::METHODS
+const std::vector<QString> names{"Otsu", "Triangle", "Li", "Yen", "Huang", "Mean"};
+const auto inputSpec = InputSpec<DialogParam<DialogValue::EnumVariant, ValueType>>{
+    "Method", {names}, 0, [](uint index) { return autoThreshold::METHODS[index]; }};
+} // namespace AutoThresholdMethods
 
 namespace DialogResultsUtils {
 template <typename Tuple, typename... Funcs, std::size_t... Is>
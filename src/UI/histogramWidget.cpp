@@ -1,6 +1,9 @@
 #include "histogramWidget.hpp"
 #include "../imageProcessor.hpp"
-#include <QListWidget>
+#include "../trace.hpp"
+#include <QHeaderView>
+#include <QPainterPath>
+#include <algorithm>
 #include <qboxlayout.h>
 #include <qbrush.h>
 #include <qlabel.h>
@@ -9,23 +12,107 @@
 #include <qscrollarea.h>
 #include <qwidget.h>
 
+HistogramStats HistogramStats::fromHistogram(std::vector<int> hist) {
+  HistogramStats stats;
+  stats.hist = std::move(hist);
+  if (stats.hist.empty())
+    return stats;
+
+  stats.minCount = stats.hist[0];
+  stats.maxCount = stats.hist[0];
+  for (int i = 0; i < 256; ++i) {
+    int l = stats.hist[i];
+    stats.minCount = std::min(stats.minCount, l);
+    stats.maxCount = std::max(stats.maxCount, l);
+    stats.pixels += l;
+    if (l > 0 && stats.minValue == -1)
+      stats.minValue = i;
+    if (l > 0)
+      stats.maxValue = i;
+  }
+  stats.average = static_cast<double>(stats.pixels) / 256;
+  return stats;
+}
+
+ImageHistograms ImageHistograms::fromChannels(std::vector<std::vector<int>> hists,
+                                              PixelFormat format) {
+  ImageHistograms result;
+  if (hists.size() == 3) {
+    result.names = PixelFormatUtils::channelNames(format);
+    if (format == PixelFormat::BGR24) {
+      // named R, G, B like the channel tabs
+      std::swap(hists[0], hists[2]);
+      result.colors = {QColor(220, 40, 40), QColor(40, 170, 40), QColor(40, 80, 220)};
+    } else {
+      result.colors = {QColor(200, 120, 0), QColor(0, 150, 150), QColor(140, 40, 200)};
+    }
+  }
+  for (auto &hist : hists)
+    result.channels.push_back(HistogramStats::fromHistogram(std::move(hist)));
+  return result;
+}
+
 HistogramPlot::HistogramPlot(QWidget *parent) : QWidget(parent) {
   setMinimumSize(256, 100);
   resize(400, 400);
 }
-void HistogramPlot::updateHist(std::vector<int> hist, int maxValue) {
-  this->hist = hist;
-  maxLutValue = maxValue;
+
+void HistogramPlot::setMode(Mode mode) {
+  this->mode = mode;
   update();
 }
 
+void HistogramPlot::updateHist(std::vector<std::vector<int>> hists, std::vector<QColor> colors) {
+  this->hists = std::move(hists);
+  this->colors = std::move(colors);
+  maxCounts.clear();
+  for (const auto &hist : this->hists)
+    maxCounts.push_back(hist.empty() ? 0 : *std::max_element(hist.begin(), hist.end()));
+  update();
+}
+
+void HistogramPlot::drawBars(QPainter &painter, const std::vector<int> &hist, double scale,
+                             int bottom, const QColor &color) {
+  double barWidth = fmax(1.0f, static_cast<double>(width()) / static_cast<double>(hist.size()));
+  painter.setPen(color);
+  painter.setBrush(color);
+  for (size_t i = 0; i < hist.size(); ++i) {
+    int barHeight = static_cast<int>(hist[i] * scale);
+    int x = static_cast<int>(i * barWidth);
+    painter.drawRect(x, bottom - barHeight, static_cast<int>(barWidth), barHeight);
+  }
+}
+
+void HistogramPlot::drawOverlaid(QPainter &painter, int maxHeight) {
+  int maxCount = *std::max_element(maxCounts.begin(), maxCounts.end());
+  if (maxCount == 0)
+    return;
+  double step = static_cast<double>(width()) / 256;
+  for (size_t c = 0; c < hists.size(); ++c) {
+    // outlines with a translucent fill, so that the channels underneath stay visible
+    QPainterPath path(QPointF(0, height()));
+    for (int i = 0; i < 256; ++i) {
+      double y = height() - static_cast<double>(hists[c][i]) / maxCount * maxHeight;
+      path.lineTo(i * step, y);
+      path.lineTo((i + 1) * step, y);
+    }
+    path.lineTo(width(), height());
+    path.closeSubpath();
+
+    QColor fill = colors[c];
+    fill.setAlpha(70);
+    painter.setPen(colors[c]);
+    painter.setBrush(fill);
+    painter.drawPath(path);
+  }
+}
+
 void HistogramPlot::paintEvent(QPaintEvent *event) {
   Q_UNUSED(event);
   QPainter painter(this);
   painter.setRenderHint(QPainter::Antialiasing);
 
-  int lut_size = hist.size();
-  if (lut_size <= 0)
+  if (hists.empty())
     return;
 
   int w = width();
@@ -34,29 +121,29 @@ void HistogramPlot::paintEvent(QPaintEvent *event) {
   int spacing = 20;
   int maxHeight = height() - gradientHeight;
 
-  if (maxLutValue == 0)
-    return;
-
-  double barWidth =
-      fmax(1.0f, static_cast<double>(w) / static_cast<double>(lut_size));
-
-  for (int i = 0; i < lut_size; ++i) {
-    int barHeight = static_cast<int>(
-        (static_cast<double>(hist[i]) / maxLutValue) * maxHeight);
-    int x = static_cast<int>(i * barWidth);
-    int y = h - barHeight;
-
-    painter.setPen(Qt::gray);
-    painter.setBrush(Qt::gray);
-    painter.drawRect(x, y, static_cast<int>(barWidth), barHeight);
+  if (hists.size() == 1) {
+    if (maxCounts[0] == 0)
+      return;
+    drawBars(painter, hists[0], static_cast<double>(maxHeight) / maxCounts[0], h, Qt::gray);
+  } else if (mode == Mode::Overlaid) {
+    drawOverlaid(painter, maxHeight);
+  } else {
+    // every channel gets a band of its own, scaled to its own highest count
+    int bandHeight = maxHeight / static_cast<int>(hists.size());
+    for (size_t c = 0; c < hists.size(); ++c) {
+      if (maxCounts[c] == 0)
+        continue;
+      int bottom = h - static_cast<int>(hists.size() - 1 - c) * bandHeight;
+      drawBars(painter, hists[c], static_cast<double>(bandHeight) / maxCounts[c], bottom,
+               colors[c]);
+    }
   }
 
   // gradient
   QLinearGradient gradient(0, maxHeight + spacing, w,
                            maxHeight + spacing + gradientHeight);
-  for (size_t i = 0; i < hist.size(); ++i) {
-    float intensity = static_cast<float>(i) /
-                       static_cast<float>(hist.size() - 1); // normalize
+  for (size_t i = 0; i < 256; ++i) {
+    float intensity = static_cast<float>(i) / 255.0f; // normalize
     double position = static_cast<double>(intensity);
 
     QColor color =
@@ -68,6 +155,55 @@ void HistogramPlot::paintEvent(QPaintEvent *event) {
   painter.fillRect(0, maxHeight + spacing, w, gradientHeight, gradient);
 }
 
+HistogramTableModel::HistogramTableModel(QObject *parent) : QAbstractTableModel(parent) {}
+
+void HistogramTableModel::setHistograms(std::vector<std::vector<int>> hists,
+                                        std::vector<std::string> names, int maxCount) {
+  beginResetModel();
+  this->hists = std::move(hists);
+  this->names = std::move(names);
+  this->maxCount = maxCount;
+  endResetModel();
+}
+
+int HistogramTableModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() || hists.empty() ? 0 : static_cast<int>(hists[0].size());
+}
+
+int HistogramTableModel::columnCount(const QModelIndex &parent) const {
+  if (parent.isValid())
+    return 0;
+  // value, count and percent or value and a count per channel
+  return hists.size() > 1 ? static_cast<int>(hists.size()) + 1 : 3;
+}
+
+QVariant HistogramTableModel::data(const QModelIndex &index, int role) const {
+  if (role != Qt::DisplayRole || !index.isValid())
+    return {};
+  if (index.column() == 0)
+    return index.row();
+  if (hists.size() > 1)
+    return hists[index.column() - 1][index.row()];
+
+  int l = hists[0][index.row()];
+  if (index.column() == 1)
+    return l;
+  double percent = 0;
+  if (l > 0)
+    percent = floor(static_cast<double>(l) / static_cast<double>(maxCount) * 10000) / 100;
+  return QString("%1%").arg(percent);
+}
+
+QVariant HistogramTableModel::headerData(int section, Qt::Orientation orientation,
+                                         int role) const {
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return {};
+  if (hists.size() > 1 && section > 0)
+    return QString::fromStdString(names[section - 1]);
+  const char *headers[] = {"Value", "Count", "Percent of max count"};
+  return QString(headers[section]);
+}
+
 HistogramWidget::HistogramWidget(QWidget *parent)
     : QSplitter(Qt::Vertical, parent) {
   // PLOT
@@ -76,74 +212,159 @@ HistogramWidget::HistogramWidget(QWidget *parent)
   QWidget *statsAndLut = new QWidget;
   QVBoxLayout *statsAndLutLayout = new QVBoxLayout(statsAndLut);
 
+  // CHANNELS
+  modeBox = new QComboBox;
+  modeBox->addItem("Overlaid channels");
+  modeBox->addItem("Stacked channels");
+  modeBox->hide();
+  connect(modeBox, &QComboBox::currentIndexChanged, this, [this](int index) {
+    plot->setMode(index == 0 ? HistogramPlot::Mode::Overlaid : HistogramPlot::Mode::Stacked);
+  });
+  statsAndLutLayout->addWidget(modeBox);
+
   // STATS
   statsLabel = new QLabel("Min: -- Max: -- Avg: --");
   statsAndLutLayout->addWidget(statsLabel);
 
   // LUT
-  QScrollArea *lutScrollArea = new QScrollArea;
-  lutScrollArea->setWidgetResizable(true);
-  lutList = new QListWidget;
-  lutScrollArea->setWidget(lutList);
-  statsAndLutLayout->addWidget(lutScrollArea);
+  lutModel = new HistogramTableModel(this);
+  lutTable = new QTableView;
+  lutTable->setModel(lutModel);
+  lutTable->verticalHeader()->hide();
+  // rows of the same height don't have to be measured one by one
+  lutTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  lutTable->horizontalHeader()->setStretchLastSection(true);
+  lutTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+  statsAndLutLayout->addWidget(lutTable);
 
   addWidget(plot);
   addWidget(statsAndLut);
 
+  pool.setMaxThreadCount(1);
   connect(this, &HistogramWidget::updateHist, plot, &HistogramPlot::updateHist);
 }
 
+HistogramWidget::~HistogramWidget() {
+  // the tasks use the members, which are destroyed before the pool
+  pool.clear();
+  pool.waitForDone();
+}
+
 void HistogramWidget::updateHistogram(const ImageWrapper &image) {
-  hist = imageProcessor::histogram(image.getMat());
-  if (hist.empty()) {
-    reset();
+  TRACE_SCOPE("HistogramWidget::updateHistogram");
+  std::uint64_t request = ++latestRequest;
+  std::shared_ptr<ImageStats> imageStats = image.getStats();
+  // e.g. derived from the previous image by a LUT, there's no need to look at the pixels then
+  if (auto cached = imageStats ? imageStats->cachedHistograms() : std::nullopt) {
+    showStats(ImageHistograms::fromChannels(std::move(cached.value()), image.getFormat()));
     return;
   }
+  // images are never modified in place, sharing the pixels is enough to keep them alive
+  pool.start([this, request, mat = image.getMat(), format = image.getFormat(), imageStats]() {
+    if (request != latestRequest || !imageStats)
+      return;
+    TRACE_SCOPE("HistogramWidget::computeHistograms");
+    // the index of another image would only keep its pixels alive
+    if (regionIndexImage.lock() != imageStats)
+      regionIndex.reset();
+    if (mat.total() > APPROXIMATE_ABOVE) {
+      imageProcessor::SampledHistograms sampled = imageProcessor::sampleHistograms(mat);
+      ImageHistograms approximate = ImageHistograms::fromChannels(std::move(sampled.hists), format);
+      approximate.cdfError = sampled.cdfError;
+      postStats(request, std::move(approximate));
+      // not worth a full scan anymore
+      if (request != latestRequest)
+        return;
+    }
+    // kept with the image for everyone else who needs them
+    postStats(request, ImageHistograms::fromChannels(imageStats->histograms(mat), format));
+  });
+}
 
-  min = hist[0];
-  max = hist[0];
-  int sum = 0;
-  lutList->clear();
-  for (int i = 0; i < 256; ++i) {
-    int l = hist[i];
-    if (l < min)
-      min = l;
-    if (l > max)
-      max = l;
-    sum += l;
-  }
+void HistogramWidget::showRegion(const ImageWrapper &image, cv::Rect region) {
+  TRACE_SCOPE("HistogramWidget::showRegion");
+  std::uint64_t request = ++latestRequest;
+  pool.start([this, request, mat = image.getMat(), format = image.getFormat(),
+              imageStats = image.getStats(), region]() {
+    if (request != latestRequest || !imageStats)
+      return;
+    TRACE_SCOPE("HistogramWidget::computeRegion");
+    if (!regionIndex || regionIndexImage.lock() != imageStats) {
+      regionIndex = std::make_shared<IntegralHistogram>(mat);
+      regionIndexImage = imageStats;
+    }
+    ImageHistograms stats = ImageHistograms::fromChannels(regionIndex->histograms(region), format);
+    stats.region = region & cv::Rect(0, 0, mat.cols, mat.rows);
+    postStats(request, std::move(stats));
+  });
+}
 
-  int minValue = -1;
-  int maxValue = -1;
-  for (int i = 0; i < 256; ++i) {
-    int l = hist[i];
-    if (l > 0 && minValue == -1)
-      minValue = i;
-    if (l > 0)
-      maxValue = i;
-    double percent = 0;
-    if (l > 0) percent = floor(static_cast<double>(l) / static_cast<double>(max) * 10000) / 100;
-    lutList->addItem(QString("%1:\t%2\t%3%").arg(i).arg(l).arg(percent));
+void HistogramWidget::postStats(std::uint64_t request, ImageHistograms computed) {
+  QMetaObject::invokeMethod(
+      this,
+      [this, request, computed = std::move(computed)]() mutable {
+        if (request == latestRequest)
+          showStats(std::move(computed));
+      },
+      Qt::QueuedConnection);
+}
+
+void HistogramWidget::showStats(ImageHistograms computed) {
+  TRACE_SCOPE("HistogramWidget::showStats");
+  if (computed.channels.empty()) {
+    reset();
+    return;
   }
-  average = static_cast<double>(sum) / 256;
+  stats = std::move(computed);
+
+  std::vector<std::vector<int>> hists;
+  for (const HistogramStats &channel : stats.channels)
+    hists.push_back(channel.hist);
+  const HistogramStats &first = stats.channels[0];
+  lutModel->setHistograms(hists, stats.names, first.maxCount);
+  modeBox->setVisible(hists.size() > 1);
 
-  statsLabel->setText(
-      QString("Min value: %5\tMax value: %6\n"
-              "Pixels: %1\tMin count: %2\tMax count: %3\tAvg: %4\n\n"
-              "Value\tCount\tPercent of max count")
-          .arg(sum)
-          .arg(min)
-          .arg(max)
-          .arg(average, 0, 'f', 2)
-          .arg(minValue)
-          .arg(maxValue));
+  QString text;
+  if (stats.cdfError > 0)
+    text = QString("Approximate, refining... (CDF within %1%)\n")
+               .arg(stats.cdfError * 100, 0, 'f', 2);
+  if (stats.region.has_value())
+    text = QString("Region: %1, %2, %3x%4\n")
+               .arg(stats.region->x)
+               .arg(stats.region->y)
+               .arg(stats.region->width)
+               .arg(stats.region->height);
+  if (hists.size() == 1) {
+    text += QString("Min value: %5\tMax value: %6\n"
+                    "Pixels: %1\tMin count: %2\tMax count: %3\tAvg: %4")
+                .arg(first.pixels)
+                .arg(first.minCount)
+                .arg(first.maxCount)
+                .arg(first.average, 0, 'f', 2)
+                .arg(first.minValue)
+                .arg(first.maxValue);
+  } else {
+    text += QString("Pixels: %1").arg(first.pixels);
+    for (size_t c = 0; c < stats.channels.size(); ++c) {
+      const HistogramStats &channel = stats.channels[c];
+      text += QString("\n%1: Min value: %2\tMax value: %3\tMax count: %4")
+                  .arg(QString::fromStdString(stats.names[c]))
+                  .arg(channel.minValue)
+                  .arg(channel.maxValue)
+                  .arg(channel.maxCount);
+    }
+  }
+  statsLabel->setText(text);
 
-  emit updateHist(hist, max);
+  emit updateHist(std::move(hists), stats.colors);
 }
 
 void HistogramWidget::reset() {
-  hist.clear();
-  lutList->clear();
-  plot->updateHist(hist, 0);
+  // results that are still being computed are no longer wanted
+  ++latestRequest;
+  stats = ImageHistograms();
+  lutModel->setHistograms({}, {}, 0);
+  plot->updateHist({}, {});
+  modeBox->hide();
   statsLabel->setText(QString("Min: -- Max: -- Avg: --"));
 }
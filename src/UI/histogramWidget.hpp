@@ -1,32 +1,102 @@
 #pragma once
 
 #include "../imageWrapper.hpp"
+#include "../integralHistogram.hpp"
+#include <QAbstractTableModel>
+#include <QColor>
+#include <QComboBox>
 #include <QImage>
 #include <QPainter>
 #include <QScrollArea>
 #include <QSplitter>
+#include <QTableView>
+#include <QThreadPool>
 #include <QWidget>
+#include <atomic>
+#include <cstdint>
 #include <qlabel.h>
-#include <qlistwidget.h>
 #include <qpixmap.h>
 #include <qsplitter.h>
 #include <qwidget.h>
 
+// everything the dock shows about a channel of an image
+struct HistogramStats {
+  std::vector<int> hist;
+  // the least and the most pixels a single value has
+  int minCount = 0, maxCount = 0;
+  long long pixels = 0;
+  // average count of a value
+  double average = 0;
+  // the lowest and the highest value present in the image
+  int minValue = -1, maxValue = -1;
+
+  static HistogramStats fromHistogram(std::vector<int> hist);
+};
+
+// stats of every channel of an image
+struct ImageHistograms {
+  std::vector<HistogramStats> channels;
+  // in the order of `channels`, empty for single channel images
+  std::vector<std::string> names;
+  std::vector<QColor> colors;
+  // part of the image the histograms are of, the whole image if not set
+  std::optional<cv::Rect> region;
+  // estimated from a sample if above 0, see imageProcessor::SampledHistograms
+  double cdfError = 0;
+
+  // `hists` in the order of the channels of the Mat
+  static ImageHistograms fromChannels(std::vector<std::vector<int>> hists, PixelFormat format);
+};
+
 class HistogramPlot : public QWidget {
   Q_OBJECT
 
 public:
+  // how histograms of multiple channels are drawn
+  enum class Mode { Overlaid, Stacked };
+
   explicit HistogramPlot(QWidget *parent = nullptr);
+  void setMode(Mode mode);
 
 public slots:
-  void updateHist(std::vector<int> hist, int max);
+  // a single histogram is drawn in gray, multiple ones in their `colors`
+  void updateHist(std::vector<std::vector<int>> hists, std::vector<QColor> colors);
 
 protected:
   void paintEvent(QPaintEvent *event) override;
 
 private:
-  std::vector<int> hist;
-  int maxLutValue;
+  std::vector<std::vector<int>> hists;
+  std::vector<QColor> colors;
+  // the highest count of each histogram
+  std::vector<int> maxCounts;
+  Mode mode = Mode::Overlaid;
+
+  void drawBars(QPainter &painter, const std::vector<int> &hist, double scale, int bottom,
+                const QColor &color);
+  void drawOverlaid(QPainter &painter, int maxHeight);
+};
+
+// rows of the histogram, formatted only once the view shows them
+class HistogramTableModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  explicit HistogramTableModel(QObject *parent = nullptr);
+  // a single histogram also gets its percentages, multiple ones a count column per channel
+  void setHistograms(std::vector<std::vector<int>> hists, std::vector<std::string> names,
+                     int maxCount);
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+private:
+  std::vector<std::vector<int>> hists;
+  std::vector<std::string> names;
+  int maxCount = 0;
 };
 
 // Upper half contains the histogram, the bottom one stats
@@ -35,20 +105,40 @@ class HistogramWidget : public QSplitter {
 
 public:
   explicit HistogramWidget(QWidget *parent = nullptr);
+  // waits for the running request, the queued ones are dropped
+  ~HistogramWidget() override;
   void reset();
 
+  // images with more pixels first get histograms of a sample, shown until the exact ones are done
+  static const std::size_t APPROXIMATE_ABOVE = 16 << 20;
+
 public slots:
+  // computes the histogram in the background, results of older requests are dropped
   void updateHistogram(const ImageWrapper &image);
+  // shows the histogram of `region` of the image instead, answered by an IntegralHistogram that's
+  // built once per image
+  void showRegion(const ImageWrapper &image, cv::Rect region);
 
 signals:
-  void updateHist(std::vector<int> lut, int max);
+  void updateHist(std::vector<std::vector<int>> hists, std::vector<QColor> colors);
 
 private:
   HistogramPlot *plot;
+  QComboBox *modeBox;
   QLabel *statsLabel;
-  QListWidget *lutList;
+  QTableView *lutTable;
+  HistogramTableModel *lutModel;
 
-  std::vector<int> hist;
-  int min, max;
-  double average;
+  ImageHistograms stats;
+  // incremented by every request, only the latest one gets shown
+  std::atomic<std::uint64_t> latestRequest = 0;
+  // a single thread, so that requests waiting behind a newer one can be skipped
+  QThreadPool pool;
+  // index of the last image a region was asked for, only used from the pool's thread
+  std::shared_ptr<const IntegralHistogram> regionIndex;
+  std::weak_ptr<ImageStats> regionIndexImage;
+
+  // shows the stats on the UI thread if the request is still the latest one
+  void postStats(std::uint64_t request, ImageHistograms computed);
+  void showStats(ImageHistograms computed);
 };
@@ -0,0 +1,100 @@
+#include "layersPanel.hpp"
+#include <QDoubleSpinBox>
+#include <QLabel>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <cmath>
+
+LayersPanel::LayersPanel(QWidget *parent) : QWidget(parent) {
+  QVBoxLayout *layout = new QVBoxLayout(this);
+  list = new QListWidget;
+  layout->addWidget(list);
+
+  paramsForm = new QFormLayout;
+  layout->addLayout(paramsForm);
+
+  removeButton = new QPushButton("Remove layer");
+  removeButton->setEnabled(false);
+  layout->addWidget(removeButton);
+
+  connect(list, &QListWidget::currentRowChanged, this, &LayersPanel::selectionChanged);
+  connect(list, &QListWidget::itemChanged, this, [this](QListWidgetItem *item) {
+    if (updating)
+      return;
+    int row = list->row(item);
+    bool enabled = item->checkState() == Qt::Checked;
+    layers[row].enabled = enabled;
+    emit layerEnabledChanged(row, enabled);
+  });
+  connect(removeButton, &QPushButton::clicked, this, [this]() {
+    int row = list->currentRow();
+    if (row >= 0)
+      emit layerRemoved(row);
+  });
+}
+
+void LayersPanel::setLayers(const std::vector<AdjustmentLayer> &layers) {
+  this->layers = layers;
+  int row = list->currentRow();
+
+  updating = true;
+  list->clear();
+  for (std::size_t i = 0; i < layers.size(); ++i) {
+    QListWidgetItem *item =
+        new QListWidgetItem(QString("%1. %2").arg(i + 1).arg(layers[i].step.operation), list);
+    item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+    item->setCheckState(layers[i].enabled ? Qt::Checked : Qt::Unchecked);
+  }
+  list->setCurrentRow(std::min(row, static_cast<int>(layers.size()) - 1));
+  updating = false;
+  selectionChanged();
+}
+
+void LayersPanel::selectionChanged() {
+  if (updating)
+    return;
+  int row = list->currentRow();
+  removeButton->setEnabled(row >= 0);
+  showParams(row);
+}
+
+void LayersPanel::showParams(int index) {
+  // the rows may be rebuilt from a signal of one of their spin boxes, so they're deleted later
+  while (paramsForm->rowCount() > 0) {
+    QFormLayout::TakeRowResult row = paramsForm->takeRow(0);
+    for (QLayoutItem *item : {row.labelItem, row.fieldItem}) {
+      if (item == nullptr)
+        continue;
+      if (QWidget *widget = item->widget()) {
+        widget->hide();
+        widget->deleteLater();
+      }
+      delete item;
+    }
+  }
+  if (index < 0 || index >= static_cast<int>(layers.size()))
+    return;
+
+  const QJsonArray &params = layers[index].step.params;
+  for (qsizetype i = 0; i < params.size(); ++i) {
+    QString label = QString("Parameter %1").arg(i + 1);
+    if (!params[i].isDouble()) {
+      // masks can only be chosen in the operation's own dialog
+      paramsForm->addRow(label, new QLabel("mask"));
+      continue;
+    }
+
+    double value = params[i].toDouble();
+    QDoubleSpinBox *spinBox = new QDoubleSpinBox;
+    spinBox->setDecimals(std::floor(value) == value ? 0 : 3);
+    spinBox->setRange(-1e6, 1e6);
+    spinBox->setValue(value);
+    paramsForm->addRow(label, spinBox);
+
+    connect(spinBox, &QDoubleSpinBox::valueChanged, this, [this, index, i](double value) {
+      QJsonArray &params = layers[index].step.params;
+      params[i] = value;
+      emit layerParamsChanged(index, params);
+    });
+  }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../layerStack.hpp"
+#include <QFormLayout>
+#include <QJsonArray>
+#include <QListWidget>
+#include <QPushButton>
+#include <QWidget>
+#include <vector>
+
+// List of adjustment layers of an image, parameters of the selected one can be edited
+class LayersPanel : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit LayersPanel(QWidget *parent = nullptr);
+  // shows `layers` keeping the selected row if it still exists
+  void setLayers(const std::vector<AdjustmentLayer> &layers);
+
+signals:
+  void layerEnabledChanged(int index, bool enabled);
+  void layerParamsChanged(int index, QJsonArray params);
+  void layerRemoved(int index);
+
+private slots:
+  void selectionChanged();
+
+private:
+  void showParams(int index);
+
+  QListWidget *list;
+  QFormLayout *paramsForm;
+  QPushButton *removeButton;
+  std::vector<AdjustmentLayer> layers;
+  // set while the list is filled to ignore the changes it makes
+  bool updating = false;
+};
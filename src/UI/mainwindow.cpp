@@ -1,14 +1,22 @@
 #include "mainwindow.hpp"
+#include "../interactionLatency.hpp"
+#include "../stallWatchdog.hpp"
+#include "../trace.hpp"
 #include "dialogs/DialogBuilder.hpp"
 #include "histogramWidget.hpp"
 #include "mdiChild.hpp"
+#include <QFile>
 #include <QFileDialog>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QPixmap>
+#include <QPointer>
 #include <QSplitter>
+#include <QStatusBar>
+#include <QThreadPool>
 #include <QTimer>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
 #include <optional>
 #include <qaction.h>
@@ -18,11 +26,29 @@
 #include <qkeysequence.h>
 #include <qtypes.h>
 
+namespace {
+// name of the action including its menu, e.g. "Filter Blur mean"
+QString actionName(const QAction *action) {
+  QString name = action->text().remove('&');
+  if (QMenu *menu = qobject_cast<QMenu *>(action->parent()))
+    name = menu->title().remove('&') + " " + name;
+  return name;
+}
+} // namespace
+
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+  setupWatchdog();
   setupMenuBar();
   setupUI();
 }
 
+MainWindow::~MainWindow() {
+  if (watchdog) {
+    watchdog->stop();
+    watchdog->writeToEnvironmentPath();
+  }
+}
+
 void MainWindow::setupMenuBar() {
   QMenu *fileMenu = menuBar()->addMenu("&File");
   QAction *openAction = fileMenu->addAction("&Open");
@@ -32,9 +58,17 @@ void MainWindow::setupMenuBar() {
   saveAction->setEnabled(false);
   saveAction->setShortcut(QKeySequence::Save);
 
+  QMenu *editMenu = menuBar()->addMenu("&Edit");
+  undoAction = editMenu->addAction("&Undo");
+  undoAction->setShortcut(QKeySequence::Undo);
+  redoAction = editMenu->addAction("&Redo");
+  redoAction->setShortcut(QKeySequence::Redo);
+
   QMenu *viewMenu = menuBar()->addMenu("&View");
   toggleDockAction = viewMenu->addAction("Toggle &dock");
   toggleDockAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_H));
+  toggleHudAction = viewMenu->addAction("Performance &HUD");
+  toggleHudAction->setCheckable(true);
 
   QMenu *imageMenu = menuBar()->addMenu("&Image");
   duplicateAction = imageMenu->addAction("&Duplicate");
@@ -83,6 +117,8 @@ void MainWindow::setupMenuBar() {
   thresholdManualAction = thresholdingMenu->addAction("&Manual");
   thresholdAdaptiveAction = thresholdingMenu->addAction("&Adaptive");
   thresholdOtsuAction = thresholdingMenu->addAction("&Otsu");
+  thresholdAutoAction = thresholdingMenu->addAction("A&uto...");
+  thresholdMultiOtsuAction = thresholdingMenu->addAction("Multi-&level Otsu...");
 
   QMenu *edgeDetectMenu = segmentationMenu->addMenu("&Edge detection");
   edgeDetectSobelAction = edgeDetectMenu->addAction("&Sobel");
@@ -109,30 +145,75 @@ void MainWindow::setupMenuBar() {
   combineORAction = combineMenu->addAction("&OR");
   combineXORAction = combineMenu->addAction("&XOR");
 
+  /// PIPELINE
+  QMenu *pipelineMenu = menuBar()->addMenu("&Pipeline");
+  saveRecordedAction = pipelineMenu->addAction("&Save recorded operations...");
+  clearRecordedAction = pipelineMenu->addAction("&Clear recorded operations");
+  replayRecordedAction = pipelineMenu->addAction("&Replay recorded operations...");
+  replayFileAction = pipelineMenu->addAction("Replay operations from &file...");
+  pipelineMenu->addSeparator();
+  toggleLayersAction = pipelineMenu->addAction("&Toggle adjustment layers");
+  editLayersAction = pipelineMenu->addAction("&Edit adjustment layers...");
+  flattenLayersAction = pipelineMenu->addAction("&Flatten adjustment layers");
+
   /// ANALYSIS
   QMenu *analysisMenu = menuBar()->addMenu("&Analysis");
   houghAction = analysisMenu->addAction("&Hough transform");
   profileLineAction = analysisMenu->addAction("&Line intensity profile");
   profileLineAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_K));
+  regionHistogramAction = analysisMenu->addAction("&Region histogram");
+  roiManagerAction = analysisMenu->addAction("ROI &manager...");
 
   QMenu *aboutMenu = menuBar()->addMenu("Info");
   aboutAction = aboutMenu->addAction("About");
+  QAction *saveTraceAction = aboutMenu->addAction("Save &trace...");
+  saveTraceAction->setEnabled(trace::isCompiledIn());
+  QAction *saveLatencyAction = aboutMenu->addAction("Save preview &latencies...");
+  QAction *saveStallsAction = aboutMenu->addAction("Save &stall report...");
+  saveStallsAction->setEnabled(watchdog != nullptr);
 
   // actions that operate on a single window
   for (auto c : getConnections())
     c.action->setEnabled(false);
 
   // actions that work on multiple images
-  for (auto c : getMainWindowActions()) {
+  for (auto c : getMainWindowActions())
     c.action->setEnabled(false);
-    connect(c.action, &QAction::triggered, this, c.slot);
-  }
 
   // always available actions
   connect(openAction, &QAction::triggered, this, &MainWindow::openImage);
   connect(aboutAction, &QAction::triggered, this, &MainWindow::openAboutWindow);
+  connect(saveTraceAction, &QAction::triggered, this, &MainWindow::saveTrace);
+  connect(saveLatencyAction, &QAction::triggered, this, &MainWindow::savePreviewLatencies);
+  connect(saveStallsAction, &QAction::triggered, this, &MainWindow::saveStallReport);
   connect(toggleDockAction, &QAction::triggered, this,
           [this]() { dock->setVisible(dock->isHidden()); });
+  connect(toggleHudAction, &QAction::toggled, this, [this](bool visible) {
+    statusBar()->setVisible(visible);
+    if (visible) {
+      updateHudMemory();
+      hudTimer->start();
+    } else {
+      hudTimer->stop();
+    }
+  });
+}
+
+void MainWindow::setupWatchdog() {
+  std::chrono::milliseconds threshold = StallWatchdog::thresholdFromEnvironment();
+  if (threshold.count() == 0)
+    return;
+  watchdog = std::make_unique<StallWatchdog>(threshold, trace::activeScope());
+  // timers fire only when the event loop turns over, including the loops of modal dialogs
+  QTimer *heartbeatTimer = new QTimer(this);
+  heartbeatTimer->setInterval(std::max(threshold / 4, std::chrono::milliseconds(1)));
+  connect(heartbeatTimer, &QTimer::timeout, this, [this]() { watchdog->heartbeat(); });
+  heartbeatTimer->start();
+}
+
+void MainWindow::setActiveOperation(const QString &name) {
+  if (watchdog)
+    watchdog->setOperation(name.toStdString());
 }
 
 void MainWindow::setupUI() {
@@ -151,6 +232,13 @@ void MainWindow::setupUI() {
   dock->setWidget(histogramWidget);
   addDockWidget(Qt::RightDockWidgetArea, dock);
 
+  hud = new PerformanceHud;
+  statusBar()->addPermanentWidget(hud);
+  statusBar()->hide();
+  hudTimer = new QTimer(this);
+  hudTimer->setInterval(1000);
+  connect(hudTimer, &QTimer::timeout, this, &MainWindow::updateHudMemory);
+
   // wait with resizing till the UI fully renders
   QTimer::singleShot(0, [this]() {
     if (dock->isVisible()) {
@@ -189,15 +277,18 @@ void MainWindow::mdiSubWindowActivated(QMdiSubWindow *window) {
   }
 }
 
-void MainWindow::disconnectActions(const MdiChild &child) {
+void MainWindow::disconnectActions(MdiChild &child) {
+  // also disconnects the timing of the operations
   for (auto c : getConnections())
-    disconnect(c.action, &QAction::triggered, &child, c.slot);
+    disconnect(c.action, &QAction::triggered, &child, nullptr);
 
   for (auto c : getMainWindowActions())
-    disconnect(c.action, &QAction::triggered, this, c.slot);
+    disconnect(c.action, &QAction::triggered, this, nullptr);
 
   disconnect(&child, &MdiChild::imageUpdated, this, &MainWindow::toggleOptions);
   disconnect(&child, &MdiChild::imageUpdated, histogramWidget, &HistogramWidget::updateHistogram);
+  disconnect(&child, &MdiChild::regionSelected, histogramWidget, &HistogramWidget::showRegion);
+  disconnect(&child, &MdiChild::operationTimed, this, nullptr);
   for (auto c : getConnections())
     c.action->setEnabled(false);
 
@@ -207,15 +298,35 @@ void MainWindow::disconnectActions(const MdiChild &child) {
 }
 
 // enables all the actions that operate on the image
-void MainWindow::connectActions(const MdiChild &child) {
-  for (auto c : getConnections())
+void MainWindow::connectActions(MdiChild &child) {
+  // slots are called in the order they were connected, so the timing wraps the operation
+  for (auto c : getConnections()) {
+    QString name = actionName(c.action);
+    connect(c.action, &QAction::triggered, &child, [this, &child, name]() {
+      setActiveOperation(name);
+      child.beginOperation(name);
+    });
     connect(c.action, &QAction::triggered, &child, c.slot);
+    connect(c.action, &QAction::triggered, &child, [this, &child]() {
+      child.endOperation();
+      setActiveOperation({});
+    });
+  }
 
-  for (auto c : getMainWindowActions())
+  for (auto c : getMainWindowActions()) {
+    QString name = actionName(c.action);
+    connect(c.action, &QAction::triggered, this, [this, name]() { setActiveOperation(name); });
     connect(c.action, &QAction::triggered, this, c.slot);
+    connect(c.action, &QAction::triggered, this, [this]() { setActiveOperation({}); });
+  }
 
   connect(&child, &MdiChild::imageUpdated, this, &MainWindow::toggleOptions);
   connect(&child, &MdiChild::imageUpdated, histogramWidget, &HistogramWidget::updateHistogram);
+  connect(&child, &MdiChild::regionSelected, histogramWidget, &HistogramWidget::showRegion);
+  connect(&child, &MdiChild::operationTimed, this, [this](const OperationTiming &timing) {
+    hud->setTiming(timing);
+    updateHudMemory();
+  });
 
   for (auto c : getConnections())
     c.action->setEnabled(true);
@@ -246,7 +357,9 @@ void MainWindow::splitChannels() {
 void MainWindow::toggleOptions(const ImageWrapper &image) {
   PixelFormat format = image.getFormat();
 
-  bool isBinary = format == PixelFormat::Binary;
+  // results of morphology are grayscale again, the check is kept with the image
+  bool isBinary = format == PixelFormat::Binary ||
+                  (format == PixelFormat::Grayscale8 && image.isBinary());
   morphologyErosionAction->setEnabled(isBinary);
   morphologyDilationAction->setEnabled(isBinary);
   morphologyOpenAction->setEnabled(isBinary);
@@ -260,6 +373,8 @@ void MainWindow::toggleOptions(const ImageWrapper &image) {
   houghAction->setEnabled(isSingleChannel);
   splitChannelsAction->setEnabled(!isSingleChannel);
   profileLineAction->setEnabled(isSingleChannel);
+  bool isThreeChannel = PixelFormatUtils::toCvType(format) == CV_8UC3;
+  regionHistogramAction->setEnabled(isSingleChannel || isThreeChannel);
 }
 
 void MainWindow::duplicateImage() {
@@ -276,6 +391,40 @@ void MainWindow::duplicateImage() {
   dupChild->show();
 }
 
+void MainWindow::updateHudMemory() {
+  std::size_t bytes = 0;
+  for (const MdiChild *child : getMdiChildren())
+    bytes += child->getPixelMemory();
+  hud->setMemory(bytes, ImageHistory::getUsedMemory());
+}
+
+void MainWindow::saveTrace() {
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Save trace"), "apo-trace.json",
+                                                  tr("Chrome traces (*.json)"));
+  if (fileName.isEmpty())
+    return;
+  if (!trace::writeChromeTrace(fileName.toStdString()))
+    QMessageBox::critical(this, "Error", "Failed to save the trace to " + fileName);
+}
+
+void MainWindow::savePreviewLatencies() {
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Save preview latencies"),
+                                                  "apo-latency.csv", tr("CSV files (*.csv)"));
+  if (fileName.isEmpty())
+    return;
+  if (!interactionLatency::writeReport(fileName.toStdString()))
+    QMessageBox::critical(this, "Error", "Failed to save the latencies to " + fileName);
+}
+
+void MainWindow::saveStallReport() {
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Save stall report"), "apo-stalls.csv",
+                                                  tr("CSV files (*.csv)"));
+  if (fileName.isEmpty())
+    return;
+  if (!watchdog->writeReport(fileName.toStdString()))
+    QMessageBox::critical(this, "Error", "Failed to save the stall report to " + fileName);
+}
+
 void MainWindow::openAboutWindow() {
   QDialog window;
   QVBoxLayout *layout = new QVBoxLayout(&window);
@@ -303,6 +452,8 @@ void MainWindow::openAboutWindow() {
 
 std::vector<ActionConnection> MainWindow::getConnections() const {
   return {
+      {undoAction, &MdiChild::undo},
+      {redoAction, &MdiChild::redo},
       {toRGBAction, &MdiChild::toRGB},
       {toHSVAction, &MdiChild::toHSV},
       {toLabAction, &MdiChild::toLab},
@@ -333,8 +484,17 @@ std::vector<ActionConnection> MainWindow::getConnections() const {
       {thresholdManualAction, &MdiChild::thresholdManual},
       {thresholdAdaptiveAction, &MdiChild::thresholdAdaptive},
       {thresholdOtsuAction, &MdiChild::thresholdOtsu},
+      {thresholdAutoAction, &MdiChild::thresholdAuto},
+      {thresholdMultiOtsuAction, &MdiChild::thresholdMultiOtsu},
       {profileLineAction, &MdiChild::profileLine},
+      {regionHistogramAction, &MdiChild::regionHistogram},
+      {roiManagerAction, &MdiChild::manageRois},
       {affineTransformAction, &MdiChild::affineTransform},
+      {saveRecordedAction, &MdiChild::saveRecordedPipeline},
+      {clearRecordedAction, &MdiChild::clearRecordedPipeline},
+      {toggleLayersAction, &MdiChild::toggleLayers},
+      {editLayersAction, &MdiChild::editLayers},
+      {flattenLayersAction, &MdiChild::flattenLayers},
   };
 }
 
@@ -349,6 +509,8 @@ std::vector<MainWindowActionConnection> MainWindow::getMainWindowActions() const
       {combineORAction, &MainWindow::combineOR},
       {combineXORAction, &MainWindow::combineXOR},
       {grabCutAction, &MainWindow::grabCut},
+      {replayRecordedAction, &MainWindow::replayRecordedPipeline},
+      {replayFileAction, &MainWindow::replayPipelineFromFile},
   };
 }
 
@@ -528,3 +690,111 @@ void MainWindow::grabCut() {
   if (res.has_value())
     createImageWindow(res.value(), activeChild->getImageBasename() + " GrabCut");
 }
+
+void MainWindow::replayPipeline(const Pipeline &pipeline, const std::vector<MdiChild *> &targets) {
+  for (MdiChild *child : targets) {
+    QPointer<MdiChild> target(child);
+    // worker gets its own copy of the image so that it can't change in the meantime, its stats
+    // tell whether the window still shows the same image once the result is ready
+    std::shared_ptr<ImageStats> stats = child->getImage().getStats();
+    QThreadPool::globalInstance()->start([this, target, image = child->getImage(), stats,
+                                          pipeline]() {
+      std::optional<ImageWrapper> result;
+      QString error;
+      try {
+        result = pipeline.apply(image);
+      } catch (const std::exception &e) {
+        error = e.what();
+      }
+
+      QMetaObject::invokeMethod(
+          this,
+          [this, target, result = std::move(result), error, stats, pipeline]() {
+            // window could have been closed while the operations were running
+            if (target.isNull())
+              return;
+            if (!result.has_value()) {
+              QMessageBox::critical(this, "Error",
+                                    QString("Failed to replay operations on %1: %2")
+                                        .arg(target->getImageName(), error));
+              return;
+            }
+            // the result would overwrite whatever was done to the image in the meantime
+            if (target->getImage().getStats() != stats) {
+              QMessageBox::warning(this, "Replay operations",
+                                   QString("%1 was changed while the operations were replayed, "
+                                           "their result was discarded")
+                                       .arg(target->getImageName()));
+              return;
+            }
+            target->applyPipelineResult(result.value(), pipeline);
+          },
+          Qt::QueuedConnection);
+    });
+  }
+}
+
+void MainWindow::replayRecordedPipeline() {
+  std::vector<MdiChild *> windows = getMdiChildren();
+  std::vector<QString> names = getWindowNames(windows);
+  uint activeWindowIndex = getActiveWindowIndex(activeChild, names);
+
+  std::vector<QString> targetNames = names;
+  targetNames.push_back("All images");
+  uint allImagesIndex = targetNames.size() - 1;
+
+  auto id = [](auto i) { return i; };
+  auto res = Dialog(this, QString("Replay recorded operations"), //
+                    InputSpec<EnumVariantParam<uint>>{
+                        "Operations recorded on", {names}, activeWindowIndex, id},
+                    InputSpec<EnumVariantParam<uint>>{"Apply to", {targetNames}, allImagesIndex, id})
+                 .run();
+  if (!res.has_value())
+    return;
+
+  auto [source, target] = res.value();
+  Pipeline pipeline = windows[source]->getRecordedPipeline();
+  if (pipeline.isEmpty()) {
+    QMessageBox::information(this, "Replay recorded operations",
+                             "No operations were recorded on " + names[source]);
+    return;
+  }
+  replayPipeline(pipeline, target == allImagesIndex ? windows
+                                                    : std::vector<MdiChild *>{windows[target]});
+}
+
+void MainWindow::replayPipelineFromFile() {
+  QString filePath = QFileDialog::getOpenFileName(this, tr("Open recorded operations"), "",
+                                                  tr("Pipelines (*.json)"));
+  if (filePath.isEmpty())
+    return;
+
+  QFile file(filePath);
+  if (!file.open(QIODevice::ReadOnly)) {
+    QMessageBox::critical(this, "Error", "Failed to open " + filePath);
+    return;
+  }
+  auto pipeline = Pipeline::fromJson(file.readAll());
+  if (!pipeline.has_value()) {
+    QMessageBox::critical(this, "Error", filePath + " doesn't contain valid operations");
+    return;
+  }
+
+  std::vector<MdiChild *> windows = getMdiChildren();
+  std::vector<QString> targetNames = getWindowNames(windows);
+  uint activeWindowIndex = getActiveWindowIndex(activeChild, targetNames);
+  targetNames.push_back("All images");
+  uint allImagesIndex = targetNames.size() - 1;
+
+  auto id = [](auto i) { return i; };
+  auto target = DialogResultsUtils::unpackSingularTuple(
+      Dialog(this, QString("Replay operations from a file"), //
+             InputSpec<EnumVariantParam<uint>>{"Apply to", {targetNames}, activeWindowIndex, id})
+          .run());
+  if (!target.has_value())
+    return;
+
+  replayPipeline(pipeline.value(), target.value() == allImagesIndex
+                                       ? windows
+                                       : std::vector<MdiChild *>{windows[target.value()]});
+}
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "../stallWatchdog.hpp"
 #include "histogramWidget.hpp"
 #include "mdiChild.hpp"
+#include "performanceHud.hpp"
 #include <QLabel>
 #include <QMainWindow>
 #include <QMdiArea>
 #include <QScrollArea>
+#include <memory>
 #include <qdockwidget.h>
 #include <qimage.h>
 #include <qmdisubwindow.h>
@@ -29,14 +32,22 @@ class MainWindow : public QMainWindow {
 
 public:
   explicit MainWindow(QWidget *parent = nullptr);
+  ~MainWindow() override;
 
 private:
   QMdiArea *mdiArea;
   QDockWidget *dock;
   HistogramWidget *histogramWidget;
+  PerformanceHud *hud;
+  // refreshes the memory shown in the HUD while it's visible
+  QTimer *hudTimer;
+  // reports when the event loop stops turning over, null if disabled
+  std::unique_ptr<StallWatchdog> watchdog;
   MdiChild *activeChild = nullptr;
 
   // actions
+  QAction *undoAction;
+  QAction *redoAction;
   QAction *toRGBAction;
   QAction *toHSVAction;
   QAction *toLabAction;
@@ -76,28 +87,51 @@ private:
   QAction *thresholdManualAction;
   QAction *thresholdAdaptiveAction;
   QAction *thresholdOtsuAction;
+  QAction *thresholdAutoAction;
+  QAction *thresholdMultiOtsuAction;
   QAction *profileLineAction;
+  QAction *regionHistogramAction;
+  QAction *roiManagerAction;
   QAction *grabCutAction;
   QAction *toggleDockAction;
+  QAction *toggleHudAction;
   QAction *affineTransformAction;
+  QAction *saveRecordedAction;
+  QAction *clearRecordedAction;
+  QAction *replayRecordedAction;
+  QAction *replayFileAction;
+  QAction *toggleLayersAction;
+  QAction *editLayersAction;
+  QAction *flattenLayersAction;
 
-  void connectActions(const MdiChild &child);
-  void disconnectActions(const MdiChild &child);
+  void connectActions(MdiChild &child);
+  void disconnectActions(MdiChild &child);
   std::vector<ActionConnection> getConnections() const;
   std::vector<MainWindowActionConnection> getMainWindowActions() const;
 
   // setup functions
+  void setupWatchdog();
   void setupMenuBar();
   void setupUI();
 
   // utils
+  // operation the stalls of the UI thread are attributed to, empty once it's done
+  void setActiveOperation(const QString &name);
   std::vector<MdiChild *> getMdiChildren() const;
   void limitWindowSize(MdiChild &child) const;
   void combine(std::function<cv::Mat(cv::Mat, cv::Mat)> op, const QString &name);
   void createImageWindow(const ImageWrapper &image, const QString &name);
+  // applies pipeline to every target in the background, each image on a separate thread
+  void replayPipeline(const Pipeline &pipeline, const std::vector<MdiChild *> &targets);
 
 private slots:
   void openAboutWindow();
+  void updateHudMemory();
+  // writes recent operations in the Chrome trace format
+  void saveTrace();
+  // writes percentiles of the preview latency of every dialog used so far
+  void savePreviewLatencies();
+  void saveStallReport();
   void openImage();
   void duplicateImage();
   void splitChannels();
@@ -110,6 +144,8 @@ private slots:
   void combineOR();
   void combineXOR();
   void grabCut();
+  void replayRecordedPipeline();
+  void replayPipelineFromFile();
 };
 
 namespace {
@@ -1,13 +1,21 @@
 #include "mdiChild.hpp"
+#include "../autoThreshold.hpp"
 #include "../imageProcessor.hpp"
+#include "../operations.hpp"
+#include "../trace.hpp"
 #include "ATImageViewer.hpp"
 #include "ImageViewer.hpp"
 #include "dialogs/DialogBuilder.hpp"
 #include "dialogs/utils.hpp"
+#include <QApplication>
+#include <QFile>
 #include <QFormLayout>
 #include <QLineEdit>
+#include <QMessageBox>
 #include <QPixmap>
+#include <QPointer>
 #include <QScrollBar>
+#include <QThreadPool>
 #include <QVBoxLayout>
 #include <QtCharts/QChart>
 #include <QtCharts/QChartView>
@@ -26,9 +34,6 @@
 #include <stdexcept>
 #include <vector>
 
-using imageProcessor::applyLUT;
-using imageProcessor::applyLUTcv;
-using imageProcessor::convolve;
 using imageProcessor::LUT;
 
 MdiChild::MdiChild(ImageWrapper imageWrapper) {
@@ -53,6 +58,15 @@ MdiChild::MdiChild(ImageWrapper imageWrapper) {
 
   connect(tabWidget, &QTabWidget::currentChanged, this, &MdiChild::tabChanged);
 
+  renderTimer = new QTimer(this);
+  renderTimer->setSingleShot(true);
+  renderTimer->setInterval(15);
+  connect(renderTimer, &QTimer::timeout, this, &MdiChild::renderLayers);
+  connect(mainImage, &ImageViewer::visibleAreaChanged, this, [this]() {
+    if (layersMode)
+      renderTimer->start();
+  });
+
   setAttribute(Qt::WA_DeleteOnClose);
   setWidget(tabWidget);
   setImage(imageWrapper);
@@ -64,13 +78,54 @@ void MdiChild::setImage(const ImageWrapper &image) {
 }
 
 void MdiChild::swapImage(const ImageWrapper &image) {
+  TRACE_SCOPE("MdiChild::swapImage");
+  // the initial image isn't a change that could be undone
+  if (!imageWrapper.getMat().empty()) {
+    history.push(imageWrapper, image);
+    historyPushed();
+  }
+  showImage(image);
+}
+
+void MdiChild::swapImageLUT(const LUT &lut) {
+  TRACE_SCOPE("MdiChild::swapImageLUT");
+  swapImageLUT(ImageWrapper(imageProcessor::applyLUTcv(imageWrapper.getMat(), lut)), lut);
+}
+
+void MdiChild::swapImageLUT(const ImageWrapper &image, const LUT &lut) {
+  imageProcessor::deriveHistograms(imageWrapper, image, lut);
+  history.pushLUT(imageWrapper, image, lut);
+  historyPushed();
+  showImage(image);
+}
+
+void MdiChild::showImage(const ImageWrapper &image) {
+  TRACE_SCOPE("MdiChild::showImage");
   imageWrapper = image;
-  QPixmap pixmap = imageWrapper.generateQPixmap();
-  mainImage->setImage(pixmap);
-  updateChannelNames();
-  regenerateChannels();
-  emitImageUpdatedSignal();
+  displayImage();
+}
+
+void MdiChild::displayImage() {
+  TRACE_SCOPE("MdiChild::displayImage");
+  timing.compute += lap();
+  if (layersMode) {
+    // the layers share the pixels and the histograms with `imageWrapper` as they're never
+    // modified in place
+    layers.setBase(imageWrapper.sharedCopy());
+    updateChannelNames();
+    renderLayers();
+    computeBaseHistograms();
+  } else {
+    QPixmap pixmap = imageWrapper.generateQPixmap();
+    mainImage->setImage(pixmap);
+    updateChannelNames();
+    regenerateChannels();
+    timing.display += lap();
+    emitImageUpdatedSignal();
+    timing.histogram += lap();
+  }
   setImageName(imageName); // update type in the window title
+  finishOperation();
 }
 
 void MdiChild::trySwapImage(const std::optional<ImageWrapper> &image) {
@@ -78,11 +133,315 @@ void MdiChild::trySwapImage(const std::optional<ImageWrapper> &image) {
     swapImage(image.value());
 }
 
+void MdiChild::applyPipelineResult(const ImageWrapper &image, const Pipeline &pipeline) {
+  swapImage(image);
+  recordedPipeline.append(pipeline);
+}
+
+void MdiChild::beginOperation(const QString &name) {
+  timing = {name};
+  operationTimer.start();
+}
+
+void MdiChild::endOperation() { operationTimer.invalidate(); }
+
+double MdiChild::lap() {
+  if (!operationTimer.isValid())
+    return 0;
+  double ms = operationTimer.nsecsElapsed() / 1e6;
+  operationTimer.start();
+  return ms;
+}
+
+void MdiChild::finishOperation() {
+  if (!operationTimer.isValid())
+    return;
+  operationTimer.invalidate();
+  emit operationTimed(timing);
+}
+
+std::size_t MdiChild::getPixelMemory() const {
+  auto matBytes = [](const ImageWrapper &image) {
+    return image.getMat().total() * image.getMat().elemSize();
+  };
+  std::size_t bytes = matBytes(imageWrapper) + matBytes(layersView);
+  for (const ImageWrapper *channel : {&imageWrapper1, &imageWrapper2, &imageWrapper3})
+    bytes += matBytes(*channel);
+  for (const ImageViewer *viewer : {mainImage, image1, image2, image3}) {
+    QPixmap pixmap = viewer->getImage();
+    bytes += static_cast<std::size_t>(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+  }
+  return bytes;
+}
+
+void MdiChild::recordStep(const QString &operation, const QJsonArray &params) {
+  recordedPipeline.append({operation, params});
+}
+
+void MdiChild::historyPushed() {
+  recordedSizes.push_back(recordedPipeline.size());
+  undoneSteps.clear();
+}
+
+bool MdiChild::pushLayer(const QString &operation, const QJsonArray &params) {
+  if (!layersMode)
+    return false;
+  layers.push({operation, params});
+  undoneLayers.clear();
+  layersChanged();
+  return true;
+}
+
+void MdiChild::layersChanged() {
+  if (layersPanel != nullptr)
+    layersPanel->setLayers(layers.getLayers());
+  renderLayers();
+}
+
+void MdiChild::computeBaseHistograms() {
+  std::shared_ptr<ImageStats> stats = imageWrapper.getStats();
+  if (!stats || stats->cachedHistograms().has_value())
+    return;
+  // the histogram dock shows the rendered layers, so nobody else counts the base's pixels
+  QPointer<MdiChild> self(this);
+  QThreadPool::globalInstance()->start([self, stats, mat = imageWrapper.getMat()]() {
+    stats->histograms(mat);
+    QMetaObject::invokeMethod(
+        qApp,
+        [self, stats]() {
+          // the layers made from a sample are made again from the exact histograms
+          if (!self.isNull() && self->layersMode && self->imageWrapper.getStats() == stats)
+            self->renderLayers();
+        },
+        Qt::QueuedConnection);
+  });
+}
+
+bool MdiChild::renderLayers() {
+  TRACE_SCOPE("MdiChild::renderLayers");
+  if (!layersMode)
+    return true;
+
+  timing.compute += lap();
+  QRectF visible = mainImage->getVisibleImageRect();
+  LayerStack::View view;
+  try {
+    view = layers.render(cv::Rect2d(visible.x(), visible.y(), visible.width(), visible.height()),
+                         mainImage->getDisplayScale());
+  } catch (const std::exception &e) {
+    QMessageBox::warning(this, "Adjustment layers", e.what());
+    return false;
+  }
+  timing.compute += lap();
+  if (view.image.getMat().empty()) {
+    finishOperation();
+    return true;
+  }
+
+  layersView = std::move(view.image);
+  QRectF area(view.area.x, view.area.y, view.area.width, view.area.height);
+  mainImage->setImagePart(layersView.generateQPixmap(), area, getImageSize());
+  timing.display += lap();
+  if (tabIndex == 0)
+    emitImageUpdatedSignal();
+  timing.histogram += lap();
+  finishOperation();
+  return true;
+}
+
+void MdiChild::setLayersMode(bool enabled) {
+  if (enabled == layersMode)
+    return;
+  if (!enabled)
+    flattenLayers();
+
+  layersMode = enabled;
+  layersView = ImageWrapper();
+  if (enabled)
+    tabWidget->setCurrentIndex(0);
+  displayImage();
+}
+
+void MdiChild::toggleLayers() { setLayersMode(!layersMode); }
+
+void MdiChild::editLayers() {
+  TRACE_SCOPE("MdiChild::editLayers");
+  setLayersMode(true);
+  if (layersDialog == nullptr) {
+    layersDialog = new QDialog(this);
+    layersDialog->setWindowTitle("Adjustment layers");
+    QVBoxLayout *layout = new QVBoxLayout(layersDialog);
+    layersPanel = new LayersPanel(layersDialog);
+    layout->addWidget(layersPanel);
+
+    connect(layersPanel, &LayersPanel::layerEnabledChanged, this, [this](int index, bool enabled) {
+      layers.setEnabled(index, enabled);
+      renderLayers();
+    });
+    connect(layersPanel, &LayersPanel::layerParamsChanged, this,
+            [this](int index, QJsonArray params) {
+              QJsonArray previous = layers.getLayers()[index].step.params;
+              layers.setParams(index, params);
+              if (renderLayers())
+                return;
+              layers.setParams(index, previous);
+              layersChanged();
+            });
+    connect(layersPanel, &LayersPanel::layerRemoved, this, [this](int index) {
+      layers.remove(index);
+      layersChanged();
+    });
+  }
+  layersPanel->setLayers(layers.getLayers());
+  layersDialog->show();
+  layersDialog->raise();
+  layersDialog->activateWindow();
+}
+
+std::optional<ImageWrapper> MdiChild::inspectedImage() {
+  if (!layersMode || layers.isEmpty())
+    return tabIndex == 0 ? imageWrapper : getImageWrapper(tabIndex);
+  try {
+    return layers.materialize();
+  } catch (const std::exception &e) {
+    QMessageBox::critical(this, "Adjustment layers", e.what());
+    return std::nullopt;
+  }
+}
+
+std::optional<ImageStats::Histograms> MdiChild::shownHistograms() {
+  // counted right away if they aren't known yet, the layers then use them instead of a sample and
+  // the thresholds picked in the dialog are the ones flattening the layers applies
+  ImageStats::Histograms exact = imageWrapper.histograms();
+  if (!layersMode)
+    return exact;
+  try {
+    return layers.topHistograms();
+  } catch (const std::exception &e) {
+    QMessageBox::critical(this, "Adjustment layers", e.what());
+    return std::nullopt;
+  }
+}
+
+void MdiChild::flattenLayers() {
+  TRACE_SCOPE("MdiChild::flattenLayers");
+  if (layers.isEmpty())
+    return;
+
+  Pipeline pipeline = layers.toPipeline();
+  if (!pipeline.isEmpty()) {
+    ImageWrapper image;
+    try {
+      image = layers.materialize();
+    } catch (const std::exception &e) {
+      QMessageBox::critical(this, "Adjustment layers", e.what());
+      return;
+    }
+    layers.clear();
+    applyPipelineResult(image, pipeline);
+  } else {
+    layers.clear();
+  }
+  undoneLayers.clear();
+  layersChanged();
+}
+
+template <typename... Params, typename Op>
+std::optional<cv::Mat> MdiChild::runOperationDialog(const QString &operation,
+                                                    Dialog<Params...> &dialog, Op op) {
+  // with adjustment layers the preview is computed for what's currently displayed
+  bool previewView = layersMode && !layersView.getMat().empty();
+  cv::Mat mat = previewView ? layersView.getMat() : imageWrapper.getMat();
+  double computeTime = 0;
+  auto res = dialog.runWithPreview(
+      [mat, op, &computeTime](const auto &...params) -> std::optional<cv::Mat> {
+        QElapsedTimer timer;
+        timer.start();
+        std::optional<cv::Mat> result = op(mat, params...);
+        computeTime = timer.nsecsElapsed() / 1e6;
+        return result;
+      });
+  if (!res.has_value())
+    return std::nullopt;
+  // the time spent in the dialog is covered by the preview events
+  TRACE_SCOPE("MdiChild::applyOperation");
+  // the operation is timed from here so that the time the dialog was open isn't counted,
+  // the name given when the action was triggered is kept
+  beginOperation(timing.operation.isEmpty() ? operation : timing.operation);
+  timing.compute = computeTime;
+  timing.preview = dialog.getPreviewLatency();
+  if (pushLayer(operation, ParamCodec::encodeParams(dialog.getAcceptedParams().value())))
+    return std::nullopt;
+  return res;
+}
+
+template <typename... Params, typename Op>
+void MdiChild::applyOperation(const QString &operation, Dialog<Params...> &&dialog, Op op,
+                              bool requireBinary) {
+  auto res = runOperationDialog(operation, dialog, op);
+  if (!res.has_value())
+    return;
+
+  ImageWrapper image(res.value());
+  if (requireBinary) {
+    auto binary = image.toBinary();
+    if (!binary.has_value())
+      return;
+    image = binary.value();
+  }
+  swapImage(image);
+  recordStep(operation, ParamCodec::encodeParams(dialog.getAcceptedParams().value()));
+}
+
+template <typename... Params, typename MakeLUT>
+void MdiChild::applyLUTOperation(const QString &operation, Dialog<Params...> &&dialog,
+                                 MakeLUT makeLUT) {
+  auto res = runOperationDialog(operation, dialog, [makeLUT](const cv::Mat &mat, auto... params) {
+    return imageProcessor::applyLUTcv(mat, makeLUT(params...));
+  });
+  if (!res.has_value())
+    return;
+
+  LUT lut = std::apply(makeLUT, dialog.getAcceptedParams().value());
+  swapImageLUT(ImageWrapper(res.value()), lut);
+  recordStep(operation, ParamCodec::encodeParams(dialog.getAcceptedParams().value()));
+}
+
+void MdiChild::saveRecordedPipeline() {
+  TRACE_SCOPE("MdiChild::saveRecordedPipeline");
+  if (recordedPipeline.isEmpty()) {
+    QMessageBox::information(this, "Save recorded operations", "No operations were recorded yet.");
+    return;
+  }
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Save recorded operations"),
+                                                  getImageBasename() + ".json",
+                                                  tr("Pipelines (*.json)"));
+  if (fileName.isEmpty())
+    return;
+
+  QFile file(fileName);
+  if (!file.open(QIODevice::WriteOnly)) {
+    QMessageBox::critical(this, "Error", "Failed to save the pipeline to " + fileName);
+    return;
+  }
+  file.write(recordedPipeline.toJson());
+}
+
+void MdiChild::clearRecordedPipeline() {
+  recordedPipeline.clear();
+  // undo and redo still work, they just have nothing left to take from the recording
+  for (std::vector<PipelineStep> &steps : undoneSteps)
+    steps.clear();
+}
+
 void MdiChild::updateChannelNames() {
   auto imageFormat = imageWrapper.getFormat();
   tabWidget->removeTab(3);
   tabWidget->removeTab(2);
   tabWidget->removeTab(1);
+  // channels would show the image without the layers
+  if (layersMode)
+    return;
   if (PixelFormatUtils::toCvType(imageFormat) == CV_8UC3) {
     auto names = PixelFormatUtils::channelNames(imageFormat);
     tabWidget->addTab(image1, QString::fromStdString(names[0]));
@@ -91,27 +450,82 @@ void MdiChild::updateChannelNames() {
   }
 }
 
+void MdiChild::undo() {
+  TRACE_SCOPE("MdiChild::undo");
+  if (layersMode && !layers.isEmpty()) {
+    undoneLayers.push_back(layers.pop().value());
+    layersChanged();
+    return;
+  }
+  auto image = history.undo(imageWrapper);
+  if (!image.has_value())
+    return;
+  // the oldest changes may have been forgotten by the history, never the latest ones
+  if (!recordedSizes.empty()) {
+    undoneSteps.push_back(recordedPipeline.removeFrom(recordedSizes.back()));
+    recordedSizes.pop_back();
+  }
+  showImage(image.value());
+}
+
+void MdiChild::redo() {
+  TRACE_SCOPE("MdiChild::redo");
+  if (layersMode && !undoneLayers.empty()) {
+    AdjustmentLayer layer = std::move(undoneLayers.back());
+    undoneLayers.pop_back();
+    layers.push(layer.step);
+    layers.setEnabled(layers.getLayers().size() - 1, layer.enabled);
+    layersChanged();
+    return;
+  }
+  auto image = history.redo(imageWrapper);
+  if (!image.has_value())
+    return;
+  recordedSizes.push_back(recordedPipeline.size());
+  if (!undoneSteps.empty()) {
+    for (PipelineStep &step : undoneSteps.back())
+      recordedPipeline.append(std::move(step));
+    undoneSteps.pop_back();
+  }
+  showImage(image.value());
+}
+
 void MdiChild::toGrayscale() {
-  imageWrapper = imageWrapper.toGrayscale();
-  swapImage(imageWrapper);
+  TRACE_SCOPE("MdiChild::toGrayscale");
+  if (pushLayer("toGrayscale"))
+    return;
+  swapImage(imageWrapper.toGrayscale());
+  recordStep("toGrayscale");
 }
 void MdiChild::toLab() {
-  imageWrapper = imageWrapper.toLab();
-  swapImage(imageWrapper);
+  TRACE_SCOPE("MdiChild::toLab");
+  if (pushLayer("toLab"))
+    return;
+  swapImage(imageWrapper.toLab());
+  recordStep("toLab");
 }
 void MdiChild::toHSV() {
-  imageWrapper = imageWrapper.toHSV();
-  swapImage(imageWrapper);
+  TRACE_SCOPE("MdiChild::toHSV");
+  if (pushLayer("toHSV"))
+    return;
+  swapImage(imageWrapper.toHSV());
+  recordStep("toHSV");
 }
 void MdiChild::toRGB() {
-  imageWrapper = imageWrapper.toRGB();
-  swapImage(imageWrapper);
+  TRACE_SCOPE("MdiChild::toRGB");
+  if (pushLayer("toRGB"))
+    return;
+  swapImage(imageWrapper.toRGB());
+  recordStep("toRGB");
 }
 
 void MdiChild::setImageName(QString name) {
   imageName = name;
   std::string imageFormat = PixelFormatUtils::toString(imageWrapper.getFormat());
-  setWindowTitle(QString("[%1] %2").arg(QString::fromStdString(imageFormat), name));
+  QString title = QString("[%1] %2").arg(QString::fromStdString(imageFormat), name);
+  if (layersMode)
+    title += " (adjustment layers)";
+  setWindowTitle(title);
 }
 
 void MdiChild::fitImage() {
@@ -139,7 +553,7 @@ ImageViewer &MdiChild::getImageViewer(int index) const {
 const ImageWrapper &MdiChild::getImageWrapper(int index) const {
   switch (index) {
   case 0:
-    return imageWrapper;
+    return layersMode && !layersView.getMat().empty() ? layersView : imageWrapper;
   case 1:
     return imageWrapper1;
   case 2:
@@ -159,6 +573,9 @@ void MdiChild::tabChanged(int newTabIndex) {
 
   // set the image's zoom and pan to whatever the user had in the previous tab
   getImageViewer(newTabIndex).useImageTransform(getImageViewer(tabIndex));
+  // the dock goes back to the histogram of the whole image
+  getImageViewer(tabIndex).cancelGetROIFromUser();
+  getImageViewer(tabIndex).clearROI();
 
   tabIndex = newTabIndex;
   emitImageUpdatedSignal();
@@ -176,11 +593,26 @@ QString MdiChild::getImageNameSuffix() const {
   return fileInfo.completeSuffix();
 }
 
-void MdiChild::negate() { swapImage(applyLUT(imageWrapper, imageProcessor::negate())); }
+void MdiChild::negate() {
+  TRACE_SCOPE("MdiChild::negate");
+  if (pushLayer("negate"))
+    return;
+  swapImageLUT(imageProcessor::negate());
+  recordStep("negate");
+}
 
 void MdiChild::regenerateChannels() {
-  if (imageWrapper.getMat().channels() != 3)
+  TRACE_SCOPE("MdiChild::regenerateChannels");
+  if (imageWrapper.getMat().channels() != 3) {
+    // channels of the previous image would only take up memory
+    imageWrapper1 = ImageWrapper();
+    imageWrapper2 = ImageWrapper();
+    imageWrapper3 = ImageWrapper();
+    image1->clear();
+    image2->clear();
+    image3->clear();
     return;
+  }
 
   std::vector<ImageWrapper> imageWrappers = imageWrapper.splitChannels();
 
@@ -200,34 +632,53 @@ void MdiChild::regenerateChannels() {
   image3->setImage(pixmap3);
 }
 
-void MdiChild::normalize() { swapImage(imageProcessor::normalizeChannels(imageWrapper.getMat())); }
-
-void MdiChild::equalize() { swapImage(imageProcessor::equalizeChannels(imageWrapper.getMat())); }
-
-void MdiChild::rangeStretch() {
-  cv::Mat mat = imageWrapper.getMat();
-  auto previewFn = [mat](uchar p1, uchar p2, uchar q3, uchar q4) {
-    return imageProcessor::rangeStretchChannels(mat, p1, p2, q3, q4);
-  };
-
-  auto im = Dialog(this, QString("Enter parameters"), //
-                   InputSpec<IntParam>{"p1", {0, 255}, 0}, InputSpec<IntParam>{"p2", {0, 255}, 255},
-                   InputSpec<IntParam>{"q3", {0, 255}, 0}, InputSpec<IntParam>{"q4", {0, 255}, 255})
-                .runWithPreview(previewFn);
+void MdiChild::normalize() {
+  TRACE_SCOPE("MdiChild::normalize");
+  if (pushLayer("normalize"))
+    return;
+  swapImage(imageProcessor::normalizeChannels(imageWrapper));
+  recordStep("normalize");
+}
 
-  if (!im.has_value())
+void MdiChild::equalize() {
+  TRACE_SCOPE("MdiChild::equalize");
+  if (pushLayer("equalize"))
     return;
+  swapImage(imageProcessor::equalizeChannels(imageWrapper));
+  recordStep("equalize");
+}
 
-  swapImage(im.value());
+void MdiChild::rangeStretch() {
+  TRACE_SCOPE("MdiChild::rangeStretch");
+  applyLUTOperation("rangeStretch",
+                    Dialog(this, QString("Enter parameters"), //
+                           InputSpec<IntParam>{"p1", {0, 255}, 0},
+                           InputSpec<IntParam>{"p2", {0, 255}, 255},
+                           InputSpec<IntParam>{"q3", {0, 255}, 0},
+                           InputSpec<IntParam>{"q4", {0, 255}, 255}),
+                    [](int p1, int p2, int q3, int q4) {
+                      return imageProcessor::stretch(p1, p2, q3, q4);
+                    });
 }
 
 void MdiChild::save() {
+  TRACE_SCOPE("MdiChild::save");
   QString fileName = QFileDialog::getSaveFileName(this, tr("Save File"), imageName,
                                                   tr("Images (*.png *.jpg *.jpeg *.bmp)"));
-  imageWrapper.generateQImage().save(fileName);
+  if (!layersMode) {
+    imageWrapper.generateQImage().save(fileName);
+    return;
+  }
+  // layers are evaluated at the full resolution only now
+  try {
+    layers.materialize().generateQImage().save(fileName);
+  } catch (const std::exception &e) {
+    QMessageBox::critical(this, "Adjustment layers", e.what());
+  }
 }
 
 void MdiChild::rename() {
+  TRACE_SCOPE("MdiChild::rename");
   QDialog dialog(this);
   dialog.setWindowTitle("Set image name");
 
@@ -248,105 +699,75 @@ void MdiChild::rename() {
 }
 
 void MdiChild::posterize() {
-  trySwapImage(
-      Dialog(this, QString("Enter number of levels"), InputSpec<IntParam>{"N", {1, 255}, 2})
-          .runWithPreview([this](int n) {
-            LUT lut = imageProcessor::posterize(n);
-            return applyLUTcv(imageWrapper.getMat(), lut);
-          }));
+  TRACE_SCOPE("MdiChild::posterize");
+  applyLUTOperation("posterize",
+                    Dialog(this, QString("Enter number of levels"),
+                           InputSpec<IntParam>{"N", {1, 255}, 2}),
+                    imageProcessor::posterize);
 }
 
 void MdiChild::blurMean() {
-  trySwapImage(Dialog(this, QString("Select kernel size and border type"), //
-                      KernelSizes::inputSpec,                              //
-                      BorderTypes::inputSpec)
-                   .runWithPreview([this](int k, int borderType) {
-                     cv::Mat out;
-                     cv::blur(imageWrapper.getMat(), out, cv::Size(k, k), cv::Point(-1, -1),
-                              borderType);
-                     return out;
-                   }));
+  TRACE_SCOPE("MdiChild::blurMean");
+  applyOperation("blurMean",
+                 Dialog(this, QString("Select kernel size and border type"), //
+                        KernelSizes::inputSpec,                              //
+                        BorderTypes::inputSpec),
+                 operations::blurMean);
 }
 
 void MdiChild::blurMedian() {
-  trySwapImage(Dialog(this, QString("Select kernel size"), KernelSizes::inputSpec)
-                   .runWithPreview([this](int k) {
-                     cv::Mat out;
-                     cv::medianBlur(imageWrapper.getMat(), out, k);
-                     return out;
-                   }));
+  TRACE_SCOPE("MdiChild::blurMedian");
+  applyOperation("blurMedian",
+                 Dialog(this, QString("Select kernel size"), KernelSizes::inputSpec),
+                 operations::blurMedian);
 }
 
 void MdiChild::blurGaussian() {
-  auto mat =
-      Dialog(this, QString("Enter Gaussian blur parameters"), //
-             KernelSizes::inputSpec,                          //
-             BorderTypes::inputSpec,                          //
-             InputSpec<DoubleParam>{"σ (std dev)", {}, 1.0})
-          .runWithPreview([this](int k, int borderType, double sigma) {
-            cv::Mat out;
-            cv::GaussianBlur(imageWrapper.getMat(), out, cv::Size(k, k), sigma, 0, borderType);
-            return out;
-          });
-
-  if (mat.has_value())
-    swapImage(mat.value());
+  TRACE_SCOPE("MdiChild::blurGaussian");
+  applyOperation("blurGaussian",
+                 Dialog(this, QString("Enter Gaussian blur parameters"), //
+                        KernelSizes::inputSpec,                          //
+                        BorderTypes::inputSpec,                          //
+                        InputSpec<DoubleParam>{"σ (std dev)", {}, 1.0}),
+                 operations::blurGaussian);
 }
 
 void MdiChild::edgeDetectSobel() {
-  trySwapImage(Dialog(this, QString("Enter Sobel's filter parameters"),
-                      KernelSizes::inputSpec, //
-                      BorderTypes::inputSpec, //
-                      SobelDirections::inputSpec)
-                   .runWithPreview([this](int k, int borderType, SobelDirections::Enum dir) {
-                     cv::Mat out;
-                     if (dir == SobelDirections::Horizontal)
-                       cv::Sobel(imageWrapper.getMat(), out, CV_8UC1, 0, 1, k, 1, 0, borderType);
-                     else
-                       cv::Sobel(imageWrapper.getMat(), out, CV_8UC1, 1, 0, k, 1, 0, borderType);
-                     return out;
-                   }));
+  TRACE_SCOPE("MdiChild::edgeDetectSobel");
+  applyOperation("edgeDetectSobel",
+                 Dialog(this, QString("Enter Sobel's filter parameters"),
+                        KernelSizes::inputSpec, //
+                        BorderTypes::inputSpec, //
+                        SobelDirections::inputSpec),
+                 operations::edgeDetectSobel);
 }
 void MdiChild::edgeDetectLaplacian() {
-  trySwapImage(Dialog(this, QString("Select kernel size and border type"),
-                      KernelSizes::inputSpec, //
-                      BorderTypes::inputSpec)
-                   .runWithPreview([this](int k, int borderType) {
-                     cv::Mat out;
-                     cv::Laplacian(imageWrapper.getMat(), out, CV_8UC1, k, 1, 0, borderType);
-                     return out;
-                   }));
+  TRACE_SCOPE("MdiChild::edgeDetectLaplacian");
+  applyOperation("edgeDetectLaplacian",
+                 Dialog(this, QString("Select kernel size and border type"),
+                        KernelSizes::inputSpec, //
+                        BorderTypes::inputSpec),
+                 operations::edgeDetectLaplacian);
 }
 
 void MdiChild::edgeDetectCanny() {
-  auto mat =
-      Dialog(this, QString("Enter Canny's filter parameters"),
-             KernelSizes::inputSpec, //
-             BorderTypes::inputSpec, //
-             InputSpec<IntParam>{"Start (0-255)", {0, 255}, 0},
-             InputSpec<IntParam>{"End (0-255)", {0, 255}, 255})
-          .runWithPreview([this](int k, int borderType, int start, int end) {
-            // manually padding
-            int pad = k / 2;
-            cv::Mat padded;
-            cv::copyMakeBorder(imageWrapper.getMat(), padded, pad, pad, pad, pad, borderType);
-
-            cv::Mat out;
-            cv::Canny(padded, out, start, end, k);
-            return out;
-          });
-
-  trySwapImage(mat);
+  TRACE_SCOPE("MdiChild::edgeDetectCanny");
+  applyOperation("edgeDetectCanny",
+                 Dialog(this, QString("Enter Canny's filter parameters"),
+                        KernelSizes::inputSpec, //
+                        BorderTypes::inputSpec, //
+                        InputSpec<IntParam>{"Start (0-255)", {0, 255}, 0},
+                        InputSpec<IntParam>{"End (0-255)", {0, 255}, 255}),
+                 operations::edgeDetectCanny);
 }
 
 void MdiChild::ask4maskAndApply(const std::vector<cv::Mat> &mats,
                                 const std::vector<QString> &names) {
-  trySwapImage(Dialog(this, QString("Select a mask"),                           //
-                      InputSpec<ChoosableMaskParam>{"Masks", {mats, names}, 0}, //
-                      BorderTypes::inputSpec)
-                   .runWithPreview([this](cv::Mat kernel, int borderType) {
-                     return convolve(imageWrapper.getMat(), kernel, borderType);
-                   }));
+  applyOperation("convolve",
+                 Dialog(this, QString("Select a mask"),                           //
+                        InputSpec<ChoosableMaskParam>{"Masks", {mats, names}, 0}, //
+                        BorderTypes::inputSpec),
+                 operations::convolve);
 }
 
 void MdiChild::sharpenLaplacian() { ask4maskAndApply(LaplacianMasks::mats, LaplacianMasks::names); }
@@ -356,129 +777,120 @@ void MdiChild::edgeDetectPrewitt() { ask4maskAndApply(PrewittMasks::mats, Prewit
 void MdiChild::customMask() { ask4maskAndApply({UnitKernel::mat3}, {}); }
 
 void MdiChild::customTwoStageFilter() {
-  trySwapImage(Dialog(this, QString("Convolve a mask"),
-                      InputSpec<ComposableMaskParam>{"Mask", {}, UnitKernel::mat3},
-                      BorderTypes::inputSpec)
-                   .runWithPreview([this](cv::Mat kernel, int borderType) {
-                     return convolve(imageWrapper.getMat(), kernel, borderType);
-                   }));
+  TRACE_SCOPE("MdiChild::customTwoStageFilter");
+  applyOperation("convolve",
+                 Dialog(this, QString("Convolve a mask"),
+                        InputSpec<ComposableMaskParam>{"Mask", {}, UnitKernel::mat3},
+                        BorderTypes::inputSpec),
+                 operations::convolve);
 }
-void MdiChild::ask4structuringElementAndApply(
-    std::function<std::optional<cv::Mat>(StructuringElement::ValueType, BorderTypes::ValueType)>
-        fn) {
-  trySwapImage(Dialog(this, QString("Select a structuring element"), StructuringElement::inputSpec,
-                      BorderTypes::inputSpec)
-                   .runWithPreview(fn));
+void MdiChild::ask4structuringElementAndApply(const QString &operation,
+                                              cv::Mat (*op)(const cv::Mat &, const cv::Mat &,
+                                                            int)) {
+  applyOperation(operation,
+                 Dialog(this, QString("Select a structuring element"),
+                        StructuringElement::inputSpec, BorderTypes::inputSpec),
+                 op);
 }
 
 void MdiChild::morphologyErode() {
-  ask4structuringElementAndApply([this](cv::Mat kernel, int borderType) {
-    cv::Mat out;
-    cv::erode(imageWrapper.getMat(), out, kernel, cv::Point(-1, -1), 1, borderType);
-    return out;
-  });
+  TRACE_SCOPE("MdiChild::morphologyErode");
+  ask4structuringElementAndApply("morphologyErode", operations::morphologyErode);
 }
 
 void MdiChild::morphologyDilate() {
-  ask4structuringElementAndApply([this](cv::Mat kernel, int borderType) {
-    cv::Mat out;
-    cv::dilate(imageWrapper.getMat(), out, kernel, cv::Point(-1, -1), 1, borderType);
-    return out;
-  });
+  TRACE_SCOPE("MdiChild::morphologyDilate");
+  ask4structuringElementAndApply("morphologyDilate", operations::morphologyDilate);
 }
 
 void MdiChild::morphologyOpen() {
-  ask4structuringElementAndApply([this](cv::Mat kernel, int borderType) {
-    cv::Mat out;
-    cv::morphologyEx(imageWrapper.getMat(), out, cv::MORPH_OPEN, kernel, cv::Point(-1, -1), 1,
-                     borderType);
-    return out;
-  });
+  TRACE_SCOPE("MdiChild::morphologyOpen");
+  ask4structuringElementAndApply("morphologyOpen", operations::morphologyOpen);
 }
 
 void MdiChild::morphologyClose() {
-  ask4structuringElementAndApply([this](cv::Mat kernel, int borderType) {
-    cv::Mat out;
-    cv::morphologyEx(imageWrapper.getMat(), out, cv::MORPH_CLOSE, kernel, cv::Point(-1, -1), 1,
-                     borderType);
-    return out;
-  });
+  TRACE_SCOPE("MdiChild::morphologyClose");
+  ask4structuringElementAndApply("morphologyClose", operations::morphologyClose);
 }
 
 void MdiChild::morphologySkeletonize() {
-  ask4structuringElementAndApply([this](cv::Mat kernel, int borderType) {
-    return imageProcessor::skeletonize(imageWrapper.getMat(), kernel, borderType);
-  });
+  TRACE_SCOPE("MdiChild::morphologySkeletonize");
+  ask4structuringElementAndApply("morphologySkeletonize", operations::morphologySkeletonize);
 }
 
 void MdiChild::houghTransform() {
-  trySwapImage(Dialog(this, QString("Hough Transform"), //
-                      InputSpec<IntParam>{"Rho (px)", {1, 100}, 1},
-                      InputSpec<IntParam>{"Theta (°)", {1, 180}, 1},
-                      InputSpec<IntParam>{"Threshold", {1, 200}, 100})
-                   .runWithPreview([this](int rho, int thetaDeg, int threshold) {
-                     const double theta = CV_PI * thetaDeg / 180.0;
-                     std::vector<cv::Vec4i> lines;
-
-                     std::vector<cv::Vec2f> linesPolar;
-                     cv::HoughLines(imageWrapper.getMat(), linesPolar, rho, theta, threshold);
-
-                     // Convert to endpoints (approx)
-                     for (const auto &l : linesPolar) {
-                       float r = l[0], t = l[1];
-                       double a = std::cos(t), b = std::sin(t);
-                       double x0 = a * r, y0 = b * r;
-                       int x1 = cvRound(x0 + 1000 * (-b));
-                       int y1 = cvRound(y0 + 1000 * (a));
-                       int x2 = cvRound(x0 - 1000 * (-b));
-                       int y2 = cvRound(y0 - 1000 * (a));
-                       lines.push_back(cv::Vec4i(x1, y1, x2, y2));
-                     }
-
-                     cv::Mat out = imageWrapper.toRGB().getMat();
-                     for (const auto &l : lines)
-                       cv::line(out, {l[0], l[1]}, {l[2], l[3]}, cv::Scalar(255, 0, 0), 2);
-                     return out;
-                   }));
+  TRACE_SCOPE("MdiChild::houghTransform");
+  applyOperation("houghTransform",
+                 Dialog(this, QString("Hough Transform"), //
+                        InputSpec<IntParam>{"Rho (px)", {1, 100}, 1},
+                        InputSpec<IntParam>{"Theta (°)", {1, 180}, 1},
+                        InputSpec<IntParam>{"Threshold", {1, 200}, 100}),
+                 operations::houghTransform);
 }
 
 void MdiChild::thresholdManual() {
-  auto res =
-      Dialog(this, QString("Threshold"), //
-             InputSpec<IntParam>{"Threshold", {0, 255}, 42})
-          .runWithPreview([this](int t) {
-            cv::Mat out;
-            cv::threshold(imageWrapper.getMat(), out, t, 255, cv::ThresholdTypes::THRESH_BINARY);
-            return out;
-          });
-  if (res.has_value())
-    trySwapImage(ImageWrapper(res.value()).toBinary());
+  TRACE_SCOPE("MdiChild::thresholdManual");
+  applyOperation("thresholdManual",
+                 Dialog(this, QString("Threshold"), //
+                        InputSpec<IntParam>{"Threshold", {0, 255}, 42}),
+                 operations::thresholdManual, true);
 }
 void MdiChild::thresholdAdaptive() {
-  auto res = Dialog(this, QString("Adaptive threshold"),                      //
-                    AdaptiveThresholdTypes::inputSpec,                        //
-                    InputSpec<SteppedIntParam>{"block size", {3, 255, 2}, 3}, //
-                    InputSpec<IntParam>{"C (value to subtract from mean)", {0, 255}, 0})
-                 .runWithPreview([this](cv::AdaptiveThresholdTypes type, int blockSize, int c) {
-                   return imageProcessor::applyToChannels(
-                       imageWrapper.getMat(), [type, blockSize, c](cv::Mat channel) {
-                         cv::Mat out;
-                         cv::adaptiveThreshold(channel, out, 255, type,
-                                               cv::ThresholdTypes::THRESH_BINARY, blockSize, c);
-                         return out;
-                       });
-                 });
-  if (res.has_value())
-    trySwapImage(ImageWrapper(res.value()).toBinary());
+  TRACE_SCOPE("MdiChild::thresholdAdaptive");
+  applyOperation("thresholdAdaptive",
+                 Dialog(this, QString("Adaptive threshold"),                      //
+                        AdaptiveThresholdTypes::inputSpec,                        //
+                        InputSpec<SteppedIntParam>{"block size", {3, 255, 2}, 3}, //
+                        InputSpec<IntParam>{"C (value to subtract from mean)", {0, 255}, 0}),
+                 operations::thresholdAdaptive, true);
 }
 void MdiChild::thresholdOtsu() {
-  trySwapImage(
-      ImageWrapper(imageProcessor::applyToChannels(imageWrapper.getMat(), [](cv::Mat channel) {
-        cv::Mat out;
-        double t = cv::threshold(channel, out, 0, 255, cv::ThresholdTypes::THRESH_OTSU);
-        cv::threshold(channel, out, t, 255, cv::ThresholdTypes::THRESH_BINARY);
-        return out;
-      })).toBinary());
+  TRACE_SCOPE("MdiChild::thresholdOtsu");
+  if (pushLayer("thresholdOtsu"))
+    return;
+  // the histograms are usually known already, then the pixels are only read to be thresholded
+  ImageStats::Histograms hists = imageWrapper.histograms();
+  const cv::Mat &mat = imageWrapper.getMat();
+  cv::Mat thresholded =
+      hists.empty() ? operations::thresholdOtsu(mat)
+                    : autoThreshold::thresholdChannels(mat, hists, autoThreshold::Method::Otsu);
+  auto binary = ImageWrapper(thresholded).toBinary();
+  if (!binary.has_value())
+    return;
+  swapImage(binary.value());
+  recordStep("thresholdOtsu");
+}
+
+void MdiChild::thresholdAuto() {
+  TRACE_SCOPE("MdiChild::thresholdAuto");
+  // read once so that switching between the methods only costs picking a threshold from them,
+  // in the layers mode these are also the histograms the pushed layer uses
+  std::optional<ImageStats::Histograms> shown = shownHistograms();
+  if (!shown.has_value())
+    return;
+  ImageStats::Histograms hists = std::move(shown.value());
+  applyOperation(
+      "thresholdAuto", Dialog(this, QString("Auto threshold"), AutoThresholdMethods::inputSpec),
+      [hists](const cv::Mat &mat, autoThreshold::Method method) {
+        return hists.empty() ? operations::thresholdAuto(mat, method)
+                             : autoThreshold::thresholdChannels(mat, hists, method);
+      },
+      true);
+}
+
+void MdiChild::thresholdMultiOtsu() {
+  TRACE_SCOPE("MdiChild::thresholdMultiOtsu");
+  std::optional<ImageStats::Histograms> shown = shownHistograms();
+  if (!shown.has_value())
+    return;
+  ImageStats::Histograms hists = std::move(shown.value());
+  applyOperation("thresholdMultiOtsu",
+                 Dialog(this, QString("Multi-level Otsu"), //
+                        InputSpec<IntParam>{"Classes", {2, 8}, 3}),
+                 [hists](const cv::Mat &mat, int classes) {
+                   return hists.empty() ? operations::thresholdMultiOtsu(mat, classes)
+                                        : autoThreshold::multiOtsuChannels(mat, hists, classes);
+                 });
 }
 
 namespace {
@@ -511,12 +923,17 @@ QChartView *createLineProfileChart(const std::vector<uchar> &profile) {
 } // namespace
 
 void MdiChild::profileLine() {
-  const cv::Mat &mat = getImageWrapper(tabIndex).getMat();
+  TRACE_SCOPE("MdiChild::profileLine");
+  // the line is selected in the coordinates of the full resolution image
+  std::optional<ImageWrapper> image = inspectedImage();
+  if (!image.has_value())
+    return;
+  cv::Mat mat = image->getMat();
   ImageViewer &imageViewer = getImageViewer(tabIndex);
 
   disconnect(&imageViewer, &ImageViewer::lineSelected, this, nullptr);
 
-  connect(&imageViewer, &ImageViewer::lineSelected, this, [&](QLineF line) {
+  connect(&imageViewer, &ImageViewer::lineSelected, this, [this, mat, &imageViewer](QLineF line) {
     cv::Point p1(line.p1().x(), line.p1().y());
     cv::Point p2(line.p2().x(), line.p2().y());
     auto profile = imageProcessor::extractLineProfile(mat, p1, p2);
@@ -529,7 +946,81 @@ void MdiChild::profileLine() {
   imageViewer.getLineFromUser();
 }
 
+void MdiChild::regionHistogram() {
+  TRACE_SCOPE("MdiChild::regionHistogram");
+  ImageViewer &imageViewer = getImageViewer(tabIndex);
+
+  disconnect(&imageViewer, &ImageViewer::roiSelected, this, nullptr);
+
+  connect(&imageViewer, &ImageViewer::roiSelected, this, [this, &imageViewer](cv::Rect roi) {
+    // the rectangle stays drawn until the image changes or another one is selected
+    imageViewer.cancelGetROIFromUser();
+    if (std::optional<ImageWrapper> image = inspectedImage())
+      emit regionSelected(*image, roi);
+  });
+  imageViewer.getROIFromUser();
+}
+
+void MdiChild::manageRois() {
+  TRACE_SCOPE("MdiChild::manageRois");
+  if (roiDialog == nullptr) {
+    roiDialog = new QDialog(this);
+    roiDialog->setWindowTitle("ROI manager");
+    roiDialog->resize(640, 480);
+    QVBoxLayout *layout = new QVBoxLayout(roiDialog);
+    roiManager = new RoiManager(roiDialog);
+    layout->addWidget(roiManager);
+
+    connect(roiManager, &RoiManager::rectangleRequested, this, [this]() { selectRoi(false); });
+    connect(roiManager, &RoiManager::polygonRequested, this, [this]() { selectRoi(true); });
+    connect(roiManager, &RoiManager::roisChanged, this,
+            [this](const std::vector<roi::Roi> &rois) {
+              QPainterPath outline = RoiManager::outline(rois);
+              for (int i = 0; i < tabWidget->count(); ++i)
+                getImageViewer(i).setOverlay(outline);
+            });
+    // in the layers mode this is emitted on every scroll with the visible part only
+    connect(this, &MdiChild::imageUpdated, roiManager, [this]() {
+      if (!roiDialog->isVisible())
+        return;
+      if (std::optional<ImageWrapper> image = inspectedImage())
+        roiManager->setImage(*image);
+    });
+  }
+  if (std::optional<ImageWrapper> image = inspectedImage())
+    roiManager->setImage(*image);
+  roiDialog->show();
+  roiDialog->raise();
+  roiDialog->activateWindow();
+}
+
+void MdiChild::selectRoi(bool polygon) {
+  ImageViewer &imageViewer = getImageViewer(tabIndex);
+  imageViewer.cancelGetROIFromUser();
+  imageViewer.cancelGetPolygonFromUser();
+
+  if (polygon) {
+    disconnect(&imageViewer, &ImageViewer::polygonSelected, this, nullptr);
+    connect(&imageViewer, &ImageViewer::polygonSelected, this,
+            [this](std::vector<cv::Point> points) {
+              roiManager->addRoi(roi::Roi::fromPolygon({}, std::move(points)));
+            });
+    imageViewer.getPolygonFromUser();
+    return;
+  }
+  disconnect(&imageViewer, &ImageViewer::roiSelected, this, nullptr);
+  connect(&imageViewer, &ImageViewer::roiSelected, this, [this, &imageViewer](cv::Rect rect) {
+    // the manager draws its own outline
+    imageViewer.cancelGetROIFromUser();
+    imageViewer.clearROI();
+    roiManager->addRoi(roi::Roi::rectangle({}, rect));
+  });
+  imageViewer.getROIFromUser();
+}
+
 void MdiChild::affineTransform() {
+  TRACE_SCOPE("MdiChild::affineTransform");
+  flattenLayers();
   QDialog *dialog = new QDialog(this);
   dialog->setWindowTitle("Affine transformation");
   dialog->resize(800, 800);
@@ -546,5 +1037,6 @@ void MdiChild::affineTransform() {
   form->addRow(createDialogButtons(dialog));
   if (dialog->exec() != QDialog::Accepted)
     return;
+  // not recorded, the points are placed by hand on this particular image
   swapImage(imageViewer->getTransformedImage());
 }
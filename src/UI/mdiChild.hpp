@@ -1,11 +1,20 @@
 #pragma once
 
+#include "../imageHistory.hpp"
 #include "../imageWrapper.hpp"
+#include "../layerStack.hpp"
+#include "../pipeline.hpp"
 #include "ImageViewer.hpp"
 #include "dialogs/utils.hpp"
+#include "layersPanel.hpp"
+#include "performanceHud.hpp"
+#include "roiManager.hpp"
+#include <QDialog>
+#include <QElapsedTimer>
 #include <QMdiSubWindow>
 #include <QScrollArea>
 #include <QTabWidget>
+#include <QTimer>
 #include <qscrollbar.h>
 
 class MdiChild : public QMdiSubWindow {
@@ -24,22 +33,83 @@ public:
   QString getImageName() const { return imageName; }
   QString getImageBasename() const;
   QString getImageNameSuffix() const;
+  // in the adjustment layers mode this is the image below the layers
   const ImageWrapper &getImage() const { return imageWrapper; }
   const QSize getImageSize() const {
     return QSize(imageWrapper.getWidth(), imageWrapper.getHeight());
   }
   void emitImageUpdatedSignal() const;
+  // operations recorded since the image was opened, in the order they were applied,
+  // adjustment layers are recorded once they're flattened
+  const Pipeline &getRecordedPipeline() const { return recordedPipeline; }
+  // swaps the image for one that was obtained by applying `pipeline` to the current image
+  void applyPipelineResult(const ImageWrapper &image, const Pipeline &pipeline);
+  // starts timing an operation, the timing is reported with `operationTimed` once its result is
+  // displayed unless `endOperation` is called first
+  void beginOperation(const QString &name);
+  void endOperation();
+  // bytes of pixels held by the image, its channels and the pixmaps showing them
+  std::size_t getPixelMemory() const;
 
 private:
+  // displays the image without recording it in the history
+  void showImage(const ImageWrapper &image);
+  // updates the viewers to show the current image
+  void displayImage();
+  // applies LUT to the image, which allows the history not to store any pixels for this step
+  void swapImageLUT(const imageProcessor::LUT &lut);
+  // swaps the image for `image`, which is the current one with `lut` applied to it, so that
+  // neither the history nor the histogram have to look at its pixels
+  void swapImageLUT(const ImageWrapper &image, const imageProcessor::LUT &lut);
   void updateChannelNames();
   void regenerateChannels();
   ImageViewer &getImageViewer(int index) const;
   const ImageWrapper &getImageWrapper(int index) const;
+  // full resolution image of the current tab as it's shown, with the adjustment layers applied
+  // but not flattened, nullopt if the layers can't be applied
+  std::optional<ImageWrapper> inspectedImage();
+  // exact histograms of the full resolution image as it's shown, in the layers mode the ones the
+  // layers using histograms of the whole image take theirs from, nullopt if the layers can't be
+  // applied
+  std::optional<ImageStats::Histograms> shownHistograms();
+  // counts the histograms of the image in the background if they aren't known, the adjustment
+  // layers using them are rendered from a sample until then
+  void computeBaseHistograms();
   void ask4maskAndApply(const std::vector<cv::Mat> &mats, const std::vector<QString> &names);
-  void ask4structuringElementAndApply(
-      std::function<std::optional<cv::Mat>(StructuringElement::ValueType, BorderTypes::ValueType)> fn);
+  void ask4structuringElementAndApply(const QString &operation,
+                                      cv::Mat (*op)(const cv::Mat &, const cv::Mat &, int));
+  // asks for parameters of `op` previewing its results, applies it once the dialog is accepted
+  // and records it in the pipeline, `requireBinary` applies it only if the result is binary
+  template <typename... Params, typename Op>
+  void applyOperation(const QString &operation, Dialog<Params...> &&dialog, Op op,
+                      bool requireBinary = false);
+  // like `applyOperation` for point operations, `makeLUT` gives the LUT for the parameters
+  template <typename... Params, typename MakeLUT>
+  void applyLUTOperation(const QString &operation, Dialog<Params...> &&dialog, MakeLUT makeLUT);
+  // the part of the above two that runs the dialog, returns the result only if it should be
+  // swapped in, i.e. the dialog was accepted and the operation didn't become a layer
+  template <typename... Params, typename Op>
+  std::optional<cv::Mat> runOperationDialog(const QString &operation, Dialog<Params...> &dialog,
+                                            Op op);
+  void recordStep(const QString &operation, const QJsonArray &params = {});
+  // called when a change is pushed to `history`, before its steps are recorded
+  void historyPushed();
+  // adds the operation as an adjustment layer if they're enabled, returns false otherwise
+  bool pushLayer(const QString &operation, const QJsonArray &params = {});
+  void layersChanged();
+  // evaluates the layers for the visible part of the image, returns false if any has failed
+  bool renderLayers();
+  void setLayersMode(bool enabled);
+  // lets the user select a rectangle or a polygon that's added to the ROI manager
+  void selectRoi(bool polygon);
+  // milliseconds since the last call while an operation is timed, 0 otherwise
+  double lap();
+  // reports the timing of the current operation if there is one
+  void finishOperation();
 
 public slots:
+  void undo();
+  void redo();
   void toRGB();
   void toHSV();
   void toLab();
@@ -70,11 +140,26 @@ public slots:
   void thresholdManual();
   void thresholdAdaptive();
   void thresholdOtsu();
+  void thresholdAuto();
+  void thresholdMultiOtsu();
   void profileLine();
+  // lets the user select a rectangle and emits `regionSelected` with it
+  void regionHistogram();
+  // opens the ROI manager of the image
+  void manageRois();
   void affineTransform();
+  void saveRecordedPipeline();
+  void clearRecordedPipeline();
+  void toggleLayers();
+  void editLayers();
+  // applies the adjustment layers to the image
+  void flattenLayers();
 
 signals:
   void imageUpdated(const ImageWrapper &image) const;
+  void operationTimed(const OperationTiming &timing);
+  // `region` is in the coordinates of `image`
+  void regionSelected(const ImageWrapper &image, cv::Rect region) const;
 
 private slots:
   void tabChanged(int index);
@@ -88,6 +173,32 @@ private:
   ImageWrapper imageWrapper1, imageWrapper2, imageWrapper3;
   ImageViewer *image1, *image2, *image3;
 
+  ImageHistory history;
+  Pipeline recordedPipeline;
+  // size of `recordedPipeline` before each change pushed to `history`, so that undoing the change
+  // drops the steps recorded with it
+  std::vector<std::size_t> recordedSizes;
+  // steps dropped by undo, in the order of the redo steps of `history`
+  std::vector<std::vector<PipelineStep>> undoneSteps;
+
+  // in the adjustment layers mode operations are stacked in `layers` instead of being applied
+  bool layersMode = false;
+  LayerStack layers;
+  // layers taken off the stack by undo
+  std::vector<AdjustmentLayer> undoneLayers;
+  // visible part of the image with the layers applied
+  ImageWrapper layersView;
+  // rendering is delayed a bit so that scrolling doesn't render every intermediate position
+  QTimer *renderTimer;
+  QDialog *layersDialog = nullptr;
+  LayersPanel *layersPanel = nullptr;
+  QDialog *roiDialog = nullptr;
+  RoiManager *roiManager = nullptr;
+
   QString imageName;
   int tabIndex = 0;
+
+  OperationTiming timing;
+  // valid only while an operation is timed
+  QElapsedTimer operationTimer;
 };
@@ -0,0 +1,35 @@
+#include "performanceHud.hpp"
+#include <QHBoxLayout>
+
+namespace {
+QString formatMs(double ms) { return QString::number(ms, 'f', ms < 10 ? 1 : 0) + " ms"; }
+
+QString formatBytes(std::size_t bytes) {
+  return QString::number(bytes / (1024.0 * 1024.0), 'f', 1) + " MiB";
+}
+} // namespace
+
+PerformanceHud::PerformanceHud(QWidget *parent) : QWidget(parent) {
+  QHBoxLayout *layout = new QHBoxLayout(this);
+  layout->setContentsMargins(0, 0, 0, 0);
+  timingLabel = new QLabel("No operation yet");
+  memoryLabel = new QLabel;
+  layout->addWidget(timingLabel);
+  layout->addWidget(memoryLabel);
+  setMemory(0, 0);
+}
+
+void PerformanceHud::setTiming(const OperationTiming &timing) {
+  QString text = QString("%1: %2 (compute %3, display %4, histogram %5")
+                     .arg(timing.operation.isEmpty() ? "Last operation" : timing.operation,
+                          formatMs(timing.total()), formatMs(timing.compute),
+                          formatMs(timing.display), formatMs(timing.histogram));
+  if (timing.preview > 0)
+    text += ", preview " + formatMs(timing.preview);
+  timingLabel->setText(text + ")");
+}
+
+void PerformanceHud::setMemory(std::size_t images, std::size_t history) {
+  memoryLabel->setText(
+      QString("Pixels: %1, history: %2").arg(formatBytes(images), formatBytes(history)));
+}
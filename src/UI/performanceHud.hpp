@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QLabel>
+#include <QString>
+#include <QWidget>
+#include <cstddef>
+
+// durations of the parts of an operation in milliseconds
+struct OperationTiming {
+  QString operation;
+  // computing the new image
+  double compute = 0;
+  // converting it to pixmaps and showing them, including the channel tabs
+  double display = 0;
+  // updating the histogram dock
+  double histogram = 0;
+  // time it took to update the preview after the last parameter change, 0 without a dialog
+  double preview = 0;
+
+  double total() const { return compute + display + histogram; }
+};
+
+// Status bar panel showing how long the last operation took and how much memory the pixels of
+// all the open images use
+class PerformanceHud : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit PerformanceHud(QWidget *parent = nullptr);
+
+public slots:
+  void setTiming(const OperationTiming &timing);
+  // `images` covers the images, their channels and pixmaps, `history` the undo histories
+  void setMemory(std::size_t images, std::size_t history);
+
+private:
+  QLabel *timingLabel;
+  QLabel *memoryLabel;
+};
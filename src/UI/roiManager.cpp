@@ -0,0 +1,275 @@
+#include "roiManager.hpp"
+#include "../trace.hpp"
+#include "dialogs/DialogBuilder.hpp"
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QMessageBox>
+#include <QVBoxLayout>
+#include <algorithm>
+#include <set>
+
+namespace {
+// columns every row has, then the area and the columns of each channel once measured
+const char *ROI_HEADERS[] = {"Name", "Type", "X", "Y", "Width", "Height"};
+const int ROI_COLUMNS = 6;
+const char *CHANNEL_HEADERS[] = {"Mean", "Std dev", "Min", "Max", "Int den"};
+const int CHANNEL_COLUMNS = 5;
+} // namespace
+
+RoiTableModel::RoiTableModel(QObject *parent) : QAbstractTableModel(parent) {}
+
+void RoiTableModel::setRois(std::vector<roi::Roi> rois) {
+  beginResetModel();
+  this->rois = std::move(rois);
+  measurements.clear();
+  endResetModel();
+}
+
+void RoiTableModel::setMeasurements(std::vector<roi::Measurement> measurements,
+                                    std::vector<std::string> channelNames) {
+  beginResetModel();
+  this->measurements = std::move(measurements);
+  this->channelNames = std::move(channelNames);
+  endResetModel();
+}
+
+void RoiTableModel::clearMeasurements() {
+  if (measurements.empty())
+    return;
+  beginResetModel();
+  measurements.clear();
+  endResetModel();
+}
+
+int RoiTableModel::channelCount() const {
+  return measurements.empty() ? 0 : static_cast<int>(measurements[0].channels.size());
+}
+
+int RoiTableModel::rowCount(const QModelIndex &parent) const {
+  return parent.isValid() ? 0 : static_cast<int>(rois.size());
+}
+
+int RoiTableModel::columnCount(const QModelIndex &parent) const {
+  if (parent.isValid())
+    return 0;
+  if (measurements.empty())
+    return ROI_COLUMNS;
+  return ROI_COLUMNS + 1 + channelCount() * CHANNEL_COLUMNS;
+}
+
+QVariant RoiTableModel::data(const QModelIndex &index, int role) const {
+  if (role != Qt::DisplayRole || !index.isValid())
+    return {};
+  const roi::Roi &roi = rois[index.row()];
+  switch (index.column()) {
+  case 0:
+    return QString::fromStdString(roi.name);
+  case 1:
+    return roi.isPolygon() ? "Polygon" : "Rectangle";
+  case 2:
+    return roi.rect.x;
+  case 3:
+    return roi.rect.y;
+  case 4:
+    return roi.rect.width;
+  case 5:
+    return roi.rect.height;
+  }
+
+  const roi::Measurement &m = measurements[index.row()];
+  if (index.column() == ROI_COLUMNS)
+    return static_cast<qlonglong>(m.area);
+  if (m.area == 0)
+    return {};
+  int column = index.column() - ROI_COLUMNS - 1;
+  const roi::ChannelMeasurement &channel = m.channels[column / CHANNEL_COLUMNS];
+  switch (column % CHANNEL_COLUMNS) {
+  case 0:
+    return QString::number(channel.mean, 'f', 3);
+  case 1:
+    return QString::number(channel.stdDev, 'f', 3);
+  case 2:
+    return channel.min;
+  case 3:
+    return channel.max;
+  default:
+    return static_cast<qlonglong>(channel.integratedDensity);
+  }
+}
+
+QVariant RoiTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+  if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+    return {};
+  if (section < ROI_COLUMNS)
+    return QString(ROI_HEADERS[section]);
+  if (section == ROI_COLUMNS)
+    return QString("Area");
+  int column = section - ROI_COLUMNS - 1;
+  QString header = CHANNEL_HEADERS[column % CHANNEL_COLUMNS];
+  std::size_t c = column / CHANNEL_COLUMNS;
+  if (channelCount() > 1 && c < channelNames.size())
+    header += " " + QString::fromStdString(channelNames[c]);
+  return header;
+}
+
+RoiManager::RoiManager(QWidget *parent) : QWidget(parent) {
+  QVBoxLayout *layout = new QVBoxLayout(this);
+
+  QHBoxLayout *addButtons = new QHBoxLayout;
+  QPushButton *rectangleButton = new QPushButton("Add rectangle");
+  QPushButton *polygonButton = new QPushButton("Add polygon");
+  polygonButton->setToolTip("Click the vertices, right click closes the polygon");
+  QPushButton *gridButton = new QPushButton("Add grid...");
+  addButtons->addWidget(rectangleButton);
+  addButtons->addWidget(polygonButton);
+  addButtons->addWidget(gridButton);
+  layout->addLayout(addButtons);
+
+  model = new RoiTableModel(this);
+  table = new QTableView;
+  table->setModel(model);
+  table->verticalHeader()->hide();
+  // rows of the same height don't have to be measured one by one
+  table->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+  table->setSelectionBehavior(QAbstractItemView::SelectRows);
+  layout->addWidget(table);
+
+  statusLabel = new QLabel;
+  layout->addWidget(statusLabel);
+
+  QHBoxLayout *buttons = new QHBoxLayout;
+  QPushButton *removeButton = new QPushButton("Remove");
+  QPushButton *clearButton = new QPushButton("Clear");
+  QPushButton *measureButton = new QPushButton("Measure");
+  QPushButton *exportButton = new QPushButton("Export CSV...");
+  buttons->addWidget(removeButton);
+  buttons->addWidget(clearButton);
+  buttons->addStretch();
+  buttons->addWidget(measureButton);
+  buttons->addWidget(exportButton);
+  layout->addLayout(buttons);
+
+  connect(rectangleButton, &QPushButton::clicked, this, &RoiManager::rectangleRequested);
+  connect(polygonButton, &QPushButton::clicked, this, &RoiManager::polygonRequested);
+  connect(gridButton, &QPushButton::clicked, this, &RoiManager::addGrid);
+  connect(removeButton, &QPushButton::clicked, this, &RoiManager::removeSelected);
+  connect(clearButton, &QPushButton::clicked, this, &RoiManager::clear);
+  connect(measureButton, &QPushButton::clicked, this, &RoiManager::measure);
+  connect(exportButton, &QPushButton::clicked, this, &RoiManager::exportCsv);
+}
+
+void RoiManager::addRoi(roi::Roi roi) {
+  if (roi.rect.empty())
+    return;
+  if (roi.name.empty())
+    roi.name = std::to_string(++lastNumber);
+  std::vector<roi::Roi> added = rois;
+  added.push_back(std::move(roi));
+  setRois(std::move(added));
+}
+
+QPainterPath RoiManager::outline(const std::vector<roi::Roi> &rois) {
+  QPainterPath path;
+  for (const roi::Roi &roi : rois) {
+    if (!roi.isPolygon()) {
+      path.addRect(roi.rect.x, roi.rect.y, roi.rect.width, roi.rect.height);
+      continue;
+    }
+    QPolygonF polygon;
+    for (const cv::Point &p : roi.polygon)
+      polygon << QPointF(p.x, p.y);
+    polygon << polygon.front();
+    path.addPolygon(polygon);
+  }
+  return path;
+}
+
+void RoiManager::setImage(const ImageWrapper &image) {
+  const cv::Mat &mat = image.getMat();
+  // the pixels are never changed in place, so the same buffer keeps the measurements valid
+  if (mat.data == this->image.data && mat.size() == this->image.size() &&
+      mat.type() == this->image.type())
+    return;
+  this->image = mat;
+  channelNames = PixelFormatUtils::channelNames(image.getFormat());
+  // named in the display order, the pixels are stored as BGR
+  if (image.getFormat() == PixelFormat::BGR24)
+    std::reverse(channelNames.begin(), channelNames.end());
+  measurements.clear();
+  model->clearMeasurements();
+  statusLabel->clear();
+}
+
+void RoiManager::addGrid() {
+  if (image.empty())
+    return;
+  QDialog dialog(this);
+  dialog.setWindowTitle("Grid of ROIs");
+  QFormLayout *form = new QFormLayout(&dialog);
+  QSpinBox *rowsEdit = createValidatedIntEdit(&dialog, 1, std::max(1, image.rows), 10);
+  QSpinBox *colsEdit = createValidatedIntEdit(&dialog, 1, std::max(1, image.cols), 10);
+  form->addRow("Rows", rowsEdit);
+  form->addRow("Columns", colsEdit);
+  form->addRow(createDialogButtons(&dialog));
+  if (dialog.exec() != QDialog::Accepted)
+    return;
+
+  std::vector<roi::Roi> added = rois;
+  for (roi::Roi &cell :
+       roi::grid(cv::Rect(0, 0, image.cols, image.rows), rowsEdit->value(), colsEdit->value()))
+    added.push_back(std::move(cell));
+  setRois(std::move(added));
+}
+
+void RoiManager::removeSelected() {
+  std::set<int> selected;
+  for (const QModelIndex &index : table->selectionModel()->selectedRows())
+    selected.insert(index.row());
+  if (selected.empty())
+    return;
+  std::vector<roi::Roi> kept;
+  for (std::size_t i = 0; i < rois.size(); ++i)
+    if (selected.count(static_cast<int>(i)) == 0)
+      kept.push_back(rois[i]);
+  setRois(std::move(kept));
+}
+
+void RoiManager::clear() {
+  lastNumber = 0;
+  setRois({});
+}
+
+bool RoiManager::measure() {
+  TRACE_SCOPE("RoiManager::measure");
+  if (image.empty())
+    return false;
+  QElapsedTimer timer;
+  timer.start();
+  measurements = roi::measure(image, rois);
+  double elapsed = timer.nsecsElapsed() / 1e6;
+  model->setMeasurements(measurements, channelNames);
+  statusLabel->setText(
+      QString("Measured %1 ROIs in %2 ms").arg(rois.size()).arg(elapsed, 0, 'f', 1));
+  return true;
+}
+
+void RoiManager::exportCsv() {
+  if (measurements.size() != rois.size() && !measure())
+    return;
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export measurements"), "rois.csv",
+                                                  tr("CSV files (*.csv)"));
+  if (fileName.isEmpty())
+    return;
+  if (!roi::writeCsv(fileName.toStdString(), rois, measurements, channelNames))
+    QMessageBox::critical(this, "Error", "Failed to save the measurements to " + fileName);
+}
+
+void RoiManager::setRois(std::vector<roi::Roi> rois) {
+  this->rois = std::move(rois);
+  measurements.clear();
+  model->setRois(this->rois);
+  statusLabel->setText(QString("%1 ROIs").arg(this->rois.size()));
+  emit roisChanged(this->rois);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../imageWrapper.hpp"
+#include "../roiMeasurement.hpp"
+#include <QAbstractTableModel>
+#include <QLabel>
+#include <QPainterPath>
+#include <QPushButton>
+#include <QTableView>
+#include <QWidget>
+#include <vector>
+
+// rows of rois with their measurements once they're measured
+class RoiTableModel : public QAbstractTableModel {
+  Q_OBJECT
+
+public:
+  explicit RoiTableModel(QObject *parent = nullptr);
+  // drops the measurements
+  void setRois(std::vector<roi::Roi> rois);
+  // `measurements` in the order of the rois
+  void setMeasurements(std::vector<roi::Measurement> measurements,
+                       std::vector<std::string> channelNames);
+  void clearMeasurements();
+
+  int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+  int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+  QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+  QVariant headerData(int section, Qt::Orientation orientation,
+                      int role = Qt::DisplayRole) const override;
+
+private:
+  std::vector<roi::Roi> rois;
+  std::vector<roi::Measurement> measurements;
+  std::vector<std::string> channelNames;
+
+  int channelCount() const;
+};
+
+// List of regions of an image, all of them are measured at once and the results can be exported
+// as CSV
+class RoiManager : public QWidget {
+  Q_OBJECT
+
+public:
+  explicit RoiManager(QWidget *parent = nullptr);
+  const std::vector<roi::Roi> &getRois() const { return rois; }
+  // named after its position in the list if it has no name
+  void addRoi(roi::Roi roi);
+
+  // outlines of `rois` in the coordinates of the image
+  static QPainterPath outline(const std::vector<roi::Roi> &rois);
+
+public slots:
+  // image the rois are measured on, measurements of different pixels are dropped
+  void setImage(const ImageWrapper &image);
+
+signals:
+  // the user wants to select a region on the image, which is then passed to `addRoi`
+  void rectangleRequested();
+  void polygonRequested();
+  void roisChanged(const std::vector<roi::Roi> &rois);
+
+private:
+  void addGrid();
+  void removeSelected();
+  void clear();
+  // returns false if there's no image to measure
+  bool measure();
+  void exportCsv();
+  void setRois(std::vector<roi::Roi> rois);
+
+  QTableView *table;
+  RoiTableModel *model;
+  QLabel *statusLabel;
+
+  std::vector<roi::Roi> rois;
+  std::vector<roi::Measurement> measurements;
+  // pixels are shared with the image, they're never modified in place
+  cv::Mat image;
+  std::vector<std::string> channelNames;
+  int lastNumber = 0;
+};
@@ -0,0 +1,51 @@
+#include "allocations.hpp"
+#include <opencv2/core.hpp>
+
+namespace allocations {
+namespace {
+// forwards to OpenCV's default allocator, counting what it allocates
+class CountingAllocator : public cv::MatAllocator {
+public:
+  explicit CountingAllocator(cv::MatAllocator *inner) : inner(inner) {}
+
+  cv::UMatData *allocate(int dims, const int *sizes, int type, void *data, std::size_t *step,
+                         cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+    cv::UMatData *u = inner->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    if (u == nullptr)
+      return u;
+    // matrices release their data through the allocator that created it
+    u->currAllocator = this;
+    if (!(u->flags & cv::UMatData::USER_ALLOCATED)) {
+      detail::count.fetch_add(1, std::memory_order_relaxed);
+      detail::bytes.fetch_add(u->size, std::memory_order_relaxed);
+      detail::raisePeaks(detail::resident.fetch_add(static_cast<std::int64_t>(u->size),
+                                                   std::memory_order_relaxed) +
+                        static_cast<std::int64_t>(u->size));
+    }
+    return u;
+  }
+
+  bool allocate(cv::UMatData *data, cv::AccessFlag accessFlags,
+                cv::UMatUsageFlags usageFlags) const override {
+    return inner->allocate(data, accessFlags, usageFlags);
+  }
+
+  void deallocate(cv::UMatData *u) const override {
+    if (u != nullptr && !(u->flags & cv::UMatData::USER_ALLOCATED))
+      detail::resident.fetch_sub(static_cast<std::int64_t>(u->size), std::memory_order_relaxed);
+    inner->deallocate(u);
+  }
+
+private:
+  cv::MatAllocator *inner;
+};
+} // namespace
+
+void install() {
+  if (detail::installed.exchange(true))
+    return;
+  // never destroyed, matrices in static storage may be released after it would be
+  static CountingAllocator *allocator = new CountingAllocator(cv::Mat::getStdAllocator());
+  cv::Mat::setDefaultAllocator(allocator);
+}
+} // namespace allocations
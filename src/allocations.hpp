@@ -0,0 +1,111 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+// Accounting of the memory taken by pixels.
+//
+// Once `install` is called every cv::Mat allocates through an allocator that counts the
+// allocations, the bytes they take and how many of them are resident. QImage and QPixmap can't
+// use another allocator, so the code creating them reports their sizes with `recordExternal`,
+// those count as allocations but not as resident memory since their release isn't seen.
+namespace allocations {
+struct Counters {
+  std::uint64_t count = 0;
+  std::uint64_t bytes = 0;
+  // highest resident size reached, above the one at the start
+  std::int64_t peak = 0;
+  // change of the resident size
+  std::int64_t growth = 0;
+};
+
+namespace detail {
+// highest resident size seen by each active measurement, free slots hold FREE
+inline constexpr int WATERMARKS = 64;
+inline constexpr std::int64_t FREE = std::numeric_limits<std::int64_t>::min();
+
+inline std::atomic<bool> installed{false};
+inline std::atomic<std::uint64_t> count{0}, bytes{0};
+inline std::atomic<std::int64_t> resident{0};
+
+struct Watermark {
+  std::atomic<std::int64_t> value{FREE};
+};
+inline Watermark watermarks[WATERMARKS];
+
+inline void raisePeaks(std::int64_t value) {
+  for (Watermark &watermark : watermarks) {
+    std::int64_t current = watermark.value.load(std::memory_order_relaxed);
+    while (current != FREE && value > current &&
+           !watermark.value.compare_exchange_weak(current, value, std::memory_order_relaxed))
+      ;
+  }
+}
+
+// returns the slot now holding `start`, or -1 when all of them are taken
+inline int acquireWatermark(std::int64_t start) {
+  for (int i = 0; i < WATERMARKS; ++i) {
+    std::int64_t expected = FREE;
+    if (watermarks[i].value.compare_exchange_strong(expected, start, std::memory_order_relaxed))
+      return i;
+  }
+  return -1;
+}
+} // namespace detail
+
+// makes cv::Mat allocate through the counting allocator, matrices allocated before keep
+// the allocator they were created with and aren't counted
+void install();
+inline bool isInstalled() { return detail::installed.load(std::memory_order_relaxed); }
+
+inline void recordExternal(std::size_t bytes) {
+  detail::count.fetch_add(1, std::memory_order_relaxed);
+  detail::bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// bytes of all the counted matrices that are still allocated
+inline std::int64_t residentBytes() { return detail::resident.load(std::memory_order_relaxed); }
+
+// Counts allocations of all threads made between its construction and `stop`.
+// Each measurement keeps its own peak, so nested and overlapping ones are exact. Past
+// `detail::WATERMARKS` measurements at once the extra ones only see the resident size at `stop`.
+class Measurement {
+public:
+  Measurement()
+      : startCount(detail::count.load(std::memory_order_relaxed)),
+        startBytes(detail::bytes.load(std::memory_order_relaxed)), startResident(residentBytes()),
+        watermark(detail::acquireWatermark(startResident)) {}
+
+  ~Measurement() {
+    if (!stopped)
+      stop();
+  }
+  Measurement(const Measurement &) = delete;
+  Measurement &operator=(const Measurement &) = delete;
+
+  Counters stop() {
+    Counters counters;
+    counters.count = detail::count.load(std::memory_order_relaxed) - startCount;
+    counters.bytes = detail::bytes.load(std::memory_order_relaxed) - startBytes;
+    counters.growth = residentBytes() - startResident;
+    if (watermark >= 0) {
+      counters.peak = detail::watermarks[watermark].value.exchange(detail::FREE,
+                                                             std::memory_order_relaxed) -
+                      startResident;
+    } else {
+      counters.peak = std::max<std::int64_t>(counters.growth, 0);
+    }
+    stopped = true;
+    return counters;
+  }
+
+private:
+  std::uint64_t startCount, startBytes;
+  std::int64_t startResident;
+  int watermark;
+  bool stopped = false;
+};
+} // namespace allocations
@@ -0,0 +1,370 @@
+#include "autoThreshold.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+const int N = 256;
+
+// follows OpenCV's getThreshVal_Otsu_8u so that the thresholds are the same
+int otsu(const std::vector<int> &hist, double total) {
+  double scale = 1. / total, mu = 0;
+  for (int i = 0; i < N; ++i)
+    mu += i * static_cast<double>(hist[i]);
+  mu *= scale;
+
+  double mu1 = 0, q1 = 0, maxSigma = 0;
+  int t = 0;
+  for (int i = 0; i < N; ++i) {
+    double p = hist[i] * scale;
+    mu1 *= q1;
+    q1 += p;
+    double q2 = 1. - q1;
+    if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1. - FLT_EPSILON)
+      continue;
+    mu1 = (mu1 + i * p) / q1;
+    double mu2 = (mu - q1 * mu1) / q2;
+    double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+    if (sigma > maxSigma) {
+      maxSigma = sigma;
+      t = i;
+    }
+  }
+  return t;
+}
+
+// follows OpenCV's getThreshVal_Triangle_8u
+int triangle(std::vector<int> hist) {
+  int left = 0, right = 0, peak = 0, max = 0;
+  for (int i = 0; i < N; ++i)
+    if (hist[i] > 0) {
+      left = i;
+      break;
+    }
+  if (left > 0)
+    --left;
+  for (int i = N - 1; i > 0; --i)
+    if (hist[i] > 0) {
+      right = i;
+      break;
+    }
+  if (right < N - 1)
+    ++right;
+  for (int i = 0; i < N; ++i)
+    if (hist[i] > max) {
+      max = hist[i];
+      peak = i;
+    }
+
+  // the line goes from the peak to the further end of the histogram
+  bool flipped = peak - left < right - peak;
+  if (flipped) {
+    std::reverse(hist.begin(), hist.end());
+    left = N - 1 - right;
+    peak = N - 1 - peak;
+  }
+
+  int t = left;
+  double a = max, b = left - peak, dist = 0;
+  for (int i = left + 1; i <= peak; ++i) {
+    double d = a * i + b * hist[i];
+    if (d > dist) {
+      dist = d;
+      t = i;
+    }
+  }
+  --t;
+  return flipped ? N - 1 - t : t;
+}
+
+// Li & Tam, iterated until the threshold settles as in ImageJ's Li
+int li(const std::vector<int> &hist, double total) {
+  std::vector<double> count(N + 1, 0), sum(N + 1, 0);
+  for (int i = 0; i < N; ++i) {
+    count[i + 1] = count[i] + hist[i];
+    sum[i + 1] = sum[i] + static_cast<double>(i) * hist[i];
+  }
+
+  double next = sum[N] / total;
+  int t = static_cast<int>(next);
+  // it converges in a few iterations, the limit only guards against oscillating
+  for (int iteration = 0; iteration < N; ++iteration) {
+    double previous = next;
+    t = std::clamp(static_cast<int>(previous + 0.5), 0, N - 2);
+    double backCount = count[t + 1], objCount = total - backCount;
+    if (backCount == 0 || objCount == 0)
+      break;
+    double backMean = sum[t + 1] / backCount;
+    double objMean = (sum[N] - sum[t + 1]) / objCount;
+    // the log of a mean of 0 is undefined, the threshold can't get any lower anyway
+    if (backMean <= 0)
+      break;
+    double temp = (backMean - objMean) / (std::log(backMean) - std::log(objMean));
+    next = temp < -std::numeric_limits<double>::epsilon() ? static_cast<int>(temp - 0.5)
+                                                          : static_cast<int>(temp + 0.5);
+    if (std::abs(next - previous) <= 0.5)
+      break;
+  }
+  return t;
+}
+
+// Yen, Chang & Chang, as in ImageJ's Yen
+int yen(const std::vector<int> &hist, double total) {
+  std::vector<double> p1(N), p1Sq(N), p2Sq(N);
+  double p = 0, pSq = 0;
+  for (int i = 0; i < N; ++i) {
+    double norm = hist[i] / total;
+    p += norm;
+    pSq += norm * norm;
+    p1[i] = p;
+    p1Sq[i] = pSq;
+  }
+  p2Sq[N - 1] = 0;
+  for (int i = N - 2; i >= 0; --i) {
+    double norm = hist[i + 1] / total;
+    p2Sq[i] = p2Sq[i + 1] + norm * norm;
+  }
+
+  int t = 0;
+  double maxCrit = -std::numeric_limits<double>::infinity();
+  for (int i = 0; i < N; ++i) {
+    double sq = p1Sq[i] * p2Sq[i], split = p1[i] * (1. - p1[i]);
+    double crit = -(sq > 0 ? std::log(sq) : 0.) + 2 * (split > 0 ? std::log(split) : 0.);
+    if (crit > maxCrit) {
+      maxCrit = crit;
+      t = i;
+    }
+  }
+  return t;
+}
+
+// Huang & Wang's fuzzy thresholding, the membership of a value in its class falls with its
+// distance from the class mean, which isn't rounded to a value
+int huang(const std::vector<int> &hist) {
+  int first = 0, last = N - 1;
+  while (first < N && hist[first] == 0)
+    ++first;
+  while (last > first && hist[last] == 0)
+    --last;
+  if (first >= last)
+    return first;
+
+  std::vector<double> count(N, 0), sum(N, 0);
+  count[first] = hist[first];
+  sum[first] = static_cast<double>(first) * hist[first];
+  for (int i = first + 1; i <= last; ++i) {
+    count[i] = count[i - 1] + hist[i];
+    sum[i] = sum[i - 1] + static_cast<double>(i) * hist[i];
+  }
+
+  // Shannon entropy of the membership of a value at `distance` from the mean of its class
+  const double c = last - first;
+  auto entropyAt = [c](double distance) {
+    if (distance == 0)
+      return 0.;
+    double mu = 1. / (1. + distance / c);
+    return -mu * std::log(mu) - (1. - mu) * std::log(1. - mu);
+  };
+
+  int t = first;
+  double best = std::numeric_limits<double>::max();
+  for (int i = first; i < last; ++i) {
+    double entropy = 0;
+    double mean = sum[i] / count[i];
+    for (int v = first; v <= i; ++v)
+      if (hist[v] > 0)
+        entropy += entropyAt(std::abs(v - mean)) * hist[v];
+    mean = (sum[last] - sum[i]) / (count[last] - count[i]);
+    for (int v = i + 1; v <= last; ++v)
+      if (hist[v] > 0)
+        entropy += entropyAt(std::abs(v - mean)) * hist[v];
+    if (entropy < best) {
+      best = entropy;
+      t = i;
+    }
+  }
+  return t;
+}
+
+int mean(const std::vector<int> &hist, double total) {
+  double sum = 0;
+  for (int i = 0; i < N; ++i)
+    sum += static_cast<double>(i) * hist[i];
+  return static_cast<int>(std::floor(sum / total));
+}
+} // namespace
+
+namespace autoThreshold {
+std::string toString(Method method) {
+  switch (method) {
+  case Method::Otsu:
+    return "Otsu";
+  case Method::Triangle:
+    return "Triangle";
+  case Method::Li:
+    return "Li";
+  case Method::Yen:
+    return "Yen";
+  case Method::Huang:
+    return "Huang";
+  case Method::Mean:
+    return "Mean";
+  }
+  throw std::invalid_argument("Invalid auto threshold method");
+}
+
+int threshold(const std::vector<int> &hist, Method method) {
+  if (hist.size() != N)
+    throw std::invalid_argument("Auto thresholds need a histogram of 256 bins");
+  double total = 0;
+  for (int count : hist)
+    total += count;
+  if (total == 0)
+    return 0;
+
+  switch (method) {
+  case Method::Otsu:
+    return otsu(hist, total);
+  case Method::Triangle:
+    return triangle(hist);
+  case Method::Li:
+    return li(hist, total);
+  case Method::Yen:
+    return yen(hist, total);
+  case Method::Huang:
+    return huang(hist);
+  case Method::Mean:
+    return mean(hist, total);
+  }
+  throw std::invalid_argument("Invalid auto threshold method");
+}
+
+std::vector<int> thresholds(const std::vector<std::vector<int>> &hists, Method method) {
+  TRACE_SCOPE("autoThreshold::thresholds");
+  std::vector<int> result;
+  result.reserve(hists.size());
+  for (const std::vector<int> &hist : hists)
+    result.push_back(threshold(hist, method));
+  return result;
+}
+
+std::vector<int> multiOtsu(const std::vector<int> &hist, int classes) {
+  TRACE_SCOPE("autoThreshold::multiOtsu");
+  if (hist.size() != N)
+    throw std::invalid_argument("Auto thresholds need a histogram of 256 bins");
+  if (classes < 2 || classes > N)
+    throw std::invalid_argument("Multi-level Otsu needs 2 to 256 classes");
+
+  std::vector<double> count(N + 1, 0), sum(N + 1, 0);
+  for (int i = 0; i < N; ++i) {
+    count[i + 1] = count[i] + hist[i];
+    sum[i + 1] = sum[i] + static_cast<double>(i) * hist[i];
+  }
+  // the between-class variance differs from the sum of w * mu² over the classes by a constant,
+  // and the class of values a..b contributes sum² / count to it
+  auto classScore = [&](int a, int b) {
+    double w = count[b + 1] - count[a];
+    if (w == 0)
+      return 0.;
+    double s = sum[b + 1] - sum[a];
+    return s * s / w;
+  };
+
+  // best[k][b]: score of splitting the values 0..b into k + 1 classes, the last one starting
+  // at start[k][b]
+  std::vector<std::vector<double>> best(classes, std::vector<double>(N, 0));
+  std::vector<std::vector<int>> start(classes, std::vector<int>(N, 0));
+  for (int b = 0; b < N; ++b)
+    best[0][b] = classScore(0, b);
+  for (int k = 1; k < classes; ++k)
+    for (int b = k; b < N; ++b) {
+      double bestScore = -1;
+      for (int a = k; a <= b; ++a) {
+        double score = best[k - 1][a - 1] + classScore(a, b);
+        if (score > bestScore) {
+          bestScore = score;
+          start[k][b] = a;
+        }
+      }
+      best[k][b] = bestScore;
+    }
+
+  std::vector<int> result(classes - 1);
+  int b = N - 1;
+  for (int k = classes - 1; k > 0; --k) {
+    result[k - 1] = start[k][b] - 1;
+    b = result[k - 1];
+  }
+  return result;
+}
+
+std::vector<uchar> levelsLUT(const std::vector<int> &thresholds) {
+  std::vector<uchar> lut(N);
+  const int levels = static_cast<int>(thresholds.size());
+  int level = 0;
+  for (int v = 0; v < N; ++v) {
+    while (level < levels && v > thresholds[level])
+      ++level;
+    lut[v] = levels == 0 ? 0 : static_cast<uchar>((255 * level + levels / 2) / levels);
+  }
+  return lut;
+}
+
+cv::Mat apply(const cv::Mat &mat, const std::vector<std::vector<int>> &thresholds) {
+  TRACE_SCOPE("autoThreshold::apply");
+  if (mat.depth() != CV_8U)
+    throw std::invalid_argument("Auto thresholds are only applied to 8-bit images");
+  if (thresholds.size() != static_cast<std::size_t>(mat.channels()))
+    throw std::invalid_argument("Expected thresholds for every channel");
+
+  cv::Mat out(mat.size(), mat.type());
+  const kernels::KernelTable &k = kernels::get();
+  const std::size_t rowLength = static_cast<std::size_t>(mat.cols) * mat.channels();
+  bool shared = std::all_of(thresholds.begin(), thresholds.end(),
+                            [&](const std::vector<int> &t) { return t == thresholds[0]; });
+
+  // a single threshold for every channel is a plain comparison
+  if (shared && thresholds[0].size() == 1 && thresholds[0][0] >= 0 && thresholds[0][0] < 255) {
+    uchar t = static_cast<uchar>(thresholds[0][0]);
+    for (int y = 0; y < mat.rows; ++y)
+      k.threshold(mat.ptr<uchar>(y), out.ptr<uchar>(y), rowLength, t, 255);
+    return out;
+  }
+  if (shared) {
+    std::vector<uchar> lut = levelsLUT(thresholds[0]);
+    for (int y = 0; y < mat.rows; ++y)
+      k.applyLUT(mat.ptr<uchar>(y), out.ptr<uchar>(y), rowLength, lut.data());
+    return out;
+  }
+
+  // the channels are interleaved, so a lut per channel is still a single pass
+  cv::Mat luts(1, N, CV_8UC(mat.channels()));
+  for (int c = 0; c < mat.channels(); ++c) {
+    std::vector<uchar> lut = levelsLUT(thresholds[c]);
+    for (int v = 0; v < N; ++v)
+      luts.ptr<uchar>(0)[v * mat.channels() + c] = lut[v];
+  }
+  cv::LUT(mat, luts, out);
+  return out;
+}
+
+cv::Mat thresholdChannels(const cv::Mat &mat, const std::vector<std::vector<int>> &hists,
+                          Method method) {
+  std::vector<std::vector<int>> perChannel;
+  for (int t : thresholds(hists, method))
+    perChannel.push_back({t});
+  return apply(mat, perChannel);
+}
+
+cv::Mat multiOtsuChannels(const cv::Mat &mat, const std::vector<std::vector<int>> &hists,
+                          int classes) {
+  std::vector<std::vector<int>> perChannel;
+  for (const std::vector<int> &hist : hists)
+    perChannel.push_back(multiOtsu(hist, classes));
+  return apply(mat, perChannel);
+}
+} // namespace autoThreshold
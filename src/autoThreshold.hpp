@@ -0,0 +1,44 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+// Global thresholds picked from the 256-bin histogram of a channel alone, so that once the
+// histogram is known (see ImageStats) choosing between the methods doesn't read the pixels.
+// A threshold t splits the values into v <= t and v > t, like cv::THRESH_BINARY.
+namespace autoThreshold {
+enum class Method {
+  Otsu,     // maximum between-class variance, the same as cv::THRESH_OTSU
+  Triangle, // the same as cv::THRESH_TRIANGLE
+  Li,       // minimum cross entropy, iterative
+  Yen,      // maximum correlation
+  Huang,    // minimum fuzzy entropy
+  Mean,     // mean of the values
+};
+const std::vector<Method> METHODS = {Method::Otsu, Method::Triangle, Method::Li,
+                                     Method::Yen,  Method::Huang,    Method::Mean};
+std::string toString(Method method);
+
+// 0 for an empty histogram
+int threshold(const std::vector<int> &hist, Method method);
+// a threshold per channel
+std::vector<int> thresholds(const std::vector<std::vector<int>> &hists, Method method);
+
+// `classes` - 1 increasing thresholds maximizing the between-class variance of the classes
+// they split the values into, found by dynamic programming in O(classes * 256²)
+std::vector<int> multiOtsu(const std::vector<int> &hist, int classes);
+
+// maps the values to evenly spaced levels from 0 to 255, one more than there are `thresholds`,
+// so a single threshold gives a binary image
+std::vector<uchar> levelsLUT(const std::vector<int> &thresholds);
+// applies thresholds[c] to channel c of an 8-bit `mat` in a single pass over its pixels
+cv::Mat apply(const cv::Mat &mat, const std::vector<std::vector<int>> &thresholds);
+
+// thresholds every channel of `mat`, whose histograms `hists` are, at the value picked by `method`
+cv::Mat thresholdChannels(const cv::Mat &mat, const std::vector<std::vector<int>> &hists,
+                          Method method);
+// splits every channel of `mat`, whose histograms `hists` are, into `classes` levels
+cv::Mat multiOtsuChannels(const cv::Mat &mat, const std::vector<std::vector<int>> &hists,
+                          int classes);
+} // namespace autoThreshold
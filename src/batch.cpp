@@ -0,0 +1,245 @@
+#include "batch.hpp"
+#include "boundedQueue.hpp"
+#include "trace.hpp"
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace batch {
+namespace {
+struct Job {
+  QString inputPath;
+  QString outputPath;
+  ImageWrapper image;
+};
+
+const QStringList IMAGE_FILTERS{"*.png",  "*.jpg", "*.jpeg", "*.bmp", "*.tif",
+                                "*.tiff", "*.pgm", "*.ppm",  "*.webp"};
+
+// images are written the same way they're shown, HSV and Lab are saved as RGB
+cv::Mat toWritable(const ImageWrapper &image) {
+  if (image.getFormat() == PixelFormat::HSV24 || image.getFormat() == PixelFormat::Lab24)
+    return image.toRGB().getMat();
+  return image.getMat();
+}
+
+template <typename Fn> std::vector<std::thread> startThreads(int count, Fn fn) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < std::max(1, count); ++i)
+    threads.emplace_back(fn);
+  return threads;
+}
+
+void joinAll(std::vector<std::thread> &threads) {
+  for (std::thread &thread : threads)
+    thread.join();
+}
+} // namespace
+
+bool isRequested(int argc, char *argv[]) {
+  for (int i = 1; i < argc; ++i)
+    if (std::strcmp(argv[i], "--batch") == 0)
+      return true;
+  return false;
+}
+
+std::optional<PipelineStep> parseStep(const QString &spec) {
+  QString name = spec.section(':', 0, 0).trimmed();
+  QString paramsSpec = spec.section(':', 1);
+  if (!Pipeline::isKnownOperation(name))
+    return std::nullopt;
+
+  QJsonArray params;
+  if (!paramsSpec.trimmed().isEmpty()) {
+    for (const QString &param : paramsSpec.split(',')) {
+      bool ok = false;
+      double value = param.trimmed().toDouble(&ok);
+      if (!ok)
+        return std::nullopt;
+      params.append(value);
+    }
+  }
+  return PipelineStep{name, params};
+}
+
+Summary run(const Options &options) {
+  QFileInfoList files =
+      QDir(options.inputDir).entryInfoList(IMAGE_FILTERS, QDir::Files, QDir::Name);
+  QDir().mkpath(options.outputDir);
+  QDir outputDir(options.outputDir);
+
+  BoundedQueue<Job> decoded(options.queueCapacity);
+  BoundedQueue<Job> processed(options.queueCapacity);
+  std::atomic<int> nextFile{0}, processedCount{0}, failedCount{0};
+  std::mutex logMutex;
+  auto logError = [&logMutex, &failedCount](const QString &path, const QString &message) {
+    std::lock_guard lock(logMutex);
+    std::cerr << path.toStdString() << ": " << message.toStdString() << std::endl;
+    ++failedCount;
+  };
+
+  // with --format a.png and a.jpg would both be written to a.<format>, only the first one is
+  std::vector<QString> outputPaths(files.size());
+  std::map<QString, QString> inputOf;
+  for (int i = 0; i < files.size(); ++i) {
+    QString suffix = options.format.isEmpty() ? files[i].suffix() : options.format;
+    QString outputPath = outputDir.filePath(files[i].completeBaseName() + "." + suffix);
+    auto [it, inserted] = inputOf.emplace(outputPath, files[i].filePath());
+    if (inserted)
+      outputPaths[i] = outputPath;
+    else
+      logError(files[i].filePath(), "would overwrite the result of " + it->second);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  auto decodeThreads = startThreads(options.decodeThreads, [&]() {
+    trace::setThreadName("decode");
+    for (int i = nextFile++; i < files.size(); i = nextFile++) {
+      const QFileInfo &file = files[i];
+      if (outputPaths[i].isEmpty())
+        continue;
+      TRACE_SCOPE("batch::decode");
+      cv::Mat mat = cv::imread(file.absoluteFilePath().toStdString(), cv::IMREAD_ANYCOLOR);
+      if (mat.empty()) {
+        logError(file.filePath(), "couldn't read the image");
+        continue;
+      }
+      // images with other numbers of channels than 1 or 3 aren't supported
+      std::optional<ImageWrapper> image;
+      try {
+        image = ImageWrapper(mat);
+      } catch (const std::exception &e) {
+        logError(file.filePath(), e.what());
+        continue;
+      }
+      decoded.push({file.filePath(), outputPaths[i], std::move(image.value())});
+    }
+  });
+
+  auto processThreads = startThreads(options.processThreads, [&]() {
+    trace::setThreadName("process");
+    while (auto job = decoded.pop()) {
+      try {
+        {
+          TRACE_SCOPE("batch::process");
+          job->image = options.pipeline.apply(job->image);
+        }
+        processed.push(std::move(job.value()));
+      } catch (const std::exception &e) {
+        logError(job->inputPath, e.what());
+      }
+    }
+  });
+
+  auto encodeThreads = startThreads(options.encodeThreads, [&]() {
+    trace::setThreadName("encode");
+    while (auto job = processed.pop()) {
+      try {
+        TRACE_SCOPE("batch::encode");
+        if (cv::imwrite(job->outputPath.toStdString(), toWritable(job->image)))
+          ++processedCount;
+        else
+          logError(job->outputPath, "couldn't write the image");
+      } catch (const cv::Exception &e) {
+        logError(job->outputPath, e.what());
+      }
+    }
+  });
+
+  // every stage is closed only after all of its producers have finished
+  joinAll(decodeThreads);
+  decoded.close();
+  joinAll(processThreads);
+  processed.close();
+  joinAll(encodeThreads);
+
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return {processedCount.load(), failedCount.load(), elapsed.count()};
+}
+
+int runFromArguments(const QStringList &arguments) {
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Applies a sequence of operations to every image in a "
+                                   "directory without starting the GUI.");
+  parser.addHelpOption();
+
+  const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  const int ioThreads = std::max(1, cores / 4);
+  QCommandLineOption batchOption("batch", "Run without the GUI.");
+  QCommandLineOption inputOption({"i", "input"}, "Directory with the input images.", "dir");
+  QCommandLineOption outputOption({"o", "output"}, "Directory for the results.", "dir");
+  QCommandLineOption opOption(
+      "op", "Operation to apply, can be repeated. Parameters follow a colon, e.g. blurMean:5,4.",
+      "name[:params]");
+  QCommandLineOption pipelineOption("pipeline", "Pipeline saved from the GUI, applied first.",
+                                    "file");
+  QCommandLineOption formatOption("format", "Extension of the output files.", "ext");
+  QCommandLineOption decodeOption("decode-threads", "Threads reading images.", "n",
+                                  QString::number(ioThreads));
+  QCommandLineOption threadsOption("threads", "Threads processing images.", "n",
+                                   QString::number(cores));
+  QCommandLineOption encodeOption("encode-threads", "Threads writing images.", "n",
+                                  QString::number(ioThreads));
+  QCommandLineOption queueOption("queue", "Images buffered between stages.", "n", "8");
+  parser.addOptions({batchOption, inputOption, outputOption, opOption, pipelineOption,
+                     formatOption, decodeOption, threadsOption, encodeOption, queueOption});
+  parser.process(arguments);
+
+  if (!parser.isSet(inputOption) || !parser.isSet(outputOption)) {
+    std::cerr << "Both --input and --output are required." << std::endl;
+    return 2;
+  }
+
+  Options options;
+  options.inputDir = parser.value(inputOption);
+  options.outputDir = parser.value(outputOption);
+  options.format = parser.value(formatOption);
+  options.decodeThreads = parser.value(decodeOption).toInt();
+  options.processThreads = parser.value(threadsOption).toInt();
+  options.encodeThreads = parser.value(encodeOption).toInt();
+  options.queueCapacity = std::max(1, parser.value(queueOption).toInt());
+
+  if (parser.isSet(pipelineOption)) {
+    QFile file(parser.value(pipelineOption));
+    std::optional<Pipeline> pipeline;
+    if (file.open(QIODevice::ReadOnly))
+      pipeline = Pipeline::fromJson(file.readAll());
+    if (!pipeline.has_value()) {
+      std::cerr << "Couldn't load the pipeline from " << file.fileName().toStdString()
+                << std::endl;
+      return 2;
+    }
+    options.pipeline.append(pipeline.value());
+  }
+  for (const QString &spec : parser.values(opOption)) {
+    auto step = parseStep(spec);
+    if (!step.has_value()) {
+      std::cerr << "Invalid operation: " << spec.toStdString() << std::endl;
+      return 2;
+    }
+    options.pipeline.append(step.value());
+  }
+
+  // images are already processed in parallel, nested OpenCV threads would only oversubscribe
+  cv::setNumThreads(1);
+  Summary summary = run(options);
+
+  std::cout << "Processed " << summary.processed << " images in " << summary.seconds << " s ("
+            << (summary.seconds > 0 ? summary.processed / summary.seconds : 0) << " images/s)";
+  if (summary.failed > 0)
+    std::cout << ", " << summary.failed << " failed";
+  std::cout << std::endl;
+  return summary.failed > 0 ? 1 : 0;
+}
+} // namespace batch
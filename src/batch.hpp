@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pipeline.hpp"
+#include <QString>
+#include <QStringList>
+#include <cstddef>
+
+// Headless processing of a whole directory, used when APO is started with --batch.
+namespace batch {
+struct Options {
+  QString inputDir;
+  QString outputDir;
+  // output extension (e.g. "png"), empty keeps the extension of each input file
+  QString format;
+  Pipeline pipeline;
+  int decodeThreads = 1;
+  int processThreads = 1;
+  int encodeThreads = 1;
+  // maximum number of images waiting between two stages
+  std::size_t queueCapacity = 8;
+};
+
+struct Summary {
+  int processed = 0;
+  int failed = 0;
+  double seconds = 0;
+};
+
+bool isRequested(int argc, char *argv[]);
+
+// parses "name" or "name:p1,p2,..." into a step with numeric parameters,
+// returns nullopt for unknown operations or parameters that aren't numbers
+std::optional<PipelineStep> parseStep(const QString &spec);
+
+// images are read, processed and written by separate groups of threads connected with bounded
+// queues so that disk and codec work overlaps with processing
+Summary run(const Options &options);
+
+// parses the command line, runs the batch and returns the process exit code
+int runFromArguments(const QStringList &arguments);
+} // namespace batch
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+// Blocking multi-producer multi-consumer queue with a limited capacity.
+// Producers wait when the queue is full, which keeps a fast stage from buffering
+// an unbounded number of images in front of a slow one.
+template <typename T> class BoundedQueue {
+public:
+  explicit BoundedQueue(std::size_t capacity) : capacity(capacity) {}
+
+  // returns false if the queue was closed and the item has been dropped
+  bool push(T item) {
+    std::unique_lock lock(mutex);
+    notFull.wait(lock, [this]() { return closed || items.size() < capacity; });
+    if (closed)
+      return false;
+    items.push_back(std::move(item));
+    notEmpty.notify_one();
+    return true;
+  }
+
+  // returns nullopt once the queue is closed and there are no items left
+  std::optional<T> pop() {
+    std::unique_lock lock(mutex);
+    notEmpty.wait(lock, [this]() { return closed || !items.empty(); });
+    if (items.empty())
+      return std::nullopt;
+    T item = std::move(items.front());
+    items.pop_front();
+    notFull.notify_one();
+    return item;
+  }
+
+  // no more items will be pushed, consumers will drain what is left
+  void close() {
+    std::lock_guard lock(mutex);
+    closed = true;
+    notEmpty.notify_all();
+    notFull.notify_all();
+  }
+
+private:
+  std::mutex mutex;
+  std::condition_variable notEmpty, notFull;
+  std::deque<T> items;
+  std::size_t capacity;
+  bool closed = false;
+};
@@ -0,0 +1,62 @@
+#include "cpuDispatch.hpp"
+#include <cstdlib>
+#include <iostream>
+
+namespace cpuDispatch {
+IsaLevel detected() {
+  static const IsaLevel level = []() {
+#ifdef APO_ISA_DISPATCH
+    // reads CPUID and checks that the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl"))
+      return IsaLevel::AVX512;
+    if (__builtin_cpu_supports("avx2"))
+      return IsaLevel::AVX2;
+#endif
+    return IsaLevel::Baseline;
+  }();
+  return level;
+}
+
+IsaLevel active() {
+  static const IsaLevel level = []() {
+    const char *value = std::getenv(OVERRIDE_VARIABLE);
+    if (value == nullptr || *value == '\0')
+      return detected();
+    std::optional<IsaLevel> requested = parse(value);
+    if (!requested.has_value()) {
+      std::cerr << OVERRIDE_VARIABLE << ": unknown level " << value << std::endl;
+      return detected();
+    }
+    if (!isSupported(requested.value())) {
+      std::cerr << OVERRIDE_VARIABLE << ": " << value << " isn't supported, using "
+                << name(detected()) << std::endl;
+      return detected();
+    }
+    return requested.value();
+  }();
+  return level;
+}
+
+bool isSupported(IsaLevel level) { return level <= detected(); }
+
+const char *name(IsaLevel level) {
+  switch (level) {
+  case IsaLevel::Baseline:
+    return "baseline";
+  case IsaLevel::AVX2:
+    return "avx2";
+  case IsaLevel::AVX512:
+    return "avx512";
+  }
+  return "";
+}
+
+std::optional<IsaLevel> parse(const std::string &name) {
+  for (IsaLevel level : {IsaLevel::Baseline, IsaLevel::AVX2, IsaLevel::AVX512})
+    if (name == cpuDispatch::name(level))
+      return level;
+  return std::nullopt;
+}
+} // namespace cpuDispatch
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+// Picks the instruction set the kernels are run with. The build targets the lowest common
+// denominator, the kernels are additionally compiled for newer instruction sets and the best one
+// the CPU supports is chosen at startup.
+namespace cpuDispatch {
+enum class IsaLevel { Baseline, AVX2, AVX512 };
+
+// environment variable forcing a level, e.g. APO_ISA=baseline, to compare them
+const char *const OVERRIDE_VARIABLE = "APO_ISA";
+
+// best level the kernels were compiled for that the CPU supports
+IsaLevel detected();
+// level the kernels run with, detected() unless APO_ISA asks for a supported one
+IsaLevel active();
+bool isSupported(IsaLevel level);
+const char *name(IsaLevel level);
+std::optional<IsaLevel> parse(const std::string &name);
+} // namespace cpuDispatch
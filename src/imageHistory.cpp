@@ -0,0 +1,228 @@
+#include "imageHistory.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using imageProcessor::LUT;
+
+namespace {
+const int TILE_SIZE = 256;
+// history is updated after every operation so speed matters more than the ratio
+const int COMPRESSION_LEVEL = 1;
+const std::size_t DEFAULT_BUDGET_BYTES = std::size_t(512) * 1024 * 1024;
+
+std::size_t budgetFromEnv() {
+  const char *env = std::getenv("APO_HISTORY_BUDGET_MB");
+  if (env == nullptr)
+    return DEFAULT_BUDGET_BYTES;
+
+  char *end;
+  unsigned long long mb = std::strtoull(env, &end, 10);
+  if (end == env)
+    return DEFAULT_BUDGET_BYTES;
+  return static_cast<std::size_t>(mb) * 1024 * 1024;
+}
+
+bool tilesEqual(const cv::Mat &a, const cv::Mat &b) {
+  const std::size_t rowBytes = a.cols * a.elemSize();
+  for (int y = 0; y < a.rows; ++y) {
+    if (std::memcmp(a.ptr(y), b.ptr(y), rowBytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+QByteArray compressTile(const cv::Mat &tile) {
+  // ROI of a bigger image has gaps between rows
+  cv::Mat continuous = tile.isContinuous() ? tile : tile.clone();
+  return qCompress(continuous.data, continuous.total() * continuous.elemSize(), COMPRESSION_LEVEL);
+}
+
+void decompressTile(const QByteArray &data, cv::Mat tile) {
+  QByteArray raw = qUncompress(data);
+  const std::size_t rowBytes = tile.cols * tile.elemSize();
+  CV_Assert(static_cast<std::size_t>(raw.size()) == rowBytes * tile.rows);
+
+  for (int y = 0; y < tile.rows; ++y)
+    std::memcpy(tile.ptr(y), raw.constData() + y * rowBytes, rowBytes);
+}
+
+// returns nullopt if the LUT maps two values to the same one
+std::optional<LUT> invertLUT(const LUT &lut) {
+  LUT inverse(256, 0);
+  std::vector<bool> seen(256, false);
+  for (int i = 0; i < 256; ++i) {
+    if (seen[lut[i]])
+      return std::nullopt;
+    seen[lut[i]] = true;
+    inverse[lut[i]] = static_cast<uchar>(i);
+  }
+  return inverse;
+}
+} // namespace
+
+std::size_t ImageHistory::budgetBytes = budgetFromEnv();
+std::size_t ImageHistory::usedBytes = 0;
+std::uint64_t ImageHistory::nextSequence = 0;
+std::vector<ImageHistory *> ImageHistory::histories;
+
+std::size_t ImageHistory::Entry::bytes() const {
+  std::size_t total = sizeof(Entry);
+  for (const Tile &tile : tiles)
+    total += sizeof(Tile) + tile.data.size();
+  if (lut.has_value())
+    total += lut->size();
+  return total;
+}
+
+ImageHistory::ImageHistory() { histories.push_back(this); }
+
+ImageHistory::~ImageHistory() {
+  clear();
+  histories.erase(std::find(histories.begin(), histories.end(), this));
+}
+
+void ImageHistory::setMemoryBudget(std::size_t bytes) {
+  budgetBytes = bytes;
+  enforceBudget();
+}
+
+ImageHistory::Entry ImageHistory::makeEntry(const ImageWrapper &target, const ImageWrapper &base) {
+  const cv::Mat &t = target.getMat();
+  const cv::Mat &b = base.getMat();
+
+  Entry entry;
+  entry.sequence = nextSequence++;
+  entry.format = target.getFormat();
+  entry.size = t.size();
+  entry.type = t.type();
+  // there's nothing to diff against if the geometry has changed
+  entry.full = t.size() != b.size() || t.type() != b.type();
+
+  for (int y = 0; y < t.rows; y += TILE_SIZE) {
+    for (int x = 0; x < t.cols; x += TILE_SIZE) {
+      cv::Rect rect(x, y, std::min(TILE_SIZE, t.cols - x), std::min(TILE_SIZE, t.rows - y));
+      if (!entry.full && tilesEqual(t(rect), b(rect)))
+        continue;
+      entry.tiles.push_back({rect, compressTile(t(rect))});
+    }
+  }
+  return entry;
+}
+
+ImageHistory::Entry ImageHistory::makeLUTEntry(const ImageWrapper &target, const LUT &lut) {
+  Entry entry;
+  entry.sequence = nextSequence++;
+  entry.format = target.getFormat();
+  entry.size = target.getMat().size();
+  entry.type = target.getMat().type();
+  entry.lut = lut;
+  return entry;
+}
+
+ImageWrapper ImageHistory::restore(const Entry &entry, const ImageWrapper &current) {
+  if (entry.lut.has_value()) {
+    ImageWrapper restored(imageProcessor::applyLUTcv(current.getMat(), entry.lut.value()),
+                          entry.format);
+    // the histograms follow the pixels through the LUT
+    imageProcessor::deriveHistograms(current, restored, entry.lut.value());
+    return restored;
+  }
+  cv::Mat mat = entry.full ? cv::Mat(entry.size, entry.type) : current.getMat().clone();
+  for (const Tile &tile : entry.tiles)
+    decompressTile(tile.data, mat(tile.rect));
+  return ImageWrapper(mat, entry.format);
+}
+
+void ImageHistory::push(const ImageWrapper &before, const ImageWrapper &after) {
+  pushEntry(makeEntry(before, after));
+}
+
+void ImageHistory::pushLUT(const ImageWrapper &before, const ImageWrapper &after, const LUT &lut) {
+  // if a LUT loses information the image from before can't be recomputed
+  auto inverse = invertLUT(lut);
+  if (!inverse.has_value() || before.getFormat() != after.getFormat()) {
+    push(before, after);
+    return;
+  }
+  pushEntry(makeLUTEntry(before, inverse.value()));
+}
+
+void ImageHistory::pushEntry(Entry entry) {
+  clearRedo();
+  usedBytes += entry.bytes();
+  undoStack.push_back(std::move(entry));
+  enforceBudget();
+}
+
+std::optional<ImageWrapper> ImageHistory::undo(const ImageWrapper &current) {
+  if (undoStack.empty())
+    return std::nullopt;
+
+  Entry entry = std::move(undoStack.back());
+  undoStack.pop_back();
+  usedBytes -= entry.bytes();
+
+  ImageWrapper previous = restore(entry, current);
+  Entry redoEntry = entry.lut.has_value() ? makeLUTEntry(current, invertLUT(*entry.lut).value())
+                                          : makeEntry(current, previous);
+  usedBytes += redoEntry.bytes();
+  redoStack.push_back(std::move(redoEntry));
+  enforceBudget();
+  return previous;
+}
+
+std::optional<ImageWrapper> ImageHistory::redo(const ImageWrapper &current) {
+  if (redoStack.empty())
+    return std::nullopt;
+
+  Entry entry = std::move(redoStack.back());
+  redoStack.pop_back();
+  usedBytes -= entry.bytes();
+
+  ImageWrapper next = restore(entry, current);
+  Entry undoEntry = entry.lut.has_value() ? makeLUTEntry(current, invertLUT(*entry.lut).value())
+                                          : makeEntry(current, next);
+  usedBytes += undoEntry.bytes();
+  undoStack.push_back(std::move(undoEntry));
+  enforceBudget();
+  return next;
+}
+
+void ImageHistory::clearRedo() {
+  for (const Entry &entry : redoStack)
+    usedBytes -= entry.bytes();
+  redoStack.clear();
+}
+
+void ImageHistory::clear() {
+  clearRedo();
+  for (const Entry &entry : undoStack)
+    usedBytes -= entry.bytes();
+  undoStack.clear();
+}
+
+void ImageHistory::enforceBudget() {
+  while (usedBytes > budgetBytes) {
+    // forget the oldest step of all images, redo steps are dropped
+    // only when there are no undo steps left as they're less likely to be needed
+    std::deque<Entry> *oldest = nullptr;
+    for (ImageHistory *history : histories) {
+      if (!history->undoStack.empty() &&
+          (oldest == nullptr || history->undoStack.front().sequence < oldest->front().sequence))
+        oldest = &history->undoStack;
+    }
+    if (oldest == nullptr) {
+      for (ImageHistory *history : histories) {
+        if (!history->redoStack.empty() &&
+            (oldest == nullptr || history->redoStack.front().sequence < oldest->front().sequence))
+          oldest = &history->redoStack;
+      }
+    }
+    if (oldest == nullptr)
+      return;
+
+    usedBytes -= oldest->front().bytes();
+    oldest->pop_front();
+  }
+}
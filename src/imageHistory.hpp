@@ -0,0 +1,85 @@
+#pragma once
+
+#include "imageProcessor.hpp"
+#include "imageWrapper.hpp"
+#include <QByteArray>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// Undo/redo history of a single image.
+//
+// Instead of keeping a copy of every image only tiles that differ between two successive images
+// are kept, compressed. Steps that only applied an invertible LUT don't store any pixels at all,
+// the other image gets recomputed by applying the (inverted) LUT to the current one.
+//
+// Memory used by histories of all images is limited by a single global budget, once it's exceeded
+// the oldest steps are forgotten. Budget can be set with the APO_HISTORY_BUDGET_MB environment
+// variable or with `setMemoryBudget`.
+//
+// NOTE: not thread safe, histories should only be used from the UI thread
+class ImageHistory {
+public:
+  ImageHistory();
+  ~ImageHistory();
+  ImageHistory(const ImageHistory &) = delete;
+  ImageHistory &operator=(const ImageHistory &) = delete;
+
+  // records a change of an image from `before` to `after`
+  void push(const ImageWrapper &before, const ImageWrapper &after);
+  // records a change of an image from `before` to `after` done by applying `lut` to each channel
+  void pushLUT(const ImageWrapper &before, const ImageWrapper &after,
+               const imageProcessor::LUT &lut);
+
+  // `current` must be the image that resulted from the last recorded (or redone) change,
+  // returns the image from before that change
+  std::optional<ImageWrapper> undo(const ImageWrapper &current);
+  // `current` must be the image returned by the last undo
+  std::optional<ImageWrapper> redo(const ImageWrapper &current);
+
+  bool canUndo() const { return !undoStack.empty(); }
+  bool canRedo() const { return !redoStack.empty(); }
+  void clear();
+
+  static void setMemoryBudget(std::size_t bytes);
+  static std::size_t getMemoryBudget() { return budgetBytes; }
+  // memory used by histories of all images
+  static std::size_t getUsedMemory() { return usedBytes; }
+
+private:
+  struct Tile {
+    cv::Rect rect;
+    QByteArray data;
+  };
+  // describes how to get one image given the other one
+  struct Entry {
+    std::uint64_t sequence;
+    // format and geometry of the image that this entry restores
+    PixelFormat format;
+    cv::Size size;
+    int type;
+    // whether `tiles` cover the entire image, otherwise only the changed tiles are stored
+    bool full = false;
+    std::vector<Tile> tiles;
+    // if set the image is restored by applying this LUT instead of copying tiles
+    std::optional<imageProcessor::LUT> lut;
+
+    std::size_t bytes() const;
+  };
+
+  static Entry makeEntry(const ImageWrapper &target, const ImageWrapper &base);
+  static Entry makeLUTEntry(const ImageWrapper &target, const imageProcessor::LUT &lut);
+  static ImageWrapper restore(const Entry &entry, const ImageWrapper &current);
+  void pushEntry(Entry entry);
+  void clearRedo();
+  static void enforceBudget();
+
+  // last element is the most recent one
+  std::deque<Entry> undoStack, redoStack;
+
+  static std::size_t budgetBytes;
+  static std::size_t usedBytes;
+  static std::uint64_t nextSequence;
+  static std::vector<ImageHistory *> histories;
+};
@@ -1,66 +1,170 @@
 #include "imageProcessor.hpp"
 #include "imageWrapper.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
 #include <QColorSpace>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <opencv2/core/utility.hpp>
 #include <qimage.h>
 #include <stdexcept>
 #include <vector>
 
 namespace imageProcessor {
 std::vector<int> histogram(const cv::Mat &mat) {
+  TRACE_SCOPE("imageProcessor::histogram");
   // we only calculate histograms for grayscale images
   if (mat.type() != CV_8UC1)
     return {};
 
   std::vector<int> histogram(256, 0);
 
-  for (int y = 0; y < mat.rows; ++y) {
-    const uchar *rowPtr = mat.ptr<uchar>(y);
-    for (int x = 0; x < mat.cols; ++x) {
-      histogram[rowPtr[x]]++;
+  kernels::get().histogram(mat.data, mat.cols, mat.rows, mat.step[0], histogram.data());
+  return histogram;
+}
+
+std::vector<std::vector<int>> channelHistograms(const cv::Mat &mat) {
+  if (mat.type() == CV_8UC1)
+    return {histogram(mat)};
+  if (mat.type() != CV_8UC3)
+    return {};
+  TRACE_SCOPE("imageProcessor::channelHistograms");
+
+  // all channels are counted in a single pass over the interleaved pixels
+  std::vector<int> bins(3 * 256, 0);
+  kernels::get().histogram3(mat.data, mat.cols, mat.rows, mat.step[0], bins.data());
+
+  std::vector<std::vector<int>> histograms;
+  for (int c = 0; c < 3; ++c)
+    histograms.emplace_back(bins.begin() + c * 256, bins.begin() + (c + 1) * 256);
+  return histograms;
+}
+
+SampledHistograms sampleHistograms(const cv::Mat &mat, std::size_t samples) {
+  SampledHistograms result;
+  const std::size_t total = mat.total();
+  if (total == 0 || total <= samples || samples == 0) {
+    result.hists = channelHistograms(mat);
+    result.samples = total;
+    return result;
+  }
+  if (mat.type() != CV_8UC1 && mat.type() != CV_8UC3)
+    return result;
+  TRACE_SCOPE("imageProcessor::sampleHistograms");
+
+  // cells about as wide as they're high
+  const int channels = mat.channels();
+  const int gridRows = std::clamp(
+      static_cast<int>(std::ceil(std::sqrt(static_cast<double>(samples) * mat.rows / mat.cols))),
+      1, mat.rows);
+  const int gridCols = std::clamp(
+      static_cast<int>(std::ceil(static_cast<double>(samples) / gridRows)), 1, mat.cols);
+
+  std::vector<int> bins(channels * 256, 0);
+  std::mutex mutex;
+  cv::parallel_for_(cv::Range(0, gridRows), [&](const cv::Range &range) {
+    std::vector<int> local(channels * 256, 0);
+    for (int r = range.start; r < range.end; ++r) {
+      // seeded by the row of the grid, so the sample doesn't depend on the number of threads
+      cv::RNG rng(0x9E3779B97F4A7C15ull + r);
+      int y0 = static_cast<int>(static_cast<long long>(mat.rows) * r / gridRows);
+      int y1 = static_cast<int>(static_cast<long long>(mat.rows) * (r + 1) / gridRows);
+      const uchar *row = mat.ptr<uchar>(rng.uniform(y0, y1));
+      for (int c = 0; c < gridCols; ++c) {
+        int x0 = static_cast<int>(static_cast<long long>(mat.cols) * c / gridCols);
+        int x1 = static_cast<int>(static_cast<long long>(mat.cols) * (c + 1) / gridCols);
+        const uchar *pixel = row + static_cast<std::size_t>(rng.uniform(x0, x1)) * channels;
+        for (int ch = 0; ch < channels; ++ch)
+          local[ch * 256 + pixel[ch]]++;
+      }
     }
+    std::lock_guard lock(mutex);
+    for (std::size_t i = 0; i < bins.size(); ++i)
+      bins[i] += local[i];
+  });
+
+  result.samples = static_cast<std::size_t>(gridRows) * gridCols;
+  const double scale = static_cast<double>(total) / result.samples;
+  for (int ch = 0; ch < channels; ++ch) {
+    std::vector<int> hist(256);
+    for (int v = 0; v < 256; ++v)
+      hist[v] = static_cast<int>(std::lround(bins[ch * 256 + v] * scale));
+    result.hists.push_back(std::move(hist));
   }
-  return histogram;
+  // Dvoretzky-Kiefer-Wolfowitz inequality for independent samples, one per cell only makes the
+  // sample more even
+  result.cdfError = std::sqrt(std::log(2 / 0.05) / (2.0 * result.samples));
+  return result;
+}
+
+std::vector<int> applyLUTToHistogram(const std::vector<int> &hist, const LUT &lut) {
+  // every pixel of value v becomes lut[v]
+  std::vector<int> result(256, 0);
+  for (int v = 0; v < 256; ++v)
+    result[lut[v]] += hist[v];
+  return result;
+}
+
+void deriveHistograms(const ImageWrapper &source, const ImageWrapper &result, const LUT &lut) {
+  if (!source.getStats() || !result.getStats())
+    return;
+  std::optional<ImageStats::Histograms> histograms = source.getStats()->cachedHistograms();
+  if (!histograms.has_value())
+    return;
+  for (auto &hist : histograms.value())
+    hist = applyLUTToHistogram(hist, lut);
+  result.getStats()->setHistograms(std::move(histograms.value()));
 }
 
 ImageWrapper applyLUT(const ImageWrapper &image, const LUT &lut) {
-  return ImageWrapper(applyLUTcv(image.getMat(), lut));
+  ImageWrapper result(applyLUTcv(image.getMat(), lut));
+  deriveHistograms(image, result, lut);
+  return result;
+}
+
+ImageWrapper applyChannelLUTs(const ImageWrapper &image, const std::vector<LUT> &luts) {
+  TRACE_SCOPE("imageProcessor::applyChannelLUTs");
+  const cv::Mat &mat = image.getMat();
+  CV_Assert(static_cast<int>(luts.size()) == mat.channels());
+  if (std::all_of(luts.begin(), luts.end(), [&luts](const LUT &lut) { return lut == luts[0]; }))
+    return applyLUT(image, luts[0]);
+
+  // an interleaved LUT lets OpenCV transform every channel in a single pass
+  cv::Mat interleaved(1, 256, CV_8UC(mat.channels()));
+  for (int v = 0; v < 256; ++v)
+    for (int c = 0; c < mat.channels(); ++c)
+      interleaved.ptr<uchar>()[v * mat.channels() + c] = luts[c][v];
+  cv::Mat res;
+  cv::LUT(mat, interleaved, res);
+
+  ImageWrapper result(res);
+  if (!image.getStats())
+    return result;
+  std::optional<ImageStats::Histograms> histograms = image.getStats()->cachedHistograms();
+  if (histograms.has_value() && histograms->size() == luts.size()) {
+    for (int c = 0; c < mat.channels(); ++c)
+      histograms.value()[c] = applyLUTToHistogram(histograms.value()[c], luts[c]);
+    result.getStats()->setHistograms(std::move(histograms.value()));
+  }
+  return result;
 }
 
 // applies LUT to every channel of an image
 cv::Mat applyLUTcv(const cv::Mat &mat, const LUT &lut) {
-  cv::Mat res = mat.clone();
-
-  if (res.channels() == 1) {
-    for (int y = 0; y < res.rows; ++y) {
-      uchar *rowPtr = res.ptr<uchar>(y);
-      for (int x = 0; x < res.cols; ++x) {
-        rowPtr[x] = lut[rowPtr[x]];
-      }
-    }
-  } else if (res.channels() == 3) { // Color (BGR)
-    for (int y = 0; y < res.rows; ++y) {
-      cv::Vec3b *rowPtr = res.ptr<cv::Vec3b>(y);
-      for (int x = 0; x < res.cols; ++x) {
-        rowPtr[x][0] = lut[rowPtr[x][0]]; // Blue
-        rowPtr[x][1] = lut[rowPtr[x][1]]; // Green
-        rowPtr[x][2] = lut[rowPtr[x][2]]; // Red
-      }
-    }
-  } else if (res.channels() == 4) { // Color (BGRA)
-    for (int y = 0; y < res.rows; ++y) {
-      cv::Vec4b *rowPtr = res.ptr<cv::Vec4b>(y);
-      for (int x = 0; x < res.cols; ++x) {
-        rowPtr[x][0] = lut[rowPtr[x][0]]; // Blue
-        rowPtr[x][1] = lut[rowPtr[x][1]]; // Green
-        rowPtr[x][2] = lut[rowPtr[x][2]]; // Red
-        rowPtr[x][3] = lut[rowPtr[x][3]]; // Alpha
-      }
-    }
-  } else {
+  TRACE_SCOPE("imageProcessor::applyLUTcv");
+  cv::Mat res(mat.size(), mat.type());
+  if (res.channels() != 1 && res.channels() != 3 && res.channels() != 4)
     throw std::runtime_error("Unsupported number of channels.");
-  }
+
+  // every channel goes through the same LUT, so the row can be treated as one long channel
+  const kernels::KernelTable &k = kernels::get();
+  std::size_t rowLength = static_cast<std::size_t>(mat.cols) * mat.channels();
+  for (int y = 0; y < res.rows; ++y)
+    k.applyLUT(mat.ptr<uchar>(y), res.ptr<uchar>(y), rowLength, lut.data());
   return res;
 }
 
@@ -96,13 +200,18 @@ LUT posterize(uchar n) {
 }
 
 LUT equalizeLUT(const cv::Mat &mat) {
-  std::vector<int> hist = histogram(mat);
-
+  TRACE_SCOPE("imageProcessor::equalizeLUT");
   if (mat.channels() != 1) {
     throw std::runtime_error("Tried to create an equalization LUT for a non-grayscale image!");
   }
+  return equalizeLUT(histogram(mat));
+}
+
+LUT equalizeLUT(const std::vector<int> &hist) {
   std::vector<float> cdf(256, 0);
-  int totalPixels = mat.rows * mat.cols;
+  long long totalPixels = std::accumulate(hist.begin(), hist.end(), 0LL);
+  if (totalPixels == 0)
+    return LUT(256, 0);
   cdf[0] = static_cast<float>(hist[0]) / totalPixels;
   for (int i = 1; i < 256; ++i) {
     cdf[i] = cdf[i - 1] + static_cast<float>(hist[i]) / totalPixels;
@@ -116,6 +225,16 @@ LUT equalizeLUT(const cv::Mat &mat) {
   return lut;
 }
 
+LUT normalizeLUT(const std::vector<int> &hist) {
+  auto isPresent = [](int count) { return count > 0; };
+  auto first = std::find_if(hist.begin(), hist.end(), isPresent);
+  if (first == hist.end())
+    return LUT(256, 0);
+  auto last = std::find_if(hist.rbegin(), hist.rend(), isPresent);
+  return stretch(static_cast<uchar>(first - hist.begin()),
+                 static_cast<uchar>(hist.rend() - last - 1), 0, 255);
+}
+
 cv::Mat applyToChannels(const cv::Mat &mat, std::function<cv::Mat(const cv::Mat)> f) {
   std::vector<cv::Mat> channels;
   cv::split(mat, channels);
@@ -130,6 +249,7 @@ cv::Mat applyToChannels(const cv::Mat &mat, std::function<cv::Mat(const cv::Mat)
 }
 
 cv::Mat normalizeChannels(const cv::Mat &mat) {
+  TRACE_SCOPE("imageProcessor::normalizeChannels");
   return applyToChannels(mat, [](const cv::Mat &channel) {
     double min, max;
     cv::minMaxLoc(channel, &min, &max);
@@ -140,16 +260,36 @@ cv::Mat normalizeChannels(const cv::Mat &mat) {
 }
 
 cv::Mat equalizeChannels(const cv::Mat &mat) {
+  TRACE_SCOPE("imageProcessor::equalizeChannels");
   return applyToChannels(
       mat, [](const cv::Mat &channel) { return applyLUTcv(channel, equalizeLUT(channel)); });
 }
+
+ImageWrapper normalizeChannels(const ImageWrapper &image) {
+  TRACE_SCOPE("imageProcessor::normalizeChannels");
+  std::vector<LUT> luts;
+  for (const ImageStats::Channel &channel : image.channelStats())
+    luts.push_back(stretch(static_cast<uchar>(channel.minValue),
+                           static_cast<uchar>(channel.maxValue), 0, 255));
+  return applyChannelLUTs(image, luts);
+}
+
+ImageWrapper equalizeChannels(const ImageWrapper &image) {
+  TRACE_SCOPE("imageProcessor::equalizeChannels");
+  std::vector<LUT> luts;
+  for (const std::vector<int> &hist : image.histograms())
+    luts.push_back(equalizeLUT(hist));
+  return applyChannelLUTs(image, luts);
+}
 cv::Mat rangeStretchChannels(const cv::Mat &mat, uchar p1, uchar p2, uchar q3, uchar q4) {
+  TRACE_SCOPE("imageProcessor::rangeStretchChannels");
   return applyToChannels(mat, [=](const cv::Mat &channel) {
     return applyLUTcv(channel, imageProcessor::stretch(p1, p2, q3, q4));
   });
 }
 
 cv::Mat skeletonize(const cv::Mat &mat, const cv::Mat &structuringElement, int borderType) {
+  TRACE_SCOPE("imageProcessor::skeletonize");
   return applyToChannels(mat, [structuringElement, borderType](cv::Mat channel) {
     cv::Mat skel(channel.size(), CV_8UC1, cv::Scalar(0));
     cv::Mat temp;
@@ -192,6 +332,7 @@ cv::Mat convolveNormalize(cv::Mat image, cv::Mat kernel, int borderType) {
 } // namespace
 
 cv::Mat convolve(cv::Mat image, cv::Mat kernel, int borderType) {
+  TRACE_SCOPE("imageProcessor::convolve");
   int sum = cv::sum(kernel)[0];
   if (sum == 0 || sum == 1) {
     cv::Mat out;
@@ -203,6 +344,7 @@ cv::Mat convolve(cv::Mat image, cv::Mat kernel, int borderType) {
   }
 }
 std::vector<uchar> extractLineProfile(const cv::Mat &img, cv::Point p1, cv::Point p2) {
+  TRACE_SCOPE("imageProcessor::extractLineProfile");
   std::vector<uchar> profile;
 
   cv::LineIterator it(img, p1, p2, 8);
@@ -303,66 +445,23 @@ cv::Mat invertAffineMatrix(cv::Mat M) {
 // the value of a destination point will be a bilinear interpolation of 4 points in the source image
 // that are neighbors of the closest point.
 cv::Mat warpAffine(const cv::Mat &mat, const cv::Mat &affineMat) {
+  TRACE_SCOPE("imageProcessor::warpAffine");
   cv::Mat invAffine = invertAffineMatrix(affineMat); // M'
 
-  double a00 = invAffine.at<double>(0, 0);
-  double a01 = invAffine.at<double>(0, 1);
-  double b1 = invAffine.at<double>(0, 2);
-  double a10 = invAffine.at<double>(1, 0);
-  double a11 = invAffine.at<double>(1, 1);
-  double b2 = invAffine.at<double>(1, 2);
+  const double inverse[] = {
+      invAffine.at<double>(0, 0), invAffine.at<double>(0, 1), invAffine.at<double>(0, 2),
+      invAffine.at<double>(1, 0), invAffine.at<double>(1, 1), invAffine.at<double>(1, 2),
+  };
 
   cv::Mat dst = cv::Mat::zeros(mat.rows, mat.cols, mat.type());
-
-  for (int y = 0; y < dst.rows; ++y) {
-    for (int x = 0; x < dst.cols; ++x) {
-      float srcX = a00 * x + a01 * y + b1;
-      float srcY = a10 * x + a11 * y + b2;
-
-      int x0 = static_cast<int>(std::floor(srcX));
-      int y0 = static_cast<int>(std::floor(srcY));
-
-      float dx = srcX - x0;
-      float dy = srcY - y0;
-
-      // if not on a bottom or left border
-      if (x0 >= 0 && x0 + 1 < mat.cols && y0 >= 0 && y0 + 1 < mat.rows) {
-        switch (mat.channels()) {
-        case 1: {
-          // value of the current pixel is a bilinear interpolation of values of
-          // 4 neighboring pixels (with the current one being the top-left one)
-          float v00 = mat.at<uchar>(y0, x0);
-          float v01 = mat.at<uchar>(y0, x0 + 1);
-          float v10 = mat.at<uchar>(y0 + 1, x0);
-          float v11 = mat.at<uchar>(y0 + 1, x0 + 1);
-
-          // The actual value that will be put in place of this pixel is going to be
-          // interpolated based on the real distance from the closest pixel.
-          // The closer the neighboring point is the closer to it the value will be.
-          float val =
-              (1 - dx) * (1 - dy) * v00 + dx * (1 - dy) * v01 + (1 - dx) * dy * v10 + dx * dy * v11;
-
-          dst.at<uchar>(y, x) = cv::saturate_cast<uchar>(val);
-          break;
-        };
-        case 3: {
-          for (int c = 0; c < 3; ++c) {
-            float v00 = mat.at<cv::Vec3b>(y0, x0)[c];
-            float v01 = mat.at<cv::Vec3b>(y0, x0 + 1)[c];
-            float v10 = mat.at<cv::Vec3b>(y0 + 1, x0)[c];
-            float v11 = mat.at<cv::Vec3b>(y0 + 1, x0 + 1)[c];
-
-            float val = (1 - dx) * (1 - dy) * v00 + dx * (1 - dy) * v01 + (1 - dx) * dy * v10 +
-                        dx * dy * v11;
-
-            dst.at<cv::Vec3b>(y, x)[c] = cv::saturate_cast<uchar>(val);
-          }
-          break;
-        }
-        }
-      }
-    }
-  }
+  // other channel counts are left black
+  if (mat.channels() != 1 && mat.channels() != 3)
+    return dst;
+
+  const kernels::KernelTable &k = kernels::get();
+  kernels::WarpSource source{mat.data, mat.step[0], mat.cols, mat.rows, mat.channels()};
+  for (int y = 0; y < dst.rows; ++y)
+    k.warpAffineRow(source, inverse, y, dst.ptr<uchar>(y), dst.cols);
   return dst;
 }
 } // namespace
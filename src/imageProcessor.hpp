@@ -9,15 +9,46 @@ using LUT = std::vector<uchar>;
 
 ImageWrapper applyLUT(const ImageWrapper &image, const LUT &lut);
 cv::Mat applyLUTcv(const cv::Mat &mat, const LUT &lut);
+// histogram of an image after applying `lut` to it, computed from its histogram before
+std::vector<int> applyLUTToHistogram(const std::vector<int> &hist, const LUT &lut);
+// caches the histograms of `result`, which is `source` with `lut` applied to every channel, if
+// the ones of `source` are known
+void deriveHistograms(const ImageWrapper &source, const ImageWrapper &result, const LUT &lut);
+// applies luts[c] to channel c, the histograms of the result are derived if the ones of `image`
+// are known
+ImageWrapper applyChannelLUTs(const ImageWrapper &image, const std::vector<LUT> &luts);
 std::vector<int> histogram(const cv::Mat &mat);
+// a histogram per channel of an 8-bit image with 1 or 3 channels, empty for other types
+std::vector<std::vector<int>> channelHistograms(const cv::Mat &mat);
+
+// histograms estimated from a sample of the pixels, with counts scaled to the whole image
+struct SampledHistograms {
+  std::vector<std::vector<int>> hists;
+  std::size_t samples = 0;
+  // with 95% confidence no value of the cumulative distribution (the fraction of pixels up to
+  // a value) is off by more than this, 0 if every pixel was counted
+  double cdfError = 0;
+};
+const std::size_t DEFAULT_HISTOGRAM_SAMPLES = 1 << 20;
+// picks a random pixel in every cell of a grid over the image, the grid having about `samples`
+// cells, and counts them like `channelHistograms`. Images with at most `samples` pixels are
+// counted exactly
+SampledHistograms sampleHistograms(const cv::Mat &mat,
+                                   std::size_t samples = DEFAULT_HISTOGRAM_SAMPLES);
 LUT negate();
 LUT stretch(uchar p1, uchar p2, uchar q3, uchar q4);
 LUT posterize(uchar n);
 LUT equalizeLUT(const cv::Mat &mat);
+LUT equalizeLUT(const std::vector<int> &hist);
+// stretches the range of values present in `hist` to 0-255
+LUT normalizeLUT(const std::vector<int> &hist);
 cv::Mat medianBlur(const cv::Mat &mat, int k, int borderType);
 cv::Mat applyToChannels(const cv::Mat &mat, std::function<cv::Mat(cv::Mat)> f);
 cv::Mat normalizeChannels(const cv::Mat &mat);
 cv::Mat equalizeChannels(const cv::Mat &mat);
+// same as above, using the stats kept with the image instead of reading its pixels again
+ImageWrapper normalizeChannels(const ImageWrapper &image);
+ImageWrapper equalizeChannels(const ImageWrapper &image);
 cv::Mat rangeStretchChannels(const cv::Mat &mat, uchar p1, uchar p2, uchar q3, uchar q4);
 cv::Mat skeletonize(const cv::Mat &mat, const cv::Mat &structuringElement, int borderType);
 cv::Mat convolve(cv::Mat image, cv::Mat kernel, int borderType);
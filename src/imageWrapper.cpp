@@ -1,4 +1,8 @@
 #include "imageWrapper.hpp"
+#include "allocations.hpp"
+#include "imageProcessor.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
 #include <QImage>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
@@ -63,15 +67,94 @@ std::vector<std::string> channelNames(const PixelFormat &format) {
 }
 } // namespace PixelFormatUtils
 
+ImageStats::Histograms ImageStats::histograms(const cv::Mat &mat) {
+  if (auto known = cachedHistograms())
+    return known.value();
+  // computed without holding the lock, others may still read what's known
+  Histograms computed = imageProcessor::channelHistograms(mat);
+  std::lock_guard lock(mutex);
+  scans++;
+  histograms_ = computed;
+  return computed;
+}
+
+std::vector<ImageStats::Channel> ImageStats::channels(const cv::Mat &mat) {
+  std::vector<Channel> channels;
+  for (const std::vector<int> &hist : histograms(mat)) {
+    Channel channel;
+    long long pixels = 0, sum = 0;
+    for (int v = 0; v < 256; ++v) {
+      if (hist[v] == 0)
+        continue;
+      if (channel.minValue == -1)
+        channel.minValue = v;
+      channel.maxValue = v;
+      pixels += hist[v];
+      sum += static_cast<long long>(v) * hist[v];
+    }
+    if (pixels > 0)
+      channel.mean = static_cast<double>(sum) / pixels;
+    channels.push_back(channel);
+  }
+  return channels;
+}
+
+bool ImageStats::isBinary(const cv::Mat &mat) {
+  {
+    std::lock_guard lock(mutex);
+    if (isBinary_.has_value())
+      return isBinary_.value();
+    // known histograms answer it without reading the pixels
+    if (histograms_.has_value() && histograms_->size() == 1) {
+      const std::vector<int> &hist = histograms_->front();
+      isBinary_ = hist[0] + hist[255] == static_cast<long long>(mat.total());
+      return isBinary_.value();
+    }
+  }
+
+  // stops at the first row with a value other than 0 or 255
+  bool binary = mat.type() == CV_8UC1;
+  const kernels::KernelTable &k = kernels::get();
+  for (int y = 0; binary && y < mat.rows; ++y)
+    binary = k.isBinary(mat.ptr<uchar>(y), mat.cols);
+  std::lock_guard lock(mutex);
+  scans++;
+  isBinary_ = binary;
+  return binary;
+}
+
+std::optional<ImageStats::Histograms> ImageStats::cachedHistograms() const {
+  std::lock_guard lock(mutex);
+  return histograms_;
+}
+
+void ImageStats::setHistograms(Histograms histograms) {
+  std::lock_guard lock(mutex);
+  histograms_ = std::move(histograms);
+}
+
+int ImageStats::getScans() const {
+  std::lock_guard lock(mutex);
+  return scans;
+}
+
+// the clone has the same pixels, so it can share the stats
 ImageWrapper::ImageWrapper(const ImageWrapper &other)
-    : format_(other.format_), mat_(other.mat_.clone()) {}
+    : format_(other.format_), mat_(other.mat_.clone()), stats_(other.stats_) {}
 
 ImageWrapper &ImageWrapper::operator=(const ImageWrapper &rhs) {
   mat_ = rhs.mat_.clone();
   format_ = rhs.format_;
+  stats_ = rhs.stats_;
   return *this;
 }
 
+ImageWrapper ImageWrapper::sharedCopy() const {
+  ImageWrapper copy(mat_, format_);
+  copy.stats_ = stats_;
+  return copy;
+}
+
 ImageWrapper ImageWrapper::fromPath(QString filePath) {
   return ImageWrapper(cv::imread(filePath.toStdString(), cv::IMREAD_ANYCOLOR));
 }
@@ -80,7 +163,12 @@ ImageWrapper::ImageWrapper(cv::Mat mat) : mat_(std::move(mat)) {
   format_ = PixelFormatUtils::fromChannelsNumber(mat_.channels());
 }
 
+ImageWrapper::ImageWrapper(cv::Mat mat, PixelFormat format) : format_(format), mat_(std::move(mat)) {
+  CV_Assert(mat_.type() == PixelFormatUtils::toCvType(format_));
+}
+
 QImage ImageWrapper::generateQImage() const {
+  TRACE_SCOPE("ImageWrapper::generateQImage");
   QImage img;
   switch (format_) {
   case PixelFormat::Binary:
@@ -113,6 +201,7 @@ QImage ImageWrapper::generateQImage() const {
     break;
   }
   }
+  allocations::recordExternal(img.sizeInBytes());
   return img;
 }
 
@@ -121,7 +210,10 @@ QPixmap ImageWrapper::generateQPixmap() const {
   if (im.isNull()) {
     throw new std::runtime_error("Failed to generate a QImage!");
   }
-  return QPixmap::fromImage(im);
+  QPixmap pixmap = QPixmap::fromImage(im);
+  allocations::recordExternal(static_cast<std::size_t>(pixmap.width()) * pixmap.height() *
+                              pixmap.depth() / 8);
+  return pixmap;
 }
 
 std::vector<ImageWrapper> ImageWrapper::splitChannels() const {
@@ -281,21 +373,7 @@ ImageWrapper ImageWrapper::toGrayscale() const {
 // will return an ImageWrapper with a Binary format only if
 // the image is grayscale and doesn't contain any other value than 0 and 255
 std::optional<ImageWrapper> ImageWrapper::toBinary() const {
-  if (format_ != PixelFormat::Grayscale8)
-    return std::nullopt;
-
-  double minVal, maxVal;
-  cv::minMaxLoc(mat_, &minVal, &maxVal);
-
-  if ((minVal != 0 && minVal != 255) || (maxVal != 0 && maxVal != 255))
-    return std::nullopt;
-
-  // check that all pixels are either 0 or 255
-  cv::Mat nonZero, non255;
-  cv::compare(mat_, 0, nonZero, cv::CMP_NE);
-  cv::compare(mat_, 255, non255, cv::CMP_NE);
-  cv::bitwise_and(nonZero, non255, nonZero);
-  if (cv::countNonZero(nonZero) > 0)
+  if (format_ != PixelFormat::Grayscale8 || !isBinary())
     return std::nullopt;
 
   ImageWrapper out(*this);
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <QImage>
+#include <memory>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <optional>
 #include <qimage.h>
 
 namespace PixelFormatUtils {
@@ -25,12 +28,50 @@ std::vector<std::string> channelNames(const PixelFormat &format);
 
 using PixelFormatUtils::PixelFormat;
 
+// Statistics of an image's pixels, each computed the first time it's needed. Images are never
+// modified in place, so the stats are shared by the copies of an image and every new content
+// gets new ones. Thread safe.
+class ImageStats {
+public:
+  // in the order of the channels of the Mat
+  using Histograms = std::vector<std::vector<int>>;
+  struct Channel {
+    // -1 for an empty image
+    int minValue = -1, maxValue = -1;
+    double mean = 0;
+  };
+
+  // `mat` has to have the pixels these are the stats of, it's only read if a statistic isn't known
+  Histograms histograms(const cv::Mat &mat);
+  // derived from the histograms
+  std::vector<Channel> channels(const cv::Mat &mat);
+  // whether every value is either 0 or 255
+  bool isBinary(const cv::Mat &mat);
+
+  // histograms, only if they're already known
+  std::optional<Histograms> cachedHistograms() const;
+  // for histograms derived without looking at the pixels
+  void setHistograms(Histograms histograms);
+  // how many times the pixels were read
+  int getScans() const;
+
+private:
+  mutable std::mutex mutex;
+  std::optional<Histograms> histograms_;
+  std::optional<bool> isBinary_;
+  int scans = 0;
+};
+
 class ImageWrapper {
 public:
   ImageWrapper() = default;
   ImageWrapper(const ImageWrapper &imageWrapper);
   ImageWrapper &operator=(const ImageWrapper &rhs);
+  // unlike copying, moving doesn't need to clone the underlying data
+  ImageWrapper(ImageWrapper &&imageWrapper) = default;
+  ImageWrapper &operator=(ImageWrapper &&rhs) = default;
   ImageWrapper(cv::Mat mat);
+  ImageWrapper(cv::Mat mat, PixelFormat format);
   static ImageWrapper fromPath(QString filePath);
 
   const cv::Mat &getMat() const { return mat_; }
@@ -46,6 +87,15 @@ public:
   ImageWrapper toLab() const;
   ImageWrapper toGrayscale() const;
   std::optional<ImageWrapper> toBinary() const;
+  // copy sharing the pixels and the stats, for images that aren't modified in place
+  ImageWrapper sharedCopy() const;
+
+  // never null except for a moved-from image
+  const std::shared_ptr<ImageStats> &getStats() const { return stats_; }
+  // stats of the pixels, each one computed at most once for this content
+  ImageStats::Histograms histograms() const { return stats_->histograms(mat_); }
+  std::vector<ImageStats::Channel> channelStats() const { return stats_->channels(mat_); }
+  bool isBinary() const { return stats_->isBinary(mat_); }
 
 signals:
   void dataChanged(QPixmap pixmap);
@@ -53,4 +103,5 @@ signals:
 private:
   PixelFormat format_;
   cv::Mat mat_;
+  std::shared_ptr<ImageStats> stats_ = std::make_shared<ImageStats>();
 };
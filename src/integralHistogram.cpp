@@ -0,0 +1,104 @@
+#include "integralHistogram.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <opencv2/core/utility.hpp>
+
+IntegralHistogram::IntegralHistogram(const cv::Mat &mat, int tileSide)
+    : source(mat), tileSide(tileSide), channels(mat.channels()) {
+  TRACE_SCOPE("IntegralHistogram::build");
+  CV_Assert(mat.type() == CV_8UC1 || mat.type() == CV_8UC3);
+  CV_Assert(tileSide > 0);
+  tilesX = (mat.cols + tileSide - 1) / tileSide;
+  tilesY = (mat.rows + tileSide - 1) / tileSide;
+  cumulative.assign(static_cast<std::size_t>(tilesX + 1) * (tilesY + 1) * bins(), 0);
+
+  // histograms of single tiles, each stored at the tile's bottom-right corner
+  cv::parallel_for_(cv::Range(0, tilesY), [&](const cv::Range &range) {
+    for (int ty = range.start; ty < range.end; ++ty)
+      for (int tx = 0; tx < tilesX; ++tx) {
+        int x = tx * tileSide, y = ty * tileSide;
+        cv::Rect tile(x, y, boundary(tx + 1, source.cols) - x, boundary(ty + 1, source.rows) - y);
+        addPixels(tile, corner(tx + 1, ty + 1));
+      }
+  });
+  // summed along the rows of tiles and then along the columns
+  cv::parallel_for_(cv::Range(1, tilesY + 1), [&](const cv::Range &range) {
+    for (int ky = range.start; ky < range.end; ++ky)
+      for (int kx = 2; kx <= tilesX; ++kx) {
+        int *current = corner(kx, ky);
+        const int *previous = corner(kx - 1, ky);
+        for (int b = 0; b < bins(); ++b)
+          current[b] += previous[b];
+      }
+  });
+  cv::parallel_for_(cv::Range(1, tilesX + 1), [&](const cv::Range &range) {
+    for (int kx = range.start; kx < range.end; ++kx)
+      for (int ky = 2; ky <= tilesY; ++ky) {
+        int *current = corner(kx, ky);
+        const int *previous = corner(kx, ky - 1);
+        for (int b = 0; b < bins(); ++b)
+          current[b] += previous[b];
+      }
+  });
+}
+
+void IntegralHistogram::addPixels(const cv::Rect &rect, int *hist) const {
+  if (rect.empty())
+    return;
+  // a single call for the whole rectangle, the kernels count narrow strips without partial
+  // histograms
+  const kernels::KernelTable &k = kernels::get();
+  const uchar *start = source.ptr<uchar>(rect.y) + static_cast<std::size_t>(rect.x) * channels;
+  if (channels == 1)
+    k.histogram(start, rect.width, rect.height, source.step[0], hist);
+  else
+    k.histogram3(start, rect.width, rect.height, source.step[0], hist);
+}
+
+std::vector<std::vector<int>> IntegralHistogram::histograms(cv::Rect rect) const {
+  rect &= cv::Rect(0, 0, source.cols, source.rows);
+  std::vector<int> hist(bins(), 0);
+
+  // tile boundaries inside the rectangle, an edge of the image counts as one too
+  int right = rect.x + rect.width, bottom = rect.y + rect.height;
+  int kx0 = (rect.x + tileSide - 1) / tileSide;
+  int ky0 = (rect.y + tileSide - 1) / tileSide;
+  int kx1 = right == source.cols ? tilesX : right / tileSide;
+  int ky1 = bottom == source.rows ? tilesY : bottom / tileSide;
+
+  if (rect.empty() || kx0 >= kx1 || ky0 >= ky1) {
+    // not covering a whole tile
+    addPixels(rect, hist.data());
+  } else {
+    const int *a = corner(kx0, ky0), *b = corner(kx1, ky0);
+    const int *c = corner(kx0, ky1), *d = corner(kx1, ky1);
+    for (int i = 0; i < bins(); ++i)
+      hist[i] += d[i] - b[i] - c[i] + a[i];
+
+    // full height strips on the left and the right, then what's above and below the tiles
+    int x0 = boundary(kx0, source.cols), x1 = boundary(kx1, source.cols);
+    int y0 = boundary(ky0, source.rows), y1 = boundary(ky1, source.rows);
+    addPixels(cv::Rect(rect.x, rect.y, x0 - rect.x, rect.height), hist.data());
+    addPixels(cv::Rect(x1, rect.y, right - x1, rect.height), hist.data());
+    addPixels(cv::Rect(x0, rect.y, x1 - x0, y0 - rect.y), hist.data());
+    addPixels(cv::Rect(x0, y1, x1 - x0, bottom - y1), hist.data());
+  }
+
+  std::vector<std::vector<int>> result;
+  for (int ch = 0; ch < channels; ++ch)
+    result.emplace_back(hist.begin() + ch * 256, hist.begin() + (ch + 1) * 256);
+  return result;
+}
+
+std::vector<double> IntegralHistogram::mean(cv::Rect rect) const {
+  std::vector<double> means;
+  for (const std::vector<int> &hist : histograms(rect)) {
+    long long pixels = 0, sum = 0;
+    for (int v = 0; v < 256; ++v) {
+      pixels += hist[v];
+      sum += static_cast<long long>(v) * hist[v];
+    }
+    means.push_back(pixels == 0 ? 0 : static_cast<double>(sum) / pixels);
+  }
+  return means;
+}
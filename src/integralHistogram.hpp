@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <opencv2/core.hpp>
+#include <vector>
+
+// Index answering histogram and mean queries for any rectangle of an 8-bit image (1 or 3
+// channels) without scanning all of its pixels.
+//
+// Cumulative histograms are kept only at the corners of a grid of tiles, a full integral
+// histogram would take 256 counts per pixel. The tiles inside the queried rectangle take 4
+// lookups per bin, the pixels between its edges and the nearest tile boundaries are counted
+// directly. A query thus costs O(channels * 256 + tileSide * perimeter) and the index takes
+// channels * 256 ints per tile.
+class IntegralHistogram {
+public:
+  static const int DEFAULT_TILE_SIDE = 32;
+
+  IntegralHistogram() = default;
+  // builds the index in parallel, the pixels are shared with `mat`, not copied
+  explicit IntegralHistogram(const cv::Mat &mat, int tileSide = DEFAULT_TILE_SIDE);
+
+  bool isEmpty() const { return source.empty(); }
+  int getChannels() const { return channels; }
+  int getTileSide() const { return tileSide; }
+  // memory taken by the cumulative histograms
+  std::size_t getBytes() const { return cumulative.size() * sizeof(int); }
+
+  // a histogram of every channel of `rect` clipped to the image
+  std::vector<std::vector<int>> histograms(cv::Rect rect) const;
+  // mean of every channel of `rect` clipped to the image, 0 if nothing is left of it
+  std::vector<double> mean(cv::Rect rect) const;
+
+private:
+  cv::Mat source;
+  int tileSide = DEFAULT_TILE_SIDE;
+  int tilesX = 0, tilesY = 0;
+  int channels = 0;
+  // (tilesY + 1) x (tilesX + 1) corners, each with channels * 256 counts of the pixels above and
+  // to the left of it
+  std::vector<int> cumulative;
+
+  int bins() const { return channels * 256; }
+  // computed in std::size_t, the counts of images of a few gigapixels don't fit an int
+  std::size_t cornerIndex(int kx, int ky) const {
+    return (static_cast<std::size_t>(ky) * (tilesX + 1) + kx) * bins();
+  }
+  int *corner(int kx, int ky) { return &cumulative[cornerIndex(kx, ky)]; }
+  const int *corner(int kx, int ky) const { return &cumulative[cornerIndex(kx, ky)]; }
+  // position of the k-th tile boundary along an axis of `size` pixels
+  int boundary(int k, int size) const { return std::min(k * tileSide, size); }
+  // adds the pixels of `rect` to `hist`, channel c goes to hist[c * 256 + value]
+  void addPixels(const cv::Rect &rect, int *hist) const;
+};
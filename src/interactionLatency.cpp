@@ -0,0 +1,112 @@
+#include "interactionLatency.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+
+namespace interactionLatency {
+namespace {
+struct Samples {
+  std::vector<Sample> samples;
+  // position of the oldest sample once the buffer is full
+  std::size_t next = 0;
+};
+
+// samples are only recorded from the UI thread, the mutex is there for writing the report at exit
+std::mutex mutex;
+std::map<std::string, Samples> dialogs;
+
+template <typename Stage> Percentiles stagePercentiles(const Samples &samples, Stage stage) {
+  std::vector<double> values;
+  values.reserve(samples.samples.size());
+  for (const Sample &sample : samples.samples)
+    values.push_back(sample.*stage);
+  return percentiles(std::move(values));
+}
+
+void writeEscaped(std::ofstream &out, const std::string &text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"')
+      out << '"';
+    out << c;
+  }
+  out << '"';
+}
+} // namespace
+
+void record(const std::string &dialog, const Sample &sample) {
+  std::lock_guard lock(mutex);
+  Samples &samples = dialogs[dialog];
+  if (samples.samples.size() < SAMPLES_PER_DIALOG) {
+    samples.samples.push_back(sample);
+  } else {
+    samples.samples[samples.next] = sample;
+    samples.next = (samples.next + 1) % SAMPLES_PER_DIALOG;
+  }
+}
+
+std::vector<Summary> summarize() {
+  std::lock_guard lock(mutex);
+  std::vector<Summary> summaries;
+  for (const auto &[dialog, samples] : dialogs) {
+    summaries.push_back({dialog, stagePercentiles(samples, &Sample::computed),
+                         stagePercentiles(samples, &Sample::converted),
+                         stagePercentiles(samples, &Sample::painted)});
+  }
+  return summaries;
+}
+
+Percentiles percentiles(std::vector<double> values) {
+  Percentiles result;
+  result.count = values.size();
+  if (values.empty())
+    return result;
+  std::sort(values.begin(), values.end());
+  auto rank = [&](double p) {
+    auto index = static_cast<std::size_t>(std::ceil(p * values.size()));
+    return values[std::max<std::size_t>(index, 1) - 1];
+  };
+  result.p50 = rank(0.50);
+  result.p95 = rank(0.95);
+  result.p99 = rank(0.99);
+  result.max = values.back();
+  return result;
+}
+
+bool writeReport(const std::string &path) {
+  std::vector<Summary> summaries = summarize();
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  out << std::fixed << std::setprecision(3);
+  out << "dialog,stage,count,p50_ms,p95_ms,p99_ms,max_ms\n";
+  for (const Summary &summary : summaries) {
+    std::pair<const char *, const Percentiles &> stages[] = {
+        {"computed", summary.computed},
+        {"converted", summary.converted},
+        {"painted", summary.painted},
+    };
+    for (const auto &[stage, p] : stages) {
+      writeEscaped(out, summary.dialog);
+      out << ',' << stage << ',' << p.count << ',' << p.p50 << ',' << p.p95 << ',' << p.p99 << ','
+          << p.max << '\n';
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+void writeToEnvironmentPath() {
+  const char *path = std::getenv(REPORT_VARIABLE);
+  if (path != nullptr && *path != '\0')
+    writeReport(path);
+}
+
+void clear() {
+  std::lock_guard lock(mutex);
+  dialogs.clear();
+}
+} // namespace interactionLatency
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Latency between changing a parameter of a dialog and its preview being painted, collected
+// separately for every dialog so that each of them can be held to its own latency target.
+namespace interactionLatency {
+// number of the most recent samples kept for every dialog
+const std::size_t SAMPLES_PER_DIALOG = 4096;
+// environment variable with a path the report is written to when the program exits
+const char *const REPORT_VARIABLE = "APO_LATENCY_REPORT";
+
+// milliseconds since the parameter changed at which every stage of the preview finished
+struct Sample {
+  double computed;
+  double converted;
+  double painted;
+};
+
+struct Percentiles {
+  std::size_t count = 0;
+  double p50 = 0, p95 = 0, p99 = 0, max = 0;
+};
+
+struct Summary {
+  std::string dialog;
+  Percentiles computed, converted, painted;
+};
+
+void record(const std::string &dialog, const Sample &sample);
+// summaries of all dialogs with at least one sample, sorted by the name of the dialog
+std::vector<Summary> summarize();
+// nearest-rank percentiles of `values`
+Percentiles percentiles(std::vector<double> values);
+// writes the summaries as CSV, returns false if the file couldn't be written
+bool writeReport(const std::string &path);
+// writes the report to the path from APO_LATENCY_REPORT if it's set
+void writeToEnvironmentPath();
+void clear();
+} // namespace interactionLatency
@@ -0,0 +1,42 @@
+#include "kernels.hpp"
+#include "kernelsImpl.hpp"
+
+namespace kernels {
+#ifdef APO_ISA_DISPATCH
+// defined in the sources compiled for these levels
+const KernelTable &avx2Table();
+const KernelTable &avx512Table();
+#endif
+
+// defined in kernelsVerification.cpp
+bool isVerifying();
+const KernelTable &verifying();
+
+const KernelTable &get() {
+  static const KernelTable &table = forLevel(cpuDispatch::active());
+  return isVerifying() ? verifying() : table;
+}
+
+const KernelTable &forLevel(cpuDispatch::IsaLevel level) {
+  switch (level) {
+#ifdef APO_ISA_DISPATCH
+  case cpuDispatch::IsaLevel::AVX512:
+    return avx512Table();
+  case cpuDispatch::IsaLevel::AVX2:
+    return avx2Table();
+#endif
+  default:
+    return TABLE;
+  }
+}
+
+std::vector<Implementation> implementations() {
+  std::vector<Implementation> found{{"reference", &reference()}};
+  for (auto level : {cpuDispatch::IsaLevel::Baseline, cpuDispatch::IsaLevel::AVX2,
+                     cpuDispatch::IsaLevel::AVX512}) {
+    if (cpuDispatch::isSupported(level))
+      found.push_back({cpuDispatch::name(level), &forLevel(level)});
+  }
+  return found;
+}
+} // namespace kernels
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "cpuDispatch.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hot loops of imageProcessor working on rows of 8-bit pixels, compiled for every instruction
+// set level in cpuDispatch.
+namespace kernels {
+// 8-bit image the warp samples from
+struct WarpSource {
+  const std::uint8_t *data;
+  std::size_t step;
+  int cols, rows, channels;
+};
+
+struct KernelTable {
+  // dst[i] = lut[src[i]], `src` and `dst` may be the same
+  void (*applyLUT)(const std::uint8_t *src, std::uint8_t *dst, std::size_t n,
+                   const std::uint8_t *lut);
+  // adds the first `n` values of `rows` rows starting `step` bytes apart to 256 bins of `hist`
+  void (*histogram)(const std::uint8_t *src, std::size_t n, std::size_t rows, std::size_t step,
+                    int *hist);
+  // adds `pixels` interleaved 3-channel pixels of `rows` rows starting `step` bytes apart to
+  // 3 * 256 bins of `hist`, channel c goes to hist[c * 256 + value]
+  void (*histogram3)(const std::uint8_t *src, std::size_t pixels, std::size_t rows,
+                     std::size_t step, int *hist);
+  // dst[i] = src[i] > threshold ? maxValue : 0
+  void (*threshold)(const std::uint8_t *src, std::uint8_t *dst, std::size_t n,
+                    std::uint8_t threshold, std::uint8_t maxValue);
+  // whether every value is either 0 or 255
+  bool (*isBinary)(const std::uint8_t *src, std::size_t n);
+  // row `y` of the bilinear warp by the inverse affine matrix `inverse` (2x3, row major), pixels
+  // mapped outside of the source are left untouched, only 1 and 3 channels are supported
+  void (*warpAffineRow)(const WarpSource &src, const double *inverse, int y, std::uint8_t *dst,
+                        int cols);
+};
+
+// kernels of the active level, wrapped by the verification if it's turned on
+const KernelTable &get();
+// kernels of a given level, which has to be supported by the CPU
+const KernelTable &forLevel(cpuDispatch::IsaLevel level);
+// the straightforward implementations the optimized kernels have to match
+const KernelTable &reference();
+
+struct Implementation {
+  const char *name;
+  const KernelTable *table;
+};
+// the reference kernels followed by the kernels of every level the CPU supports
+std::vector<Implementation> implementations();
+
+// environment variable with N, every Nth call of a kernel is then checked against the reference
+const char *const VERIFY_VARIABLE = "APO_VERIFY_KERNELS";
+
+struct VerificationStats {
+  std::size_t checked = 0;
+  std::size_t mismatches = 0;
+};
+// checks every `every`th call of a kernel against the reference and reports mismatches on the
+// standard error, 0 turns the verification off
+void setVerification(std::size_t every);
+VerificationStats getVerificationStats();
+} // namespace kernels
@@ -0,0 +1,6 @@
+// compiled with AVX2 enabled
+#include "kernelsImpl.hpp"
+
+namespace kernels {
+const KernelTable &avx2Table() { return TABLE; }
+} // namespace kernels
@@ -0,0 +1,6 @@
+// compiled with AVX-512 (F, BW and VL) enabled
+#include "kernelsImpl.hpp"
+
+namespace kernels {
+const KernelTable &avx512Table() { return TABLE; }
+} // namespace kernels
@@ -0,0 +1,148 @@
+// Bodies of the kernels, included by one source file per instruction set level which is
+// compiled with the flags of that level. Everything is kept in an anonymous namespace and only
+// builtins are called, an inline function from another header could otherwise be emitted with
+// the wider instructions and picked by the linker for the baseline code as well.
+//
+// The loops are written so that the compiler can vectorize them, the floating point ones are
+// compiled without contracting into FMA so that all levels give exactly the same results.
+
+#include "kernels.hpp"
+
+namespace {
+using kernels::KernelTable;
+using kernels::WarpSource;
+
+void applyLUT(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, const std::uint8_t *lut) {
+  // gathers of single bytes are slower than scalar loads, the unrolling only lets the lookups of
+  // neighbouring pixels overlap
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    std::uint8_t v0 = lut[src[i]], v1 = lut[src[i + 1]], v2 = lut[src[i + 2]], v3 = lut[src[i + 3]];
+    dst[i] = v0;
+    dst[i + 1] = v1;
+    dst[i + 2] = v2;
+    dst[i + 3] = v3;
+  }
+  for (; i < n; ++i)
+    dst[i] = lut[src[i]];
+}
+
+// fewer values than this are counted straight into the histogram, zeroing and adding up the
+// partial histograms would take longer than counting them
+const std::size_t SHORT_RUN = 1024;
+
+void histogram(const std::uint8_t *src, std::size_t n, std::size_t rows, std::size_t step,
+               int *hist) {
+  if (n * rows < SHORT_RUN) {
+    for (std::size_t y = 0; y < rows; ++y, src += step)
+      for (std::size_t i = 0; i < n; ++i)
+        hist[src[i]]++;
+    return;
+  }
+  // consecutive equal pixels would otherwise wait for each other's increment
+  int partial[4][256] = {};
+  for (std::size_t y = 0; y < rows; ++y, src += step) {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+      partial[0][src[i]]++;
+      partial[1][src[i + 1]]++;
+      partial[2][src[i + 2]]++;
+      partial[3][src[i + 3]]++;
+    }
+    for (; i < n; ++i)
+      partial[0][src[i]]++;
+  }
+  for (int v = 0; v < 256; ++v)
+    hist[v] += partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+}
+
+void histogram3(const std::uint8_t *src, std::size_t pixels, std::size_t rows, std::size_t step,
+                int *hist) {
+  if (pixels * rows * 3 < SHORT_RUN) {
+    for (std::size_t y = 0; y < rows; ++y, src += step)
+      for (std::size_t i = 0; i < pixels; ++i)
+        for (int c = 0; c < 3; ++c)
+          hist[c * 256 + src[i * 3 + c]]++;
+    return;
+  }
+  // channels already go to separate bins, two pixels at a time keep equal neighbours apart too
+  int partial[2][3][256] = {};
+  for (std::size_t y = 0; y < rows; ++y, src += step) {
+    std::size_t i = 0;
+    for (; i + 2 <= pixels; i += 2) {
+      const std::uint8_t *p = src + i * 3;
+      partial[0][0][p[0]]++;
+      partial[0][1][p[1]]++;
+      partial[0][2][p[2]]++;
+      partial[1][0][p[3]]++;
+      partial[1][1][p[4]]++;
+      partial[1][2][p[5]]++;
+    }
+    for (; i < pixels; ++i)
+      for (int c = 0; c < 3; ++c)
+        partial[0][c][src[i * 3 + c]]++;
+  }
+  for (int c = 0; c < 3; ++c)
+    for (int v = 0; v < 256; ++v)
+      hist[c * 256 + v] += partial[0][c][v] + partial[1][c][v];
+}
+
+void threshold(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, std::uint8_t threshold,
+               std::uint8_t maxValue) {
+  for (std::size_t i = 0; i < n; ++i)
+    dst[i] = src[i] > threshold ? maxValue : 0;
+}
+
+bool isBinary(const std::uint8_t *src, std::size_t n) {
+  // checked in blocks, so that the inner loop has no early exit and can be vectorized
+  const std::size_t block = 1024;
+  for (std::size_t start = 0; start < n; start += block) {
+    std::size_t end = n - start < block ? n : start + block;
+    std::uint8_t invalid = 0;
+    // 255 + 1 wraps to 0, so only 0 and 255 end up at most 1
+    for (std::size_t i = start; i < end; ++i)
+      invalid |= static_cast<std::uint8_t>(src[i] + 1) > 1;
+    if (invalid)
+      return false;
+  }
+  return true;
+}
+
+std::uint8_t saturate(float value) {
+  long rounded = __builtin_lrintf(value);
+  return static_cast<std::uint8_t>(rounded < 0 ? 0 : rounded > 255 ? 255 : rounded);
+}
+
+void warpAffineRow(const WarpSource &src, const double *inverse, int y, std::uint8_t *dst,
+                   int cols) {
+  const double a00 = inverse[0], a01 = inverse[1], b1 = inverse[2];
+  const double a10 = inverse[3], a11 = inverse[4], b2 = inverse[5];
+  const int channels = src.channels;
+  for (int x = 0; x < cols; ++x) {
+    float srcX = a00 * x + a01 * y + b1;
+    float srcY = a10 * x + a11 * y + b2;
+
+    int x0 = static_cast<int>(__builtin_floorf(srcX));
+    int y0 = static_cast<int>(__builtin_floorf(srcY));
+    if (x0 < 0 || x0 + 1 >= src.cols || y0 < 0 || y0 + 1 >= src.rows)
+      continue;
+
+    float dx = srcX - x0;
+    float dy = srcY - y0;
+    const std::uint8_t *row0 = src.data + y0 * src.step + x0 * channels;
+    const std::uint8_t *row1 = row0 + src.step;
+    // bilinear interpolation of the 4 neighbours, the closer one is the more it weighs
+    for (int c = 0; c < channels; ++c) {
+      float v00 = row0[c];
+      float v01 = row0[channels + c];
+      float v10 = row1[c];
+      float v11 = row1[channels + c];
+      float val =
+          (1 - dx) * (1 - dy) * v00 + dx * (1 - dy) * v01 + (1 - dx) * dy * v10 + dx * dy * v11;
+      dst[x * channels + c] = saturate(val);
+    }
+  }
+}
+
+const KernelTable TABLE = {applyLUT, histogram, histogram3, threshold, isBinary, warpAffineRow};
+} // namespace
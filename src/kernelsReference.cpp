@@ -0,0 +1,93 @@
+// The straightforward implementations the optimized kernels are checked against. They are kept
+// as simple as possible on purpose, don't optimize them.
+
+#include "kernels.hpp"
+
+namespace kernels {
+namespace {
+void applyLUT(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, const std::uint8_t *lut) {
+  for (std::size_t i = 0; i < n; ++i)
+    dst[i] = lut[src[i]];
+}
+
+void histogram(const std::uint8_t *src, std::size_t n, std::size_t rows, std::size_t step,
+               int *hist) {
+  for (std::size_t y = 0; y < rows; ++y)
+    for (std::size_t i = 0; i < n; ++i)
+      hist[src[y * step + i]]++;
+}
+
+void threshold(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, std::uint8_t threshold,
+               std::uint8_t maxValue) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (src[i] > threshold)
+      dst[i] = maxValue;
+    else
+      dst[i] = 0;
+  }
+}
+
+void histogram3(const std::uint8_t *src, std::size_t pixels, std::size_t rows, std::size_t step,
+                int *hist) {
+  for (std::size_t y = 0; y < rows; ++y)
+    for (std::size_t i = 0; i < pixels; ++i)
+      for (int c = 0; c < 3; ++c)
+        hist[c * 256 + src[y * step + i * 3 + c]]++;
+}
+
+bool isBinary(const std::uint8_t *src, std::size_t n) {
+  for (std::size_t i = 0; i < n; ++i)
+    if (src[i] != 0 && src[i] != 255)
+      return false;
+  return true;
+}
+
+std::uint8_t saturate(float value) {
+  long rounded = __builtin_lrintf(value);
+  if (rounded < 0)
+    return 0;
+  if (rounded > 255)
+    return 255;
+  return static_cast<std::uint8_t>(rounded);
+}
+
+void warpAffineRow(const WarpSource &src, const double *inverse, int y, std::uint8_t *dst,
+                   int cols) {
+  double a00 = inverse[0], a01 = inverse[1], b1 = inverse[2];
+  double a10 = inverse[3], a11 = inverse[4], b2 = inverse[5];
+  auto at = [&src](int y, int x, int c) { return src.data[y * src.step + x * src.channels + c]; };
+
+  for (int x = 0; x < cols; ++x) {
+    float srcX = a00 * x + a01 * y + b1;
+    float srcY = a10 * x + a11 * y + b2;
+
+    int x0 = static_cast<int>(__builtin_floorf(srcX));
+    int y0 = static_cast<int>(__builtin_floorf(srcY));
+
+    float dx = srcX - x0;
+    float dy = srcY - y0;
+
+    // if not on a bottom or left border
+    if (x0 >= 0 && x0 + 1 < src.cols && y0 >= 0 && y0 + 1 < src.rows) {
+      for (int c = 0; c < src.channels; ++c) {
+        // value of the current pixel is a bilinear interpolation of values of
+        // 4 neighboring pixels (with the current one being the top-left one)
+        float v00 = at(y0, x0, c);
+        float v01 = at(y0, x0 + 1, c);
+        float v10 = at(y0 + 1, x0, c);
+        float v11 = at(y0 + 1, x0 + 1, c);
+
+        float val =
+            (1 - dx) * (1 - dy) * v00 + dx * (1 - dy) * v01 + (1 - dx) * dy * v10 + dx * dy * v11;
+
+        dst[x * src.channels + c] = saturate(val);
+      }
+    }
+  }
+}
+
+const KernelTable TABLE = {applyLUT, histogram, histogram3, threshold, isBinary, warpAffineRow};
+} // namespace
+
+const KernelTable &reference() { return TABLE; }
+} // namespace kernels
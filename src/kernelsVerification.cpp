@@ -0,0 +1,111 @@
+// Kernels that run the optimized implementation and, on sampled calls, the reference one too,
+// reporting whenever their results differ.
+
+#include "kernels.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+namespace kernels {
+namespace {
+std::atomic<std::size_t> every = []() {
+  const char *value = std::getenv(VERIFY_VARIABLE);
+  return value == nullptr ? 0 : std::strtoul(value, nullptr, 10);
+}();
+std::atomic<std::size_t> calls = 0;
+std::atomic<std::size_t> checked = 0;
+std::atomic<std::size_t> mismatches = 0;
+
+const KernelTable &optimized() { return forLevel(cpuDispatch::active()); }
+
+bool sampled() {
+  std::size_t period = every.load(std::memory_order_relaxed);
+  return period > 0 && calls.fetch_add(1, std::memory_order_relaxed) % period == 0;
+}
+
+void check(const char *kernel, bool matches, std::size_t n) {
+  checked++;
+  if (matches)
+    return;
+  mismatches++;
+  std::cerr << "kernel mismatch: " << kernel << " (" << cpuDispatch::name(cpuDispatch::active())
+            << ") differs from the reference on " << n << " values" << std::endl;
+}
+
+void applyLUT(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, const std::uint8_t *lut) {
+  if (!sampled())
+    return optimized().applyLUT(src, dst, n, lut);
+  // computed first, the optimized kernel may overwrite `src`
+  std::vector<std::uint8_t> expected(n);
+  reference().applyLUT(src, expected.data(), n, lut);
+  optimized().applyLUT(src, dst, n, lut);
+  check("applyLUT", std::equal(expected.begin(), expected.end(), dst), n);
+}
+
+void histogram(const std::uint8_t *src, std::size_t n, std::size_t rows, std::size_t step,
+               int *hist) {
+  if (!sampled())
+    return optimized().histogram(src, n, rows, step, hist);
+  int expected[256] = {}, actual[256] = {};
+  reference().histogram(src, n, rows, step, expected);
+  optimized().histogram(src, n, rows, step, actual);
+  check("histogram", std::equal(expected, expected + 256, actual), n * rows);
+  for (int v = 0; v < 256; ++v)
+    hist[v] += actual[v];
+}
+
+void histogram3(const std::uint8_t *src, std::size_t pixels, std::size_t rows, std::size_t step,
+                int *hist) {
+  if (!sampled())
+    return optimized().histogram3(src, pixels, rows, step, hist);
+  int expected[3 * 256] = {}, actual[3 * 256] = {};
+  reference().histogram3(src, pixels, rows, step, expected);
+  optimized().histogram3(src, pixels, rows, step, actual);
+  check("histogram3", std::equal(expected, expected + 3 * 256, actual), pixels * rows * 3);
+  for (int v = 0; v < 3 * 256; ++v)
+    hist[v] += actual[v];
+}
+
+void threshold(const std::uint8_t *src, std::uint8_t *dst, std::size_t n, std::uint8_t threshold,
+               std::uint8_t maxValue) {
+  if (!sampled())
+    return optimized().threshold(src, dst, n, threshold, maxValue);
+  std::vector<std::uint8_t> expected(n);
+  reference().threshold(src, expected.data(), n, threshold, maxValue);
+  optimized().threshold(src, dst, n, threshold, maxValue);
+  check("threshold", std::equal(expected.begin(), expected.end(), dst), n);
+}
+
+bool isBinary(const std::uint8_t *src, std::size_t n) {
+  if (!sampled())
+    return optimized().isBinary(src, n);
+  bool expected = reference().isBinary(src, n);
+  bool actual = optimized().isBinary(src, n);
+  check("isBinary", expected == actual, n);
+  return actual;
+}
+
+void warpAffineRow(const WarpSource &src, const double *inverse, int y, std::uint8_t *dst,
+                   int cols) {
+  if (!sampled())
+    return optimized().warpAffineRow(src, inverse, y, dst, cols);
+  // pixels mapped outside of the source keep what was there before
+  std::size_t n = static_cast<std::size_t>(cols) * src.channels;
+  std::vector<std::uint8_t> expected(dst, dst + n);
+  reference().warpAffineRow(src, inverse, y, expected.data(), cols);
+  optimized().warpAffineRow(src, inverse, y, dst, cols);
+  check("warpAffineRow", std::equal(expected.begin(), expected.end(), dst), n);
+}
+
+const KernelTable TABLE = {applyLUT, histogram, histogram3, threshold, isBinary, warpAffineRow};
+} // namespace
+
+bool isVerifying() { return every.load(std::memory_order_relaxed) > 0; }
+
+const KernelTable &verifying() { return TABLE; }
+
+void setVerification(std::size_t period) { every = period; }
+
+VerificationStats getVerificationStats() { return {checked.load(), mismatches.load()}; }
+} // namespace kernels
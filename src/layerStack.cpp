@@ -0,0 +1,274 @@
+#include "layerStack.hpp"
+#include "autoThreshold.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+bool isHistogramOperation(const QString &operation) {
+  return operation == "normalize" || operation == "equalize" || operation == "thresholdAuto" ||
+         operation == "thresholdMultiOtsu";
+}
+
+// LUTs of every channel doing what `step` does to an image with the histograms `input`
+std::vector<imageProcessor::LUT> histogramStepLUTs(const PipelineStep &step,
+                                                   const ImageStats::Histograms &input) {
+  std::vector<imageProcessor::LUT> luts;
+  const QString &operation = step.operation;
+  if (operation == "normalize" || operation == "equalize") {
+    for (const std::vector<int> &hist : input)
+      luts.push_back(operation == "normalize" ? imageProcessor::normalizeLUT(hist)
+                                              : imageProcessor::equalizeLUT(hist));
+    return luts;
+  }
+
+  if (step.params.size() != 1)
+    throw std::invalid_argument("Invalid number of operation parameters");
+  if (operation == "thresholdAuto") {
+    // like the pipeline, thresholding is left out unless it gives a binary image
+    if (input.size() != 1)
+      return luts;
+    auto method = ParamCodec::decode<autoThreshold::Method>(step.params[0]);
+    luts.push_back(autoThreshold::levelsLUT({autoThreshold::threshold(input[0], method)}));
+    return luts;
+  }
+  int classes = ParamCodec::decode<int>(step.params[0]);
+  for (const std::vector<int> &hist : input)
+    luts.push_back(autoThreshold::levelsLUT(autoThreshold::multiOtsu(hist, classes)));
+  return luts;
+}
+
+cv::Rect grow(const cv::Rect &rect, int dx, int dy) {
+  return {rect.x - dx, rect.y - dy, rect.width + 2 * dx, rect.height + 2 * dy};
+}
+} // namespace
+
+LayerStack::LayerStack(ImageWrapper base) : base(std::move(base)) {}
+
+void LayerStack::setBase(ImageWrapper base) {
+  this->base = std::move(base);
+  scaledFor = 0;
+  scaledBase.release();
+  histogramLayers.clear();
+  sampledHistograms = false;
+  invalidateFrom(0);
+  materialized.reset();
+}
+
+void LayerStack::push(PipelineStep step) {
+  layers.push_back({std::move(step), true});
+  materialized.reset();
+}
+
+std::optional<AdjustmentLayer> LayerStack::pop() {
+  if (layers.empty())
+    return std::nullopt;
+  AdjustmentLayer layer = std::move(layers.back());
+  layers.pop_back();
+  histogramLayers.resize(std::min(histogramLayers.size(), layers.size()));
+  invalidateFrom(layers.size());
+  materialized.reset();
+  return layer;
+}
+
+void LayerStack::remove(std::size_t index) {
+  layers.erase(layers.begin() + index);
+  histogramLayers.resize(std::min(histogramLayers.size(), index));
+  invalidateFrom(index);
+  materialized.reset();
+}
+
+void LayerStack::setParams(std::size_t index, QJsonArray params) {
+  layers.at(index).step.params = std::move(params);
+  histogramLayers.resize(std::min(histogramLayers.size(), index));
+  invalidateFrom(index);
+  materialized.reset();
+}
+
+void LayerStack::setEnabled(std::size_t index, bool enabled) {
+  layers.at(index).enabled = enabled;
+  histogramLayers.resize(std::min(histogramLayers.size(), index));
+  invalidateFrom(index);
+  materialized.reset();
+}
+
+void LayerStack::clear() {
+  layers.clear();
+  histogramLayers.clear();
+  sampledHistograms = false;
+  invalidateFrom(0);
+  materialized.reset();
+}
+
+ImageWrapper LayerStack::materialize() const {
+  if (!materialized.has_value())
+    materialized = toPipeline().apply(base);
+  return materialized.value();
+}
+
+void LayerStack::invalidateFrom(std::size_t index) {
+  if (results.size() > index)
+    results.erase(results.begin() + index, results.end());
+}
+
+std::size_t LayerStack::histogramLayerCount() const {
+  int type = base.getMat().type();
+  if (type != CV_8UC1 && type != CV_8UC3)
+    return 0;
+  std::size_t count = 0;
+  while (count < layers.size() &&
+         (!layers[count].enabled || isHistogramOperation(layers[count].step.operation)))
+    ++count;
+  return count;
+}
+
+const std::vector<imageProcessor::LUT> &LayerStack::histogramLUTs(std::size_t index) {
+  while (histogramLayers.size() <= index) {
+    HistogramLayer layer;
+    layer.input = histogramLayers.empty() ? baseHistograms()
+                                          : histogramOutput(histogramLayers.back());
+
+    const AdjustmentLayer &adjustment = layers[histogramLayers.size()];
+    if (adjustment.enabled)
+      layer.luts = histogramStepLUTs(adjustment.step, layer.input);
+    histogramLayers.push_back(std::move(layer));
+  }
+  return histogramLayers[index].luts;
+}
+
+ImageStats::Histograms LayerStack::baseHistograms() {
+  auto known = base.getStats()->cachedHistograms();
+  if (known.has_value())
+    return known.value();
+  sampledHistograms = true;
+  return imageProcessor::sampleHistograms(base.getMat()).hists;
+}
+
+void LayerStack::refineHistogramLayers() {
+  if (!sampledHistograms || !base.getStats()->cachedHistograms().has_value())
+    return;
+  sampledHistograms = false;
+  if (histogramLayers.empty())
+    return;
+  histogramLayers.clear();
+  invalidateFrom(0);
+}
+
+ImageStats::Histograms LayerStack::histogramOutput(const HistogramLayer &layer) {
+  // what the layer makes of its input
+  ImageStats::Histograms output = layer.input;
+  for (std::size_t c = 0; c < layer.luts.size(); ++c)
+    output[c] = imageProcessor::applyLUTToHistogram(layer.input[c], layer.luts[c]);
+  return output;
+}
+
+ImageStats::Histograms LayerStack::topHistograms() {
+  if (base.getMat().empty())
+    return {};
+  refineHistogramLayers();
+  if (histogramLayerCount() < layers.size())
+    return materialize().histograms();
+  if (layers.empty())
+    return baseHistograms();
+  histogramLUTs(layers.size() - 1);
+  return histogramOutput(histogramLayers[layers.size() - 1]);
+}
+
+std::optional<int> LayerStack::getMargin() const {
+  const int channels = base.getMat().channels();
+  int margin = 0;
+  // the bottom layers using the histograms of the whole image act like point operations
+  for (std::size_t i = histogramLayerCount(); i < layers.size(); ++i) {
+    const AdjustmentLayer &layer = layers[i];
+    if (!layer.enabled)
+      continue;
+    auto halo = Pipeline::getHalo(layer.step, channels);
+    if (!halo.has_value())
+      return std::nullopt;
+    margin += halo.value();
+  }
+  return margin;
+}
+
+Pipeline LayerStack::toPipeline() const {
+  Pipeline pipeline;
+  for (const AdjustmentLayer &layer : layers)
+    if (layer.enabled)
+      pipeline.append(layer.step);
+  return pipeline;
+}
+
+LayerStack::View LayerStack::render(const cv::Rect2d &area, double scale) {
+  const cv::Mat &baseMat = base.getMat();
+  if (baseMat.empty())
+    return {};
+
+  refineHistogramLayers();
+  scale = std::clamp(scale, 1e-3, 1.0);
+  if (scale != scaledFor) {
+    if (scale == 1.0) {
+      scaledBase = baseMat;
+    } else {
+      // averaging keeps the preview close to the full resolution result,
+      // but it would make up values in binary images and hues
+      PixelFormat format = base.getFormat();
+      int interpolation = format == PixelFormat::BGR24 || format == PixelFormat::Grayscale8
+                              ? cv::INTER_AREA
+                              : cv::INTER_NEAREST;
+      cv::Size size(std::max(1, cvRound(baseMat.cols * scale)),
+                    std::max(1, cvRound(baseMat.rows * scale)));
+      cv::resize(baseMat, scaledBase, size, 0, 0, interpolation);
+    }
+    scaledFor = scale;
+    region = {};
+    invalidateFrom(0);
+  }
+
+  const double sx = static_cast<double>(scaledBase.cols) / baseMat.cols;
+  const double sy = static_cast<double>(scaledBase.rows) / baseMat.rows;
+  const cv::Rect bounds(0, 0, scaledBase.cols, scaledBase.rows);
+  cv::Rect wanted = cv::Rect(cv::Point(cvFloor(area.x * sx), cvFloor(area.y * sy)),
+                             cv::Point(cvCeil(area.br().x * sx), cvCeil(area.br().y * sy))) &
+                    bounds;
+  if (wanted.empty())
+    return {};
+
+  // local operations only need the visible part with a margin, while the others need everything
+  auto margin = getMargin();
+  cv::Rect needed = margin.has_value() ? grow(wanted, margin.value(), margin.value()) & bounds
+                                       : bounds;
+  if ((needed & region) != needed) {
+    // some extra space around the visible area lets small pans reuse the results
+    region = grow(needed, wanted.width / 4, wanted.height / 4) & bounds;
+    invalidateFrom(0);
+  }
+
+  const ImageWrapper baseView(scaledBase(region), base.getFormat());
+  const std::size_t fromHistograms = histogramLayerCount();
+  for (std::size_t i = results.size(); i < layers.size(); ++i) {
+    const ImageWrapper &input = i == 0 ? baseView : results[i - 1];
+    if (!layers[i].enabled) {
+      results.push_back(input);
+      continue;
+    }
+    if (i < fromHistograms) {
+      const std::vector<imageProcessor::LUT> &luts = histogramLUTs(i);
+      if (luts.empty()) {
+        results.push_back(input);
+        continue;
+      }
+      ImageWrapper result = imageProcessor::applyChannelLUTs(input, luts);
+      if (layers[i].step.operation == "thresholdAuto")
+        result = result.toBinary().value_or(result);
+      results.push_back(std::move(result));
+      continue;
+    }
+    Pipeline layer;
+    layer.append(layers[i].step);
+    results.push_back(layer.apply(input));
+  }
+
+  const ImageWrapper &top = results.empty() ? baseView : results.back();
+  cv::Rect crop = (wanted - region.tl()) & cv::Rect(0, 0, top.getWidth(), top.getHeight());
+  return {ImageWrapper(top.getMat()(crop).clone(), top.getFormat()),
+          cv::Rect2d(wanted.x / sx, wanted.y / sy, wanted.width / sx, wanted.height / sy)};
+}
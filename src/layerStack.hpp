@@ -0,0 +1,94 @@
+#pragma once
+
+#include "imageProcessor.hpp"
+#include "imageWrapper.hpp"
+#include "pipeline.hpp"
+#include <optional>
+#include <vector>
+
+// operation stacked on top of an image without modifying it
+struct AdjustmentLayer {
+  PipelineStep step;
+  bool enabled = true;
+};
+
+// Image with a stack of adjustment layers that are only evaluated for the part of the image
+// that is being displayed, at the resolution it is displayed at. The full resolution result is
+// computed only when it's actually needed (e.g. saving).
+class LayerStack {
+public:
+  LayerStack() = default;
+  explicit LayerStack(ImageWrapper base);
+
+  // replaces the image below the layers, the layers themselves are kept
+  void setBase(ImageWrapper base);
+  const ImageWrapper &getBase() const { return base; }
+
+  const std::vector<AdjustmentLayer> &getLayers() const { return layers; }
+  bool isEmpty() const { return layers.empty(); }
+  void push(PipelineStep step);
+  std::optional<AdjustmentLayer> pop();
+  void remove(std::size_t index);
+  void setParams(std::size_t index, QJsonArray params);
+  void setEnabled(std::size_t index, bool enabled);
+  void clear();
+
+  struct View {
+    ImageWrapper image;
+    // part of the full resolution image covered by `image`
+    cv::Rect2d area;
+  };
+  // evaluates the layers for `area` of the full resolution image scaled by `scale`, scales above 1
+  // are rendered at 1. Intermediate results of every layer are kept, so changing one layer only
+  // evaluates that layer and the ones above it again.
+  // throws std::invalid_argument if any layer has invalid parameters
+  View render(const cv::Rect2d &area, double scale);
+
+  // enabled layers as a pipeline that can be applied to the base image
+  Pipeline toPipeline() const;
+  // full resolution result of all enabled layers, kept until the layers or the base change
+  ImageWrapper materialize() const;
+  // histograms of the full resolution result, the same ones a layer using them pushed on top
+  // would get, so sampled while only such layers are in the stack and the base's aren't known
+  ImageStats::Histograms topHistograms();
+
+private:
+  // margin around the rendered area that the layers need, nullopt if they need the whole image
+  std::optional<int> getMargin() const;
+  // drops results of the layers starting from `index`
+  void invalidateFrom(std::size_t index);
+  // number of layers at the bottom of the stack that are disabled or only map values through
+  // LUTs made from the histograms of the whole image (normalize, equalize, auto thresholds)
+  std::size_t histogramLayerCount() const;
+  // LUTs of every channel of such a layer, empty if it leaves the image as it is
+  const std::vector<imageProcessor::LUT> &histogramLUTs(std::size_t index);
+
+  ImageWrapper base;
+  std::vector<AdjustmentLayer> layers;
+
+  // the base image at the last rendered scale
+  double scaledFor = 0;
+  cv::Mat scaledBase;
+  // part of `scaledBase` the layers were evaluated for and the result after each of them
+  cv::Rect region;
+  std::vector<ImageWrapper> results;
+
+  // the LUTs come from the full resolution base's histograms, sampled if they aren't known yet,
+  // so those layers are evaluated for the rendered region only and at any scale. They're made
+  // again once the exact histograms get known.
+  struct HistogramLayer {
+    // histograms of the image the layer is applied to
+    ImageStats::Histograms input;
+    std::vector<imageProcessor::LUT> luts;
+  };
+  std::vector<HistogramLayer> histogramLayers;
+  // whether `histogramLayers` were made from a sample of the base's pixels
+  bool sampledHistograms = false;
+  // known histograms of the base or ones of a sample of its pixels
+  ImageStats::Histograms baseHistograms();
+  // drops the layers made from a sample once the exact histograms are known
+  void refineHistogramLayers();
+  static ImageStats::Histograms histogramOutput(const HistogramLayer &layer);
+
+  mutable std::optional<ImageWrapper> materialized;
+};
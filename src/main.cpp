@@ -1,9 +1,29 @@
 #include "UI/mainwindow.hpp"
+#include "allocations.hpp"
+#include "batch.hpp"
+#include "interactionLatency.hpp"
+#include "trace.hpp"
 #include <QApplication>
+#include <QCoreApplication>
 
 int main(int argc, char *argv[]) {
+    // the counts are written into the traces
+    allocations::install();
+
+    // batch mode doesn't need a display
+    if (batch::isRequested(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        int result = batch::runFromArguments(app.arguments());
+        trace::writeToEnvironmentPath();
+        return result;
+    }
+
     QApplication app(argc, argv);
+    trace::setThreadName("UI");
     MainWindow window;
     window.show();
-    return app.exec();
+    int result = app.exec();
+    trace::writeToEnvironmentPath();
+    interactionLatency::writeToEnvironmentPath();
+    return result;
 }
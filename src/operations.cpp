@@ -0,0 +1,193 @@
+#include "operations.hpp"
+#include "autoThreshold.hpp"
+#include "imageProcessor.hpp"
+#include "kernels.hpp"
+#include "trace.hpp"
+#include <cmath>
+#include <vector>
+
+namespace {
+// histograms of the channels of an 8-bit image with any number of them
+std::vector<std::vector<int>> histogramsOf(const cv::Mat &mat) {
+  std::vector<std::vector<int>> hists = imageProcessor::channelHistograms(mat);
+  if (!hists.empty() || mat.depth() != CV_8U)
+    return hists;
+  std::vector<cv::Mat> planes;
+  cv::split(mat, planes);
+  for (const cv::Mat &plane : planes)
+    hists.push_back(imageProcessor::histogram(plane));
+  return hists;
+}
+} // namespace
+
+namespace operations {
+cv::Mat normalize(const cv::Mat &mat) { return imageProcessor::normalizeChannels(mat); }
+
+cv::Mat equalize(const cv::Mat &mat) { return imageProcessor::equalizeChannels(mat); }
+
+cv::Mat rangeStretch(const cv::Mat &mat, int p1, int p2, int q3, int q4) {
+  TRACE_SCOPE("operations::rangeStretch");
+  return imageProcessor::rangeStretchChannels(mat, p1, p2, q3, q4);
+}
+
+cv::Mat posterize(const cv::Mat &mat, int n) {
+  TRACE_SCOPE("operations::posterize");
+  return imageProcessor::applyLUTcv(mat, imageProcessor::posterize(n));
+}
+
+cv::Mat blurMean(const cv::Mat &mat, int k, int borderType) {
+  TRACE_SCOPE("operations::blurMean");
+  cv::Mat out;
+  cv::blur(mat, out, cv::Size(k, k), cv::Point(-1, -1), borderType);
+  return out;
+}
+
+cv::Mat blurMedian(const cv::Mat &mat, int k) {
+  TRACE_SCOPE("operations::blurMedian");
+  cv::Mat out;
+  cv::medianBlur(mat, out, k);
+  return out;
+}
+
+cv::Mat blurGaussian(const cv::Mat &mat, int k, int borderType, double sigma) {
+  TRACE_SCOPE("operations::blurGaussian");
+  cv::Mat out;
+  cv::GaussianBlur(mat, out, cv::Size(k, k), sigma, 0, borderType);
+  return out;
+}
+
+cv::Mat edgeDetectSobel(const cv::Mat &mat, int k, int borderType, SobelDirection direction) {
+  TRACE_SCOPE("operations::edgeDetectSobel");
+  cv::Mat out;
+  if (direction == SobelDirection::Horizontal)
+    cv::Sobel(mat, out, CV_8UC1, 0, 1, k, 1, 0, borderType);
+  else
+    cv::Sobel(mat, out, CV_8UC1, 1, 0, k, 1, 0, borderType);
+  return out;
+}
+
+cv::Mat edgeDetectLaplacian(const cv::Mat &mat, int k, int borderType) {
+  TRACE_SCOPE("operations::edgeDetectLaplacian");
+  cv::Mat out;
+  cv::Laplacian(mat, out, CV_8UC1, k, 1, 0, borderType);
+  return out;
+}
+
+cv::Mat edgeDetectCanny(const cv::Mat &mat, int k, int borderType, int start, int end) {
+  TRACE_SCOPE("operations::edgeDetectCanny");
+  // manually padding
+  int pad = k / 2;
+  cv::Mat padded;
+  cv::copyMakeBorder(mat, padded, pad, pad, pad, pad, borderType);
+
+  cv::Mat out;
+  cv::Canny(padded, out, start, end, k);
+  return out;
+}
+
+cv::Mat convolve(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::convolve");
+  return imageProcessor::convolve(mat, kernel, borderType);
+}
+
+cv::Mat morphologyErode(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::morphologyErode");
+  cv::Mat out;
+  cv::erode(mat, out, kernel, cv::Point(-1, -1), 1, borderType);
+  return out;
+}
+
+cv::Mat morphologyDilate(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::morphologyDilate");
+  cv::Mat out;
+  cv::dilate(mat, out, kernel, cv::Point(-1, -1), 1, borderType);
+  return out;
+}
+
+cv::Mat morphologyOpen(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::morphologyOpen");
+  cv::Mat out;
+  cv::morphologyEx(mat, out, cv::MORPH_OPEN, kernel, cv::Point(-1, -1), 1, borderType);
+  return out;
+}
+
+cv::Mat morphologyClose(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::morphologyClose");
+  cv::Mat out;
+  cv::morphologyEx(mat, out, cv::MORPH_CLOSE, kernel, cv::Point(-1, -1), 1, borderType);
+  return out;
+}
+
+cv::Mat morphologySkeletonize(const cv::Mat &mat, const cv::Mat &kernel, int borderType) {
+  TRACE_SCOPE("operations::morphologySkeletonize");
+  return imageProcessor::skeletonize(mat, kernel, borderType);
+}
+
+cv::Mat houghTransform(const cv::Mat &mat, int rho, int thetaDeg, int threshold) {
+  TRACE_SCOPE("operations::houghTransform");
+  const double theta = CV_PI * thetaDeg / 180.0;
+  std::vector<cv::Vec4i> lines;
+
+  std::vector<cv::Vec2f> linesPolar;
+  cv::HoughLines(mat, linesPolar, rho, theta, threshold);
+
+  // Convert to endpoints (approx)
+  for (const auto &l : linesPolar) {
+    float r = l[0], t = l[1];
+    double a = std::cos(t), b = std::sin(t);
+    double x0 = a * r, y0 = b * r;
+    int x1 = cvRound(x0 + 1000 * (-b));
+    int y1 = cvRound(y0 + 1000 * (a));
+    int x2 = cvRound(x0 - 1000 * (-b));
+    int y2 = cvRound(y0 - 1000 * (a));
+    lines.push_back(cv::Vec4i(x1, y1, x2, y2));
+  }
+
+  cv::Mat out;
+  cv::cvtColor(mat, out, cv::COLOR_GRAY2BGR);
+  for (const auto &l : lines)
+    cv::line(out, {l[0], l[1]}, {l[2], l[3]}, cv::Scalar(255, 0, 0), 2);
+  return out;
+}
+
+cv::Mat thresholdManual(const cv::Mat &mat, int threshold) {
+  TRACE_SCOPE("operations::thresholdManual");
+  cv::Mat out;
+  // thresholds outside of the 8-bit range give a constant image, which cv::threshold handles
+  if (mat.depth() != CV_8U || threshold < 0 || threshold >= 255) {
+    cv::threshold(mat, out, threshold, 255, cv::ThresholdTypes::THRESH_BINARY);
+    return out;
+  }
+  out.create(mat.size(), mat.type());
+  const kernels::KernelTable &k = kernels::get();
+  std::size_t rowLength = static_cast<std::size_t>(mat.cols) * mat.channels();
+  for (int y = 0; y < mat.rows; ++y)
+    k.threshold(mat.ptr<uchar>(y), out.ptr<uchar>(y), rowLength, threshold, 255);
+  return out;
+}
+
+cv::Mat thresholdAdaptive(const cv::Mat &mat, cv::AdaptiveThresholdTypes type, int blockSize,
+                          int c) {
+  return imageProcessor::applyToChannels(mat, [type, blockSize, c](cv::Mat channel) {
+    cv::Mat out;
+    cv::adaptiveThreshold(channel, out, 255, type, cv::ThresholdTypes::THRESH_BINARY, blockSize,
+                          c);
+    return out;
+  });
+}
+
+cv::Mat thresholdOtsu(const cv::Mat &mat) {
+  TRACE_SCOPE("operations::thresholdOtsu");
+  return thresholdAuto(mat, autoThreshold::Method::Otsu);
+}
+
+cv::Mat thresholdAuto(const cv::Mat &mat, autoThreshold::Method method) {
+  TRACE_SCOPE("operations::thresholdAuto");
+  return autoThreshold::thresholdChannels(mat, histogramsOf(mat), method);
+}
+
+cv::Mat thresholdMultiOtsu(const cv::Mat &mat, int classes) {
+  TRACE_SCOPE("operations::thresholdMultiOtsu");
+  return autoThreshold::multiOtsuChannels(mat, histogramsOf(mat), classes);
+}
+} // namespace operations
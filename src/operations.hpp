@@ -0,0 +1,41 @@
+#pragma once
+
+#include "autoThreshold.hpp"
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+// Operations available in the menus, each being a pure function of an image and the parameters
+// chosen by the user in a dialog. Keeping them apart from the UI allows for recording
+// and replaying them on other images.
+namespace operations {
+enum class SobelDirection {
+  Horizontal,
+  Vertical,
+};
+
+cv::Mat normalize(const cv::Mat &mat);
+cv::Mat equalize(const cv::Mat &mat);
+cv::Mat rangeStretch(const cv::Mat &mat, int p1, int p2, int q3, int q4);
+cv::Mat posterize(const cv::Mat &mat, int n);
+cv::Mat blurMean(const cv::Mat &mat, int k, int borderType);
+cv::Mat blurMedian(const cv::Mat &mat, int k);
+cv::Mat blurGaussian(const cv::Mat &mat, int k, int borderType, double sigma);
+cv::Mat edgeDetectSobel(const cv::Mat &mat, int k, int borderType, SobelDirection direction);
+cv::Mat edgeDetectLaplacian(const cv::Mat &mat, int k, int borderType);
+cv::Mat edgeDetectCanny(const cv::Mat &mat, int k, int borderType, int start, int end);
+cv::Mat convolve(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat morphologyErode(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat morphologyDilate(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat morphologyOpen(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat morphologyClose(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat morphologySkeletonize(const cv::Mat &mat, const cv::Mat &kernel, int borderType);
+cv::Mat houghTransform(const cv::Mat &mat, int rho, int thetaDeg, int threshold);
+cv::Mat thresholdManual(const cv::Mat &mat, int threshold);
+cv::Mat thresholdAdaptive(const cv::Mat &mat, cv::AdaptiveThresholdTypes type, int blockSize,
+                          int c);
+cv::Mat thresholdOtsu(const cv::Mat &mat);
+// thresholds every channel at the value `method` picks from its histogram
+cv::Mat thresholdAuto(const cv::Mat &mat, autoThreshold::Method method);
+// splits every channel into `classes` evenly spaced levels
+cv::Mat thresholdMultiOtsu(const cv::Mat &mat, int classes);
+} // namespace operations
@@ -0,0 +1,124 @@
+#include "perfCounters.hpp"
+#include <cstdlib>
+
+#ifdef __linux__
+#include <array>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perfCounters {
+namespace {
+std::optional<std::uint64_t> subtract(std::optional<std::uint64_t> start,
+                                      std::optional<std::uint64_t> end) {
+  if (!start.has_value() || !end.has_value() || end.value() < start.value())
+    return std::nullopt;
+  return end.value() - start.value();
+}
+
+#ifdef __linux__
+const int COUNTERS = 4;
+const std::array<std::uint64_t, COUNTERS> EVENTS{
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+// counters of one thread, read all at once as a group
+class ThreadCounters {
+public:
+  ThreadCounters() {
+    for (int i = 0; i < COUNTERS; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = EVENTS[i];
+      // user space only, that's what an unprivileged process is allowed to count
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      int fd = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, leader, PERF_FLAG_FD_CLOEXEC));
+      if (fd < 0)
+        continue;
+      if (leader < 0)
+        leader = fd;
+      fds[i] = fd;
+      positions[i] = opened++;
+    }
+  }
+
+  ~ThreadCounters() {
+    for (int fd : fds)
+      if (fd >= 0)
+        close(fd);
+  }
+
+  Sample read() const {
+    Sample sample;
+    if (leader < 0)
+      return sample;
+
+    // number of counters, time enabled, time running and the values
+    std::array<std::uint64_t, 3 + COUNTERS> data{};
+    if (::read(leader, data.data(), sizeof(data)) < static_cast<ssize_t>(3 * sizeof(std::uint64_t)))
+      return sample;
+    // counters share the hardware with other processes, scale them if they weren't always on
+    double scale = data[2] > 0 && data[2] < data[1] ? static_cast<double>(data[1]) / data[2] : 1;
+    auto value = [&](int i) -> std::optional<std::uint64_t> {
+      if (fds[i] < 0 || data[2] == 0)
+        return std::nullopt;
+      return static_cast<std::uint64_t>(data[3 + positions[i]] * scale);
+    };
+    sample.cycles = value(0);
+    sample.instructions = value(1);
+    sample.cacheMisses = value(2);
+    sample.branchMisses = value(3);
+    return sample;
+  }
+
+private:
+  int leader = -1;
+  int opened = 0;
+  std::array<int, COUNTERS> fds{-1, -1, -1, -1};
+  // position of every counter in the group
+  std::array<int, COUNTERS> positions{};
+};
+#endif
+} // namespace
+
+std::optional<double> Sample::ipc() const {
+  if (!cycles.has_value() || !instructions.has_value() || cycles.value() == 0)
+    return std::nullopt;
+  return static_cast<double>(instructions.value()) / cycles.value();
+}
+
+std::optional<double> Sample::memoryBytesPerPixel(std::uint64_t pixels) const {
+  if (!cacheMisses.has_value() || pixels == 0)
+    return std::nullopt;
+  return 64.0 * cacheMisses.value() / pixels;
+}
+
+bool isEnabled() {
+  static const bool enabled = []() {
+    const char *value = std::getenv(ENABLE_VARIABLE);
+    return value != nullptr && *value != '\0';
+  }();
+  return enabled;
+}
+
+Sample read() {
+#ifdef __linux__
+  thread_local const ThreadCounters counters;
+  return counters.read();
+#else
+  return {};
+#endif
+}
+
+Sample difference(const Sample &start, const Sample &end) {
+  return {subtract(start.cycles, end.cycles), subtract(start.instructions, end.instructions),
+          subtract(start.cacheMisses, end.cacheMisses),
+          subtract(start.branchMisses, end.branchMisses)};
+}
+} // namespace perfCounters
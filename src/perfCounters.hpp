@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+// Hardware performance counters of the calling thread, read with perf_event_open on Linux.
+//
+// Any of the counters may be unavailable (other systems, virtual machines without a PMU or
+// /proc/sys/kernel/perf_event_paranoid set too high), in which case it's just missing from the
+// samples. Only the thread reading the counters is measured, work that OpenCV runs on its own
+// threads isn't included.
+namespace perfCounters {
+// environment variable enabling the counters in traces
+const char *const ENABLE_VARIABLE = "APO_PERF_COUNTERS";
+
+struct Sample {
+  std::optional<std::uint64_t> cycles;
+  std::optional<std::uint64_t> instructions;
+  // misses of the last level cache, each one is a cache line read from the memory
+  std::optional<std::uint64_t> cacheMisses;
+  std::optional<std::uint64_t> branchMisses;
+
+  bool isEmpty() const { return !cycles && !instructions && !cacheMisses && !branchMisses; }
+  // instructions per cycle
+  std::optional<double> ipc() const;
+  // bytes loaded from the memory per pixel, assuming 64 byte cache lines
+  std::optional<double> memoryBytesPerPixel(std::uint64_t pixels) const;
+};
+
+// whether APO_PERF_COUNTERS is set to a non-empty value
+bool isEnabled();
+// current values for the calling thread, its counters are opened on the first call
+Sample read();
+// counts between two readings of the same thread, counters missing from either are missing
+Sample difference(const Sample &start, const Sample &end);
+} // namespace perfCounters
@@ -0,0 +1,317 @@
+#include "pipeline.hpp"
+#include "imageProcessor.hpp"
+#include "operations.hpp"
+#include "tileExecutor.hpp"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <utility>
+
+namespace ParamCodec {
+QJsonValue encode(const cv::Mat &mat) {
+  CV_Assert(mat.channels() == 1);
+  cv::Mat values;
+  mat.convertTo(values, CV_64F);
+
+  QJsonArray data;
+  for (int y = 0; y < values.rows; ++y) {
+    const double *rowPtr = values.ptr<double>(y);
+    for (int x = 0; x < values.cols; ++x)
+      data.append(rowPtr[x]);
+  }
+
+  QJsonObject object;
+  object["rows"] = mat.rows;
+  object["cols"] = mat.cols;
+  object["type"] = mat.type();
+  object["data"] = data;
+  return object;
+}
+
+cv::Mat decodeMat(const QJsonValue &value) {
+  QJsonObject object = value.toObject();
+  int rows = object.value("rows").toInt(-1);
+  int cols = object.value("cols").toInt(-1);
+  int type = object.value("type").toInt(-1);
+  QJsonArray data = object.value("data").toArray();
+  // single channel types are the depths alone, from CV_8U to CV_64F
+  if (rows <= 0 || cols <= 0 || type < CV_8U || type > CV_64F ||
+      data.size() != static_cast<qsizetype>(rows) * cols)
+    throw std::invalid_argument("Malformed mask in operation parameters");
+
+  cv::Mat values(rows, cols, CV_64F);
+  for (int y = 0; y < rows; ++y) {
+    double *rowPtr = values.ptr<double>(y);
+    for (int x = 0; x < cols; ++x) {
+      QJsonValue element = data[static_cast<qsizetype>(y) * cols + x];
+      if (!element.isDouble())
+        throw std::invalid_argument("Malformed mask in operation parameters");
+      rowPtr[x] = element.toDouble();
+    }
+  }
+
+  cv::Mat mat;
+  values.convertTo(mat, type);
+  return mat;
+}
+} // namespace ParamCodec
+
+namespace {
+using Operation =
+    std::function<std::optional<ImageWrapper>(const ImageWrapper &, const QJsonArray &)>;
+
+std::optional<ImageWrapper> toResult(cv::Mat mat) { return ImageWrapper(mat); }
+std::optional<ImageWrapper> toResult(ImageWrapper image) { return image; }
+std::optional<ImageWrapper> toResult(std::optional<ImageWrapper> image) { return image; }
+
+template <typename... Args, std::size_t... Is>
+std::tuple<Args...> decodeParams(const QJsonArray &params, std::index_sequence<Is...>) {
+  return std::tuple<Args...>{ParamCodec::decode<Args>(params[Is])...};
+}
+
+template <typename... Args> std::tuple<std::decay_t<Args>...> decodeArgs(const QJsonArray &params) {
+  if (params.size() != static_cast<qsizetype>(sizeof...(Args)))
+    throw std::invalid_argument("Invalid number of operation parameters");
+  return decodeParams<std::decay_t<Args>...>(params, std::index_sequence_for<Args...>{});
+}
+
+// creates an operation out of a function taking an image and its parameters
+template <typename R, typename... Args> Operation wrap(R (*fn)(const cv::Mat &, Args...)) {
+  return [fn](const ImageWrapper &image, const QJsonArray &params) -> std::optional<ImageWrapper> {
+    auto args = decodeArgs<Args...>(params);
+    return toResult(std::apply(
+        [&image, fn](const auto &...arg) { return fn(image.getMat(), arg...); }, args));
+  };
+}
+
+// thresholding in the UI is only applied if it yields a binary image
+Operation binary(Operation op) {
+  return [op](const ImageWrapper &image, const QJsonArray &params) -> std::optional<ImageWrapper> {
+    auto result = op(image, params);
+    if (!result.has_value())
+      return std::nullopt;
+    return result->toBinary();
+  };
+}
+
+Operation unary(std::function<ImageWrapper(const ImageWrapper &)> fn) {
+  return [fn](const ImageWrapper &image, const QJsonArray &) -> std::optional<ImageWrapper> {
+    return fn(image);
+  };
+}
+
+const std::map<QString, Operation> &getRegistry() {
+  static const std::map<QString, Operation> registry{
+      {"toRGB", unary([](const ImageWrapper &image) { return image.toRGB(); })},
+      {"toHSV", unary([](const ImageWrapper &image) { return image.toHSV(); })},
+      {"toLab", unary([](const ImageWrapper &image) { return image.toLab(); })},
+      {"toGrayscale", unary([](const ImageWrapper &image) { return image.toGrayscale(); })},
+      {"negate", unary([](const ImageWrapper &image) {
+         return imageProcessor::applyLUT(image, imageProcessor::negate());
+       })},
+      {"normalize", wrap(operations::normalize)},
+      {"equalize", wrap(operations::equalize)},
+      {"rangeStretch", wrap(operations::rangeStretch)},
+      {"posterize", wrap(operations::posterize)},
+      {"blurMean", wrap(operations::blurMean)},
+      {"blurMedian", wrap(operations::blurMedian)},
+      {"blurGaussian", wrap(operations::blurGaussian)},
+      {"edgeDetectSobel", wrap(operations::edgeDetectSobel)},
+      {"edgeDetectLaplacian", wrap(operations::edgeDetectLaplacian)},
+      {"edgeDetectCanny", wrap(operations::edgeDetectCanny)},
+      {"convolve", wrap(operations::convolve)},
+      {"morphologyErode", wrap(operations::morphologyErode)},
+      {"morphologyDilate", wrap(operations::morphologyDilate)},
+      {"morphologyOpen", wrap(operations::morphologyOpen)},
+      {"morphologyClose", wrap(operations::morphologyClose)},
+      {"morphologySkeletonize", wrap(operations::morphologySkeletonize)},
+      {"houghTransform", wrap(operations::houghTransform)},
+      {"thresholdManual", binary(wrap(operations::thresholdManual))},
+      {"thresholdAdaptive", binary(wrap(operations::thresholdAdaptive))},
+      {"thresholdOtsu", binary(wrap(operations::thresholdOtsu))},
+      {"thresholdAuto", binary(wrap(operations::thresholdAuto))},
+      {"thresholdMultiOtsu", wrap(operations::thresholdMultiOtsu)},
+  };
+  return registry;
+}
+// Operations which only read a bounded neighbourhood of every pixel, so consecutive ones can be
+// fused and run tile by tile. Each one returns nullopt if it can't be fused for an image with the
+// given number of channels.
+struct TiledOperation {
+  std::function<std::optional<TileStage>(const QJsonArray &, int channels)> stage;
+  // the result is marked as binary, like the thresholding operations in the registry
+  bool binary = false;
+};
+
+template <typename... Args, typename HaloFn>
+TiledOperation tiled(cv::Mat (*fn)(const cv::Mat &, Args...), HaloFn halo) {
+  return {[fn, halo](const QJsonArray &params, int) -> std::optional<TileStage> {
+    auto args = decodeArgs<Args...>(params);
+    return TileStage{std::apply(halo, args), [fn, args](const cv::Mat &mat) {
+                       return std::apply(
+                           [&mat, fn](const auto &...arg) { return fn(mat, arg...); }, args);
+                     }};
+  }};
+}
+
+int kernelHalo(const cv::Mat &kernel) { return std::max(kernel.rows, kernel.cols) / 2; }
+
+const std::map<QString, TiledOperation> &getTiledRegistry() {
+  static const std::map<QString, TiledOperation> registry{
+      {"negate",
+       {[](const QJsonArray &, int) -> std::optional<TileStage> {
+         return TileStage{0, [](const cv::Mat &mat) {
+                            return imageProcessor::applyLUTcv(mat, imageProcessor::negate());
+                          }};
+       }}},
+      {"rangeStretch", tiled(operations::rangeStretch, [](int, int, int, int) { return 0; })},
+      {"posterize", tiled(operations::posterize, [](int) { return 0; })},
+      {"blurMean", tiled(operations::blurMean, [](int k, int) { return k / 2; })},
+      {"blurMedian", tiled(operations::blurMedian, [](int k) { return k / 2; })},
+      {"blurGaussian", tiled(operations::blurGaussian, [](int k, int, double) { return k / 2; })},
+      // a kernel size of 1 still reads the direct neighbours
+      {"edgeDetectSobel", tiled(operations::edgeDetectSobel,
+                                [](int k, int, operations::SobelDirection) {
+                                  return std::max(1, k / 2);
+                                })},
+      {"edgeDetectLaplacian",
+       tiled(operations::edgeDetectLaplacian, [](int k, int) { return std::max(1, k / 2); })},
+      {"convolve",
+       tiled(operations::convolve, [](const cv::Mat &kernel, int) { return kernelHalo(kernel); })},
+      {"morphologyErode", tiled(operations::morphologyErode,
+                                [](const cv::Mat &kernel, int) { return kernelHalo(kernel); })},
+      {"morphologyDilate", tiled(operations::morphologyDilate,
+                                 [](const cv::Mat &kernel, int) { return kernelHalo(kernel); })},
+      {"morphologyOpen", tiled(operations::morphologyOpen,
+                               [](const cv::Mat &kernel, int) { return 2 * kernelHalo(kernel); })},
+      {"morphologyClose", tiled(operations::morphologyClose, [](const cv::Mat &kernel, int) {
+         return 2 * kernelHalo(kernel);
+       })},
+  };
+  return registry;
+}
+
+// manual thresholding of a grayscale image always yields a binary one, colour images
+// are left unchanged by it so they can't be fused
+std::optional<TileStage> thresholdStage(const QJsonArray &params, int channels) {
+  if (channels != 1)
+    return std::nullopt;
+  return tiled(operations::thresholdManual, [](int) { return 0; }).stage(params, channels);
+}
+
+std::optional<TiledOperation> findTiled(const QString &operation) {
+  if (operation == "thresholdManual")
+    return TiledOperation{thresholdStage, true};
+  auto it = getTiledRegistry().find(operation);
+  if (it == getTiledRegistry().end())
+    return std::nullopt;
+  return it->second;
+}
+} // namespace
+
+void Pipeline::append(PipelineStep step) { steps.push_back(std::move(step)); }
+
+void Pipeline::append(const Pipeline &other) {
+  steps.insert(steps.end(), other.steps.begin(), other.steps.end());
+}
+
+std::vector<PipelineStep> Pipeline::removeFrom(std::size_t index) {
+  if (index >= steps.size())
+    return {};
+  std::vector<PipelineStep> removed(std::make_move_iterator(steps.begin() + index),
+                                    std::make_move_iterator(steps.end()));
+  steps.erase(steps.begin() + index, steps.end());
+  return removed;
+}
+
+bool Pipeline::isKnownOperation(const QString &operation) {
+  return getRegistry().count(operation) > 0;
+}
+
+std::optional<int> Pipeline::getHalo(const PipelineStep &step, int channels) {
+  auto tiledOp = findTiled(step.operation);
+  if (!tiledOp.has_value())
+    return std::nullopt;
+  auto stage = tiledOp->stage(step.params, channels);
+  if (!stage.has_value())
+    return std::nullopt;
+  return stage->halo;
+}
+
+QByteArray Pipeline::toJson() const {
+  QJsonArray stepsArray;
+  for (const PipelineStep &step : steps) {
+    QJsonObject object;
+    object["operation"] = step.operation;
+    object["params"] = step.params;
+    stepsArray.append(object);
+  }
+
+  QJsonObject root;
+  root["version"] = 1;
+  root["steps"] = stepsArray;
+  return QJsonDocument(root).toJson();
+}
+
+std::optional<Pipeline> Pipeline::fromJson(const QByteArray &json) {
+  QJsonParseError error;
+  QJsonDocument document = QJsonDocument::fromJson(json, &error);
+  if (error.error != QJsonParseError::NoError || !document.isObject())
+    return std::nullopt;
+
+  QJsonValue stepsValue = document.object().value("steps");
+  if (!stepsValue.isArray())
+    return std::nullopt;
+
+  Pipeline pipeline;
+  for (const QJsonValue &stepValue : stepsValue.toArray()) {
+    QJsonObject object = stepValue.toObject();
+    QString operation = object.value("operation").toString();
+    QJsonValue params = object.value("params");
+    if (!isKnownOperation(operation) || !params.isArray())
+      return std::nullopt;
+    pipeline.append({operation, params.toArray()});
+  }
+  return pipeline;
+}
+
+ImageWrapper Pipeline::apply(const ImageWrapper &image) const {
+  ImageWrapper current = image;
+  for (std::size_t i = 0; i < steps.size();) {
+    // consecutive operations which can be run tile by tile are fused together
+    std::vector<TileStage> stages;
+    bool binary = false;
+    std::size_t end = i;
+    for (; end < steps.size(); ++end) {
+      auto tiledOp = findTiled(steps[end].operation);
+      if (!tiledOp.has_value())
+        break;
+      auto stage = tiledOp->stage(steps[end].params, current.getMat().channels());
+      if (!stage.has_value())
+        break;
+      stages.push_back(std::move(stage.value()));
+      binary = tiledOp->binary;
+    }
+
+    if (stages.size() >= 2) {
+      current = ImageWrapper(TileExecutor(std::move(stages)).run(current.getMat()));
+      if (binary)
+        current = current.toBinary().value_or(current);
+      i = end;
+      continue;
+    }
+
+    const PipelineStep &step = steps[i++];
+    auto it = getRegistry().find(step.operation);
+    if (it == getRegistry().end())
+      throw std::invalid_argument("Unknown operation: " + step.operation.toStdString());
+
+    auto result = it->second(current, step.params);
+    if (result.has_value())
+      current = std::move(result.value());
+  }
+  return current;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "imageWrapper.hpp"
+#include <QByteArray>
+#include <QJsonArray>
+#include <QJsonValue>
+#include <QString>
+#include <cmath>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Conversion of dialog parameters to and from JSON
+namespace ParamCodec {
+// masks are stored as {"rows": r, "cols": c, "type": t, "data": [row-major values]}
+QJsonValue encode(const cv::Mat &mat);
+cv::Mat decodeMat(const QJsonValue &value);
+
+template <typename T> QJsonValue encode(const T &value) {
+  if constexpr (std::is_enum_v<T> || std::is_integral_v<T>)
+    return QJsonValue(static_cast<qint64>(value));
+  else
+    return QJsonValue(static_cast<double>(value));
+}
+
+template <typename T> T decode(const QJsonValue &value) {
+  if constexpr (std::is_same_v<T, cv::Mat>) {
+    return decodeMat(value);
+  } else {
+    if (!value.isDouble())
+      throw std::invalid_argument("Expected a number as an operation parameter");
+    if constexpr (std::is_enum_v<T> || std::is_integral_v<T>) {
+      // toInteger() would turn e.g. 3.5 into 0
+      double number = value.toDouble();
+      if (number != std::trunc(number))
+        throw std::invalid_argument("Expected a whole number as an operation parameter");
+      return static_cast<T>(value.toInteger());
+    } else
+      return static_cast<T>(value.toDouble());
+  }
+}
+
+template <typename... Ts> QJsonArray encodeParams(const std::tuple<Ts...> &params) {
+  QJsonArray array;
+  std::apply([&array](const auto &...param) { (array.append(encode(param)), ...); }, params);
+  return array;
+}
+} // namespace ParamCodec
+
+// single operation applied to an image, the same as a menu action with its dialog accepted
+struct PipelineStep {
+  QString operation;
+  QJsonArray params;
+};
+
+// Sequence of operations that can be saved and applied to other images.
+class Pipeline {
+public:
+  void append(PipelineStep step);
+  void append(const Pipeline &other);
+  const std::vector<PipelineStep> &getSteps() const { return steps; }
+  bool isEmpty() const { return steps.empty(); }
+  std::size_t size() const { return steps.size(); }
+  void clear() { steps.clear(); }
+  // removes the steps from `index` on and returns them, nothing if there are fewer steps
+  std::vector<PipelineStep> removeFrom(std::size_t index);
+
+  QByteArray toJson() const;
+  // returns nullopt if the document is malformed or contains unknown operations
+  static std::optional<Pipeline> fromJson(const QByteArray &json);
+
+  // applies all steps one after another, steps which can't be applied to the image (e.g.
+  // thresholding that didn't produce a binary image) leave it unchanged just like in the UI.
+  // throws std::invalid_argument if any step has invalid parameters
+  ImageWrapper apply(const ImageWrapper &image) const;
+
+  static bool isKnownOperation(const QString &operation);
+  // how far from each pixel `step` reads an image with `channels` channels,
+  // nullopt if the result depends on the whole image (e.g. equalization)
+  static std::optional<int> getHalo(const PipelineStep &step, int channels);
+
+private:
+  std::vector<PipelineStep> steps;
+};
@@ -0,0 +1,271 @@
+#include "roiMeasurement.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <opencv2/core/utility.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace {
+struct Accumulator {
+  std::uint64_t sum = 0, sumSq = 0;
+  int min = 255, max = 0;
+
+  void add(const Accumulator &other) {
+    sum += other.sum;
+    sumSq += other.sumSq;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+  }
+};
+
+// adds `n` consecutive pixels of `row`, channel c goes to acc[c]
+void addPixels(const uchar *row, int n, int channels, Accumulator *acc) {
+  if (channels == 1) {
+    // locals, so that the loop gets vectorized
+    std::uint64_t sum = 0, sumSq = 0;
+    uchar min = 255, max = 0;
+    for (int x = 0; x < n; ++x) {
+      unsigned v = row[x];
+      sum += v;
+      sumSq += v * v;
+      min = std::min(min, row[x]);
+      max = std::max(max, row[x]);
+    }
+    acc->add({sum, sumSq, min, max});
+    return;
+  }
+  for (int x = 0; x < n; ++x)
+    for (int c = 0; c < channels; ++c) {
+      unsigned v = row[x * channels + c];
+      acc[c].sum += v;
+      acc[c].sumSq += v * v;
+      acc[c].min = std::min(acc[c].min, static_cast<int>(v));
+      acc[c].max = std::max(acc[c].max, static_cast<int>(v));
+    }
+}
+
+// rois with indices `rectangles` (sorted by their top rows) are measured row by row, each band of
+// rows by a different thread into accumulators of its own
+void measureRectangles(const cv::Mat &mat, const std::vector<cv::Rect> &clipped,
+                       const std::vector<int> &rectangles, std::vector<Accumulator> &totals) {
+  if (rectangles.empty())
+    return;
+  const int channels = mat.channels();
+  const int bands = std::min(mat.rows, std::max(1, cv::getNumThreads() * 4));
+  const int bandHeight = (mat.rows + bands - 1) / bands;
+
+  struct Band {
+    // indices into `rectangles` of the ones crossing the band, from left to right
+    std::vector<int> active;
+    std::vector<Accumulator> accs;
+  };
+  std::vector<Band> results(bands);
+
+  cv::parallel_for_(cv::Range(0, bands), [&](const cv::Range &range) {
+    for (int b = range.start; b < range.end; ++b) {
+      int y0 = b * bandHeight, y1 = std::min(mat.rows, y0 + bandHeight);
+      Band &band = results[b];
+      for (std::size_t j = 0; j < rectangles.size(); ++j) {
+        const cv::Rect &rect = clipped[rectangles[j]];
+        if (rect.y >= y1)
+          break;
+        if (rect.y + rect.height > y0)
+          band.active.push_back(static_cast<int>(j));
+      }
+      // the row is then read from left to right
+      std::sort(band.active.begin(), band.active.end(), [&](int l, int r) {
+        return clipped[rectangles[l]].x < clipped[rectangles[r]].x;
+      });
+      band.accs.assign(band.active.size() * channels, Accumulator());
+
+      for (int y = y0; y < y1; ++y) {
+        const uchar *row = mat.ptr<uchar>(y);
+        for (std::size_t k = 0; k < band.active.size(); ++k) {
+          const cv::Rect &rect = clipped[rectangles[band.active[k]]];
+          if (y < rect.y || y >= rect.y + rect.height)
+            continue;
+          addPixels(row + static_cast<std::size_t>(rect.x) * channels, rect.width, channels,
+                    &band.accs[k * channels]);
+        }
+      }
+    }
+  });
+
+  for (const Band &band : results)
+    for (std::size_t k = 0; k < band.active.size(); ++k)
+      for (int c = 0; c < channels; ++c)
+        totals[rectangles[band.active[k]] * channels + c].add(band.accs[k * channels + c]);
+}
+
+void measurePolygons(const cv::Mat &mat, const std::vector<roi::Roi> &rois,
+                     const std::vector<cv::Rect> &clipped, const std::vector<int> &polygons,
+                     std::vector<Accumulator> &totals, std::vector<long long> &areas) {
+  const int channels = mat.channels();
+  cv::parallel_for_(cv::Range(0, static_cast<int>(polygons.size())), [&](const cv::Range &range) {
+    cv::Mat mask;
+    for (int p = range.start; p < range.end; ++p) {
+      int i = polygons[p];
+      const cv::Rect &box = clipped[i];
+      mask.create(box.size(), CV_8UC1);
+      mask.setTo(0);
+      cv::fillPoly(mask, std::vector<std::vector<cv::Point>>{rois[i].polygon}, 255, cv::LINE_8, 0,
+                   -box.tl());
+
+      Accumulator *acc = &totals[i * channels];
+      for (int y = 0; y < box.height; ++y) {
+        const uchar *m = mask.ptr<uchar>(y);
+        const uchar *row = mat.ptr<uchar>(box.y + y) + static_cast<std::size_t>(box.x) * channels;
+        // runs of pixels inside the polygon
+        for (int x = 0; x < box.width;) {
+          if (m[x] == 0) {
+            ++x;
+            continue;
+          }
+          int end = x;
+          while (end < box.width && m[end] != 0)
+            ++end;
+          addPixels(row + static_cast<std::size_t>(x) * channels, end - x, channels, acc);
+          areas[i] += end - x;
+          x = end;
+        }
+      }
+    }
+  });
+}
+
+void writeEscaped(std::ostream &out, const std::string &text) {
+  out << '"';
+  for (char c : text) {
+    if (c == '"')
+      out << '"';
+    out << c;
+  }
+  out << '"';
+}
+} // namespace
+
+namespace roi {
+Roi Roi::rectangle(std::string name, cv::Rect rect) { return {std::move(name), rect, {}}; }
+
+Roi Roi::fromPolygon(std::string name, std::vector<cv::Point> polygon) {
+  cv::Rect rect = polygon.empty() ? cv::Rect() : cv::boundingRect(polygon);
+  return {std::move(name), rect, std::move(polygon)};
+}
+
+std::vector<Roi> grid(cv::Rect area, int rows, int cols) {
+  std::vector<Roi> rois;
+  if (rows <= 0 || cols <= 0)
+    return rois;
+  rois.reserve(static_cast<std::size_t>(rows) * cols);
+  for (int r = 0; r < rows; ++r) {
+    int y0 = area.y + static_cast<int>(static_cast<long long>(area.height) * r / rows);
+    int y1 = area.y + static_cast<int>(static_cast<long long>(area.height) * (r + 1) / rows);
+    for (int c = 0; c < cols; ++c) {
+      int x0 = area.x + static_cast<int>(static_cast<long long>(area.width) * c / cols);
+      int x1 = area.x + static_cast<int>(static_cast<long long>(area.width) * (c + 1) / cols);
+      rois.push_back(Roi::rectangle("r" + std::to_string(r + 1) + "c" + std::to_string(c + 1),
+                                    cv::Rect(x0, y0, x1 - x0, y1 - y0)));
+    }
+  }
+  return rois;
+}
+
+std::vector<Measurement> measure(const cv::Mat &mat, const std::vector<Roi> &rois) {
+  TRACE_SCOPE("roi::measure");
+  CV_Assert(mat.depth() == CV_8U);
+  const int channels = mat.channels();
+  const cv::Rect bounds(0, 0, mat.cols, mat.rows);
+
+  std::vector<cv::Rect> clipped(rois.size());
+  std::vector<int> rectangles, polygons;
+  std::vector<long long> areas(rois.size(), 0);
+  for (std::size_t i = 0; i < rois.size(); ++i) {
+    clipped[i] = rois[i].rect & bounds;
+    if (clipped[i].empty())
+      continue;
+    if (rois[i].isPolygon()) {
+      polygons.push_back(static_cast<int>(i));
+    } else {
+      rectangles.push_back(static_cast<int>(i));
+      areas[i] = clipped[i].area();
+    }
+  }
+  std::stable_sort(rectangles.begin(), rectangles.end(),
+                   [&](int a, int b) { return clipped[a].y < clipped[b].y; });
+
+  std::vector<Accumulator> totals(rois.size() * channels);
+  measureRectangles(mat, clipped, rectangles, totals);
+  measurePolygons(mat, rois, clipped, polygons, totals, areas);
+
+  std::vector<Measurement> measurements(rois.size());
+  for (std::size_t i = 0; i < rois.size(); ++i) {
+    Measurement &m = measurements[i];
+    m.area = areas[i];
+    m.channels.resize(channels);
+    if (m.area == 0)
+      continue;
+    for (int c = 0; c < channels; ++c) {
+      const Accumulator &acc = totals[i * channels + c];
+      ChannelMeasurement &channel = m.channels[c];
+      double sum = static_cast<double>(acc.sum);
+      channel.mean = sum / m.area;
+      // population deviation, as cv::meanStdDev gives
+      double variance = static_cast<double>(acc.sumSq) / m.area - channel.mean * channel.mean;
+      channel.stdDev = std::sqrt(std::max(0.0, variance));
+      channel.min = acc.min;
+      channel.max = acc.max;
+      channel.integratedDensity = sum;
+    }
+  }
+  return measurements;
+}
+
+void writeCsv(std::ostream &out, const std::vector<Roi> &rois,
+              const std::vector<Measurement> &measurements,
+              const std::vector<std::string> &channelNames) {
+  std::size_t channels = measurements.empty() ? 0 : measurements.front().channels.size();
+  auto suffix = [&](std::size_t c) -> std::string {
+    if (channels <= 1)
+      return "";
+    return "_" + (c < channelNames.size() ? channelNames[c] : std::to_string(c));
+  };
+
+  out << "name,type,x,y,width,height,area";
+  for (std::size_t c = 0; c < channels; ++c)
+    for (const char *column : {"mean", "std_dev", "min", "max", "int_den"})
+      out << ',' << column << suffix(c);
+  out << '\n';
+
+  out << std::fixed << std::setprecision(3);
+  for (std::size_t i = 0; i < rois.size() && i < measurements.size(); ++i) {
+    const Roi &roi = rois[i];
+    const Measurement &m = measurements[i];
+    writeEscaped(out, roi.name);
+    out << ',' << (roi.isPolygon() ? "polygon" : "rectangle") << ',' << roi.rect.x << ','
+        << roi.rect.y << ',' << roi.rect.width << ',' << roi.rect.height << ',' << m.area;
+    for (const ChannelMeasurement &channel : m.channels) {
+      // nothing to measure outside of the image
+      if (m.area == 0) {
+        out << ",,,,,0";
+        continue;
+      }
+      out << ',' << channel.mean << ',' << channel.stdDev << ',' << channel.min << ','
+          << channel.max << ',' << static_cast<long long>(channel.integratedDensity);
+    }
+    out << '\n';
+  }
+}
+
+bool writeCsv(const std::string &path, const std::vector<Roi> &rois,
+              const std::vector<Measurement> &measurements,
+              const std::vector<std::string> &channelNames) {
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  writeCsv(out, rois, measurements, channelNames);
+  return static_cast<bool>(out);
+}
+} // namespace roi
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Measurements of many regions of interest of an 8-bit image at once, similar to ImageJ's
+// ROI Manager. Rectangles are all measured in a single pass over the rows of the image, split
+// into bands measured in parallel; polygons are measured in parallel with a mask each.
+namespace roi {
+struct Roi {
+  std::string name;
+  // the rectangle, or the bounding box of the polygon
+  cv::Rect rect;
+  // empty for rectangles
+  std::vector<cv::Point> polygon;
+
+  static Roi rectangle(std::string name, cv::Rect rect);
+  // pixels on the edges of the polygon are a part of it
+  static Roi fromPolygon(std::string name, std::vector<cv::Point> polygon);
+  bool isPolygon() const { return !polygon.empty(); }
+};
+
+// statistics of a single channel
+struct ChannelMeasurement {
+  double mean = 0, stdDev = 0;
+  // -1 if the roi has no pixels inside the image
+  int min = -1, max = -1;
+  // sum of the values, ImageJ's RawIntDen
+  double integratedDensity = 0;
+};
+
+struct Measurement {
+  // pixels of the roi inside the image
+  long long area = 0;
+  std::vector<ChannelMeasurement> channels;
+};
+
+// rows x cols rectangles covering `area`, named "r<row>c<col>"
+std::vector<Roi> grid(cv::Rect area, int rows, int cols);
+
+// measures every roi of `mat` (any 8-bit type), the parts outside of it are ignored
+std::vector<Measurement> measure(const cv::Mat &mat, const std::vector<Roi> &rois);
+
+// a row per roi, columns of each channel are suffixed with the channel's name if there are more
+// of them
+void writeCsv(std::ostream &out, const std::vector<Roi> &rois,
+              const std::vector<Measurement> &measurements,
+              const std::vector<std::string> &channelNames = {});
+// returns false if the file couldn't be written
+bool writeCsv(const std::string &path, const std::vector<Roi> &rois,
+              const std::vector<Measurement> &measurements,
+              const std::vector<std::string> &channelNames = {});
+} // namespace roi
@@ -0,0 +1,135 @@
+#include "stallWatchdog.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+StallWatchdog::StallWatchdog(std::chrono::milliseconds threshold,
+                             const std::atomic<const char *> &activeScope)
+    : threshold(threshold), activeScope(activeScope), epoch(std::chrono::steady_clock::now()),
+      lastBeat(now()) {
+  thread = std::thread(&StallWatchdog::watch, this);
+}
+
+StallWatchdog::~StallWatchdog() { stop(); }
+
+void StallWatchdog::stop() {
+  {
+    std::lock_guard lock(mutex);
+    if (stopping)
+      return;
+    stopping = true;
+  }
+  wake.notify_one();
+  thread.join();
+  // the watched thread may still be stuck, the stall lasted at least until now
+  if (stalled)
+    finishStall(now());
+}
+
+void StallWatchdog::heartbeat() {
+  lastBeat.store(now());
+  beating.store(true);
+}
+
+void StallWatchdog::setOperation(const std::string &operation) {
+  std::lock_guard lock(mutex);
+  this->operation = operation;
+}
+
+std::vector<StallWatchdog::Stall> StallWatchdog::getStalls() const {
+  std::lock_guard lock(mutex);
+  return {stalls.begin(), stalls.end()};
+}
+
+std::int64_t StallWatchdog::now() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                              epoch)
+      .count();
+}
+
+void StallWatchdog::watch() {
+  // sampling a few times within the threshold also tells which scopes the time went to
+  auto interval = std::max(threshold / 4, std::chrono::milliseconds(1));
+  std::int64_t limit = std::chrono::nanoseconds(threshold).count();
+  std::unique_lock lock(mutex);
+  while (!wake.wait_for(lock, interval, [this]() { return stopping; })) {
+    std::int64_t beat = lastBeat.load();
+    if (stalled && beat != stallBeat) {
+      lock.unlock();
+      finishStall(beat);
+      lock.lock();
+    }
+    if (!stalled && beating.load() && now() - beat > limit) {
+      stalled = true;
+      stallBeat = beat;
+      stallOperation = operation;
+      scopeSamples.clear();
+    }
+    if (stalled) {
+      if (const char *scope = activeScope.load())
+        scopeSamples[scope]++;
+    }
+  }
+}
+
+void StallWatchdog::finishStall(std::int64_t beat) {
+  stalled = false;
+  auto mostSampled = std::max_element(scopeSamples.begin(), scopeSamples.end(),
+                                      [](auto &a, auto &b) { return a.second < b.second; });
+  Stall stall{stallBeat / 1e6, (beat - stallBeat) / 1e6, stallOperation,
+              mostSampled == scopeSamples.end() ? "" : mostSampled->first};
+
+  std::cerr << "UI thread stalled for " << static_cast<long>(stall.duration) << " ms";
+  if (!stall.operation.empty())
+    std::cerr << " in " << stall.operation;
+  if (!stall.scope.empty())
+    std::cerr << " (" << stall.scope << ")";
+  std::cerr << std::endl;
+
+  std::lock_guard lock(mutex);
+  stalls.push_back(std::move(stall));
+  if (stalls.size() > MAX_STALLS)
+    stalls.pop_front();
+}
+
+bool StallWatchdog::writeReport(const std::string &path) const {
+  std::vector<Stall> stalls = getStalls();
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  auto writeEscaped = [&out](const std::string &text) {
+    out << '"';
+    for (char c : text)
+      out << (c == '"' ? "\"\"" : std::string(1, c));
+    out << '"';
+  };
+  out << std::fixed << std::setprecision(3);
+  out << "started_ms,duration_ms,operation,scope\n";
+  for (const Stall &stall : stalls) {
+    out << stall.started << ',' << stall.duration << ',';
+    writeEscaped(stall.operation);
+    out << ',';
+    writeEscaped(stall.scope);
+    out << '\n';
+  }
+  return static_cast<bool>(out);
+}
+
+void StallWatchdog::writeToEnvironmentPath() const {
+  const char *path = std::getenv(REPORT_VARIABLE);
+  if (path != nullptr && *path != '\0')
+    writeReport(path);
+}
+
+std::chrono::milliseconds StallWatchdog::thresholdFromEnvironment() {
+  const char *value = std::getenv(THRESHOLD_VARIABLE);
+  if (value == nullptr || *value == '\0')
+    return DEFAULT_THRESHOLD;
+  char *end;
+  long ms = std::strtol(value, &end, 10);
+  if (*end != '\0' || ms < 0)
+    return DEFAULT_THRESHOLD;
+  return std::chrono::milliseconds(ms);
+}
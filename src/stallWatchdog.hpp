@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches a thread running an event loop from a separate thread and reports every time the loop
+// doesn't turn over for longer than the threshold, along with the operation and the innermost
+// trace scope that were active at the time.
+class StallWatchdog {
+public:
+  // number of the most recent stalls kept in the report
+  static const std::size_t MAX_STALLS = 256;
+  // environment variable with the threshold in milliseconds, 0 disables the watchdog
+  static constexpr const char *THRESHOLD_VARIABLE = "APO_STALL_THRESHOLD_MS";
+  // environment variable with a path the report is written to when the watchdog is destroyed
+  static constexpr const char *REPORT_VARIABLE = "APO_STALL_REPORT";
+  static constexpr std::chrono::milliseconds DEFAULT_THRESHOLD{200};
+
+  struct Stall {
+    // milliseconds since the watchdog started
+    double started;
+    double duration;
+    // operation set with `setOperation`, empty if there was none
+    std::string operation;
+    // innermost trace scope seen most often while the thread was stalled, empty if there was none
+    std::string scope;
+  };
+
+  // `activeScope` is the trace::activeScope() of the watched thread
+  StallWatchdog(std::chrono::milliseconds threshold, const std::atomic<const char *> &activeScope);
+  ~StallWatchdog();
+  StallWatchdog(const StallWatchdog &) = delete;
+  StallWatchdog &operator=(const StallWatchdog &) = delete;
+
+  // has to be called by the watched thread every time its event loop turns over, a few times
+  // within the threshold, nothing is reported before the first one
+  void heartbeat();
+  // stops watching, a stall in progress is recorded as lasting until now
+  void stop();
+  // name of the operation the watched thread is about to run, empty once it's done
+  void setOperation(const std::string &operation);
+  std::chrono::milliseconds getThreshold() const { return threshold; }
+  // most recent stalls, the oldest first
+  std::vector<Stall> getStalls() const;
+  // writes the stalls as CSV, returns false if the file couldn't be written
+  bool writeReport(const std::string &path) const;
+  // writes the report to the path from APO_STALL_REPORT if it's set
+  void writeToEnvironmentPath() const;
+
+  // threshold from APO_STALL_THRESHOLD_MS or the default one
+  static std::chrono::milliseconds thresholdFromEnvironment();
+
+private:
+  const std::chrono::milliseconds threshold;
+  const std::atomic<const char *> &activeScope;
+  const std::chrono::steady_clock::time_point epoch;
+  // nanoseconds since `epoch` of the last heartbeat
+  std::atomic<std::int64_t> lastBeat;
+  // the loop may take a while to start turning over, e.g. while the program is starting
+  std::atomic<bool> beating = false;
+
+  mutable std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::string operation;
+  std::deque<Stall> stalls;
+
+  // state of the stall in progress, used only by the watchdog thread
+  bool stalled = false;
+  std::int64_t stallBeat = 0;
+  std::string stallOperation;
+  std::map<const char *, int> scopeSamples;
+
+  std::thread thread;
+
+  std::int64_t now() const;
+  void watch();
+  void finishStall(std::int64_t beat);
+};
@@ -0,0 +1,241 @@
+#include "syntheticImages.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include <stdexcept>
+
+namespace synthetic {
+namespace {
+// streams of random numbers used by different kinds of content
+const std::uint64_t DEFECTS_STREAM = 0x6E656172;
+
+void fillNoise(cv::Mat &mat, std::uint64_t seed) {
+  const std::size_t rowBytes = mat.cols * mat.elemSize();
+  const std::uint64_t numbersPerRow = (rowBytes + 7) / 8;
+  cv::parallel_for_(cv::Range(0, mat.rows), [&](const cv::Range &rows) {
+    for (int y = rows.start; y < rows.end; ++y) {
+      uchar *rowPtr = mat.ptr(y);
+      for (std::size_t i = 0; i < rowBytes; i += 8) {
+        // every number gives 8 pixels, taken byte by byte so it doesn't depend on endianness
+        std::uint64_t r = random(seed, y * numbersPerRow + i / 8);
+        std::size_t n = std::min<std::size_t>(8, rowBytes - i);
+        for (std::size_t k = 0; k < n; ++k)
+          rowPtr[i + k] = static_cast<uchar>(r >> (8 * k));
+      }
+    }
+  });
+}
+
+void fillGradient(cv::Mat &mat) {
+  const int channels = mat.channels();
+  const double dx = std::max(1, mat.cols - 1), dy = std::max(1, mat.rows - 1);
+  cv::parallel_for_(cv::Range(0, mat.rows), [&](const cv::Range &rows) {
+    for (int y = rows.start; y < rows.end; ++y) {
+      uchar *rowPtr = mat.ptr(y);
+      for (int x = 0; x < mat.cols; ++x) {
+        for (int c = 0; c < channels; ++c) {
+          double t = c % 3 == 0 ? x / dx : c % 3 == 1 ? y / dy : (x + y) / (dx + dy);
+          rowPtr[x * channels + c] = static_cast<uchar>(cvRound(t * 255));
+        }
+      }
+    }
+  });
+}
+
+void fillTextEdges(cv::Mat &mat, std::uint64_t seed) {
+  const int glyphWidth = 10, lineHeight = 16;
+  const int glyphsPerLine = (mat.cols + glyphWidth - 1) / glyphWidth;
+  const int lines = (mat.rows + lineHeight - 1) / lineHeight;
+  mat.setTo(255);
+
+  cv::parallel_for_(cv::Range(0, lines), [&](const cv::Range &range) {
+    for (int line = range.start; line < range.end; ++line) {
+      int top = line * lineHeight;
+      cv::Mat band = mat.rowRange(top, std::min(mat.rows, top + lineHeight));
+      for (int glyph = 0; glyph < glyphsPerLine; ++glyph) {
+        std::uint64_t r = random(seed, static_cast<std::uint64_t>(line) * glyphsPerLine + glyph);
+        // roughly every 6th glyph is a space
+        if ((r & 0xF) < 3)
+          continue;
+
+        const int left = glyph * glyphWidth + 1, right = left + 7, mid = left + 4;
+        const int upper = 2, lower = 13, center = 8;
+        const cv::Point strokes[8][2] = {
+            {{left, upper}, {left, lower}},   {{right, upper}, {right, lower}},
+            {{mid, upper}, {mid, lower}},     {{left, upper}, {right, upper}},
+            {{left, center}, {right, center}}, {{left, lower}, {right, lower}},
+            {{left, lower}, {right, upper}},  {{left, upper}, {right, lower}},
+        };
+        int count = 2 + static_cast<int>((r >> 4) % 3);
+        for (int s = 0; s < count; ++s) {
+          const cv::Point *stroke = strokes[(r >> (8 + 3 * s)) & 7];
+          cv::line(band, stroke[0], stroke[1], cv::Scalar(0), 1, cv::LINE_8);
+        }
+      }
+    }
+  });
+}
+
+// every blob is drawn inside its own cell, so cells can be drawn in parallel
+void fillBlobs(cv::Mat &mat, std::uint64_t seed, int thickness) {
+  thickness = std::max(1, thickness);
+  const int cell = std::max(32, 8 * thickness);
+  const int margin = thickness / 2 + 1;
+  const int cellsPerRow = (mat.cols + cell - 1) / cell;
+  const int cellRows = (mat.rows + cell - 1) / cell;
+  mat.setTo(0);
+
+  cv::parallel_for_(cv::Range(0, cellRows), [&](const cv::Range &range) {
+    for (int row = range.start; row < range.end; ++row) {
+      int top = row * cell;
+      cv::Mat band = mat.rowRange(top, std::min(mat.rows, top + cell));
+      for (int col = 0; col < cellsPerRow; ++col) {
+        std::uint64_t index = static_cast<std::uint64_t>(row) * cellsPerRow + col;
+        std::uint64_t r = random(seed, 2 * index);
+        // a quarter of the cells stays empty
+        if ((r & 3) == 0)
+          continue;
+
+        int points = 3 + static_cast<int>((r >> 2) % 3);
+        std::uint64_t coords = random(seed, 2 * index + 1);
+        std::vector<cv::Point> curve;
+        for (int i = 0; i < points; ++i) {
+          int span = cell - 2 * margin;
+          int x = static_cast<int>((coords >> (12 * i)) & 0x3F) * span / 64;
+          int y = static_cast<int>((coords >> (12 * i + 6)) & 0x3F) * span / 64;
+          curve.emplace_back(col * cell + margin + x, margin + y);
+        }
+        cv::polylines(band, curve, false, cv::Scalar(255), thickness, cv::LINE_8);
+      }
+    }
+  });
+}
+
+void addDefects(cv::Mat &mat, std::uint64_t seed, double fraction) {
+  const double range = 18446744073709551616.0; // 2^64
+  const std::uint64_t threshold = fraction >= 1.0 ? std::numeric_limits<std::uint64_t>::max()
+                                                  : static_cast<std::uint64_t>(fraction * range);
+  cv::parallel_for_(cv::Range(0, mat.rows), [&](const cv::Range &rows) {
+    for (int y = rows.start; y < rows.end; ++y) {
+      uchar *rowPtr = mat.ptr<uchar>(y);
+      for (int x = 0; x < mat.cols; ++x) {
+        std::uint64_t counter = static_cast<std::uint64_t>(y) * mat.cols + x;
+        if (random(seed ^ DEFECTS_STREAM, counter) < threshold)
+          rowPtr[x] = rowPtr[x] == 0 ? 1 : 254;
+      }
+    }
+  });
+}
+
+cv::Mat replicateChannels(const cv::Mat &gray, int channels) {
+  if (channels == 1)
+    return gray;
+  cv::Mat out;
+  cv::merge(std::vector<cv::Mat>(channels, gray), out);
+  return out;
+}
+} // namespace
+
+cv::Mat generate(const Spec &spec) {
+  CV_Assert(spec.size.width > 0 && spec.size.height > 0);
+  CV_Assert(spec.channels >= 1 && spec.channels <= 4);
+
+  switch (spec.kind) {
+  case Kind::Noise: {
+    cv::Mat mat(spec.size, CV_8UC(spec.channels));
+    fillNoise(mat, spec.seed);
+    return mat;
+  }
+  case Kind::Gradient: {
+    cv::Mat mat(spec.size, CV_8UC(spec.channels));
+    fillGradient(mat);
+    return mat;
+  }
+  case Kind::TextEdges: {
+    cv::Mat gray(spec.size, CV_8UC1);
+    fillTextEdges(gray, spec.seed);
+    return replicateChannels(gray, spec.channels);
+  }
+  case Kind::BinaryBlobs:
+  case Kind::NearBinary: {
+    cv::Mat gray(spec.size, CV_8UC1);
+    fillBlobs(gray, spec.seed, spec.thickness);
+    if (spec.kind == Kind::NearBinary)
+      addDefects(gray, spec.seed, spec.defectFraction);
+    return replicateChannels(gray, spec.channels);
+  }
+  }
+  throw std::invalid_argument("Unknown kind of synthetic image");
+}
+
+const std::vector<Kind> &allKinds() {
+  static const std::vector<Kind> kinds{Kind::Noise, Kind::Gradient, Kind::TextEdges,
+                                       Kind::BinaryBlobs, Kind::NearBinary};
+  return kinds;
+}
+
+std::string toString(Kind kind) {
+  switch (kind) {
+  case Kind::Noise:
+    return "noise";
+  case Kind::Gradient:
+    return "gradient";
+  case Kind::TextEdges:
+    return "text";
+  case Kind::BinaryBlobs:
+    return "blobs";
+  case Kind::NearBinary:
+    return "nearbinary";
+  }
+  return "";
+}
+
+std::optional<Kind> kindFromString(const std::string &name) {
+  for (Kind kind : allKinds())
+    if (toString(kind) == name)
+      return kind;
+  return std::nullopt;
+}
+
+std::string fileName(const Spec &spec) {
+  std::string name = toString(spec.kind) + "_" + std::to_string(spec.size.width) + "x" +
+                     std::to_string(spec.size.height) + "_c" + std::to_string(spec.channels) +
+                     "_s" + std::to_string(spec.seed);
+  if (spec.kind == Kind::BinaryBlobs || spec.kind == Kind::NearBinary)
+    name += "_t" + std::to_string(spec.thickness);
+  return name + ".png";
+}
+
+std::vector<Spec> corpus(const std::vector<cv::Size> &sizes, const std::vector<int> &channels,
+                         const std::vector<Kind> &kinds, std::uint64_t seed) {
+  std::vector<Spec> specs;
+  for (const cv::Size &size : sizes) {
+    for (int channelCount : channels) {
+      for (Kind kind : kinds) {
+        Spec spec;
+        spec.kind = kind;
+        spec.size = size;
+        spec.channels = channelCount;
+        spec.seed = seed;
+        specs.push_back(spec);
+      }
+    }
+  }
+  return specs;
+}
+
+std::vector<std::string> writeCorpus(const std::string &directory,
+                                     const std::vector<Spec> &specs) {
+  std::filesystem::create_directories(directory);
+  std::vector<std::string> paths;
+  for (const Spec &spec : specs) {
+    std::string path = (std::filesystem::path(directory) / fileName(spec)).string();
+    if (!cv::imwrite(path, generate(spec)))
+      throw std::runtime_error("Failed to write " + path);
+    paths.push_back(path);
+  }
+  return paths;
+}
+} // namespace synthetic
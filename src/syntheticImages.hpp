@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Reproducible images for benchmarks and stress tests. Every pixel depends only on the seed and
+// its position, so images are generated in parallel and are the same regardless of the number
+// of threads or the order in which they're generated.
+namespace synthetic {
+enum class Kind {
+  // uniformly random values in every channel
+  Noise,
+  // smooth ramps, horizontal, vertical and diagonal in consecutive channels
+  Gradient,
+  // dark glyph-like strokes on a bright background
+  TextEdges,
+  // white curves of a given thickness on black, suitable for skeletonization
+  BinaryBlobs,
+  // binary blobs with a small fraction of pixels off by one, which makes toBinary reject them
+  NearBinary,
+};
+
+struct Spec {
+  Kind kind = Kind::Noise;
+  cv::Size size{1024, 1024};
+  int channels = 1;
+  std::uint64_t seed = 0;
+  // width of the strokes of BinaryBlobs and NearBinary
+  int thickness = 5;
+  // fraction of pixels of NearBinary that aren't 0 or 255
+  double defectFraction = 1e-6;
+};
+
+// counter-based generator, returns the `counter`-th random number of the stream `seed`
+inline std::uint64_t random(std::uint64_t seed, std::uint64_t counter) {
+  // splitmix64 finalizer applied to the position in the stream
+  std::uint64_t z = seed * 0xD1B54A32D192ED03ull + (counter + 1) * 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+cv::Mat generate(const Spec &spec);
+
+std::string toString(Kind kind);
+std::optional<Kind> kindFromString(const std::string &name);
+const std::vector<Kind> &allKinds();
+
+// file name describing the spec, e.g. "noise_1024x768_c3_s42.png"
+std::string fileName(const Spec &spec);
+
+// every combination of the given sizes, channel counts and kinds
+std::vector<Spec> corpus(const std::vector<cv::Size> &sizes, const std::vector<int> &channels,
+                         const std::vector<Kind> &kinds, std::uint64_t seed);
+// generates the images one by one and writes them into `directory`,
+// returns the paths of the written files, throws std::runtime_error if any can't be written
+std::vector<std::string> writeCorpus(const std::string &directory, const std::vector<Spec> &specs);
+} // namespace synthetic
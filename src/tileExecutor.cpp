@@ -0,0 +1,80 @@
+#include "tileExecutor.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace {
+std::size_t l2CacheBytes() {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+  long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (size > 0)
+    return static_cast<std::size_t>(size);
+#endif
+  return 1 << 20;
+}
+
+cv::Rect grow(const cv::Rect &rect, int by) {
+  return {rect.x - by, rect.y - by, rect.width + 2 * by, rect.height + 2 * by};
+}
+} // namespace
+
+TileExecutor::TileExecutor(std::vector<TileStage> stages) : stages(std::move(stages)) {
+  for (const TileStage &stage : this->stages)
+    halo += stage.halo;
+}
+
+int TileExecutor::defaultTileSide(const cv::Mat &mat, int halo) {
+  // half of the cache for the input and output of a stage, the rest is left for the kernels
+  double bytesPerPixel = 2.0 * 2.0 * static_cast<double>(mat.elemSize());
+  int side = static_cast<int>(std::sqrt(l2CacheBytes() / bytesPerPixel)) - 2 * halo;
+  return std::max({side, 2 * halo, 32});
+}
+
+cv::Mat TileExecutor::run(const cv::Mat &mat) const { return run(mat, 0); }
+
+cv::Mat TileExecutor::run(const cv::Mat &mat, int tileSide) const {
+  if (stages.empty() || mat.empty())
+    return mat.clone();
+  if (tileSide <= 0)
+    tileSide = defaultTileSide(mat, halo);
+
+  const int tilesX = (mat.cols + tileSide - 1) / tileSide;
+  const int tilesY = (mat.rows + tileSide - 1) / tileSide;
+
+  // the output type is only known after the first tile has been processed
+  cv::Mat dst;
+  std::once_flag allocated;
+  cv::parallel_for_(cv::Range(0, tilesX * tilesY), [&](const cv::Range &range) {
+    for (int i = range.start; i < range.end; ++i) {
+      int x = (i % tilesX) * tileSide, y = (i / tilesX) * tileSide;
+      cv::Rect tile(x, y, std::min(tileSide, mat.cols - x), std::min(tileSide, mat.rows - y));
+      cv::Mat out = runTile(mat, tile);
+      std::call_once(allocated, [&]() { dst.create(mat.size(), out.type()); });
+      CV_Assert(out.type() == dst.type());
+      out.copyTo(dst(tile));
+    }
+  });
+  return dst;
+}
+
+cv::Mat TileExecutor::runTile(const cv::Mat &mat, const cv::Rect &tile) const {
+  const cv::Rect bounds(0, 0, mat.cols, mat.rows);
+  int remaining = halo;
+  cv::Rect region = grow(tile, remaining) & bounds;
+  cv::Mat current = mat(region);
+
+  for (const TileStage &stage : stages) {
+    cv::Mat out = stage.apply(current);
+    CV_Assert(out.size() == current.size());
+
+    // pixels closer than the stage's halo to a cut (not the image edge) are wrong, drop them
+    remaining -= stage.halo;
+    cv::Rect next = grow(tile, remaining) & bounds;
+    current = out(next - region.tl());
+    region = next;
+  }
+  return current;
+}
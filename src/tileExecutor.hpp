@@ -0,0 +1,38 @@
+#pragma once
+
+#include <functional>
+#include <opencv2/core.hpp>
+#include <vector>
+
+// single step of a chain run by the TileExecutor
+struct TileStage {
+  // how far from an output pixel the stage reads its input, on every side
+  int halo = 0;
+  // must return an image of the same size as its input
+  std::function<cv::Mat(const cv::Mat &)> apply;
+};
+
+// Runs a chain of neighbourhood operations block by block instead of one operation at a time
+// over the whole image, so intermediate results stay in cache and are never allocated at full
+// size. Every block is extended by the halos of all remaining stages, which are then cut off as
+// the chain progresses, making the result identical to running the stages one after another.
+// Blocks touching the image edge keep that edge, so border extrapolation also stays the same.
+class TileExecutor {
+public:
+  explicit TileExecutor(std::vector<TileStage> stages);
+
+  // sum of halos of all stages
+  int getHalo() const { return halo; }
+
+  cv::Mat run(const cv::Mat &mat) const;
+  // tileSide of 0 picks it based on the size of the L2 cache
+  cv::Mat run(const cv::Mat &mat, int tileSide) const;
+
+  static int defaultTileSide(const cv::Mat &mat, int halo);
+
+private:
+  cv::Mat runTile(const cv::Mat &mat, const cv::Rect &tile) const;
+
+  std::vector<TileStage> stages;
+  int halo = 0;
+};
@@ -0,0 +1,215 @@
+#include "trace.hpp"
+
+#ifdef APO_TRACING
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+namespace {
+struct Event {
+  const char *name;
+  std::uint64_t start;
+  std::uint64_t duration;
+  allocations::Counters allocated;
+  perfCounters::Sample counters;
+};
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(int id) : id(id), name("thread " + std::to_string(id)) {}
+
+  // only contended while the trace is being written
+  std::mutex mutex;
+  int id;
+  std::string name;
+  // written only by the owning thread
+  std::atomic<const char *> active = nullptr;
+  std::vector<Event> events;
+  // position of the oldest event once the buffer is full
+  std::size_t next = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  // buffers of the running threads
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  // buffers of the most recently exited threads, oldest first, so that their events can still be
+  // written
+  std::deque<std::shared_ptr<ThreadBuffer>> retired;
+  int nextId = 1;
+};
+
+Registry &registry() {
+  static Registry *registry = new Registry; // never destroyed, threads may outlive statics
+  return *registry;
+}
+
+// registers the buffer of its thread and retires it once the thread exits
+struct ThreadOwner {
+  ThreadOwner() {
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+    buffer = std::make_shared<ThreadBuffer>(reg.nextId++);
+    reg.buffers.push_back(buffer);
+  }
+
+  ~ThreadOwner() {
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+    reg.buffers.erase(std::find(reg.buffers.begin(), reg.buffers.end(), buffer));
+    reg.retired.push_back(std::move(buffer));
+    if (reg.retired.size() > RETIRED_THREADS)
+      reg.retired.pop_front();
+  }
+
+  std::shared_ptr<ThreadBuffer> buffer;
+};
+
+ThreadBuffer &threadBuffer() {
+  thread_local ThreadOwner owner;
+  return *owner.buffer;
+}
+
+std::uint64_t now() {
+  static const auto epoch = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                              epoch)
+      .count();
+}
+
+// writes the arguments shown for the selected event, if there are any
+void writeArgs(std::ofstream &out, const Event &event) {
+  bool first = true;
+  auto arg = [&](const char *name, auto value) {
+    out << (first ? ",\"args\":{\"" : ",\"") << name << "\":" << value;
+    first = false;
+  };
+  if (event.allocated.count > 0) {
+    arg("allocations", event.allocated.count);
+    arg("allocatedBytes", event.allocated.bytes);
+    arg("peakBytes", event.allocated.peak);
+  }
+  const perfCounters::Sample &counters = event.counters;
+  if (counters.cycles)
+    arg("cycles", counters.cycles.value());
+  if (counters.instructions)
+    arg("instructions", counters.instructions.value());
+  if (counters.ipc())
+    arg("ipc", counters.ipc().value());
+  if (counters.cacheMisses)
+    arg("cacheMisses", counters.cacheMisses.value());
+  if (counters.branchMisses)
+    arg("branchMisses", counters.branchMisses.value());
+  if (!first)
+    out << "}";
+}
+
+void writeEscaped(std::ofstream &out, const std::string &text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out << '\\';
+    if (static_cast<unsigned char>(c) >= 0x20)
+      out << c;
+  }
+}
+} // namespace
+
+Scope::Scope(const char *name)
+    : name(name), parent(threadBuffer().active.exchange(name)), start(now()),
+      counters(perfCounters::isEnabled() ? perfCounters::read() : perfCounters::Sample()) {}
+
+Scope::~Scope() {
+  perfCounters::Sample counted;
+  if (perfCounters::isEnabled())
+    counted = perfCounters::difference(counters, perfCounters::read());
+  std::uint64_t end = now();
+  Event event{name, start, end - start, allocated.stop(), counted};
+  ThreadBuffer &buffer = threadBuffer();
+  buffer.active.store(parent);
+  std::lock_guard lock(buffer.mutex);
+  if (buffer.events.size() < EVENTS_PER_THREAD) {
+    buffer.events.push_back(event);
+  } else {
+    buffer.events[buffer.next] = event;
+    buffer.next = (buffer.next + 1) % EVENTS_PER_THREAD;
+  }
+}
+
+bool isCompiledIn() { return true; }
+
+const std::atomic<const char *> &activeScope() { return threadBuffer().active; }
+
+void setThreadName(const std::string &name) {
+  ThreadBuffer &buffer = threadBuffer();
+  std::lock_guard lock(buffer.mutex);
+  buffer.name = name;
+}
+
+bool writeChromeTrace(const std::string &path) {
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  {
+    Registry &reg = registry();
+    std::lock_guard lock(reg.mutex);
+    buffers.assign(reg.retired.begin(), reg.retired.end());
+    buffers.insert(buffers.end(), reg.buffers.begin(), reg.buffers.end());
+  }
+
+  std::ofstream out(path);
+  if (!out)
+    return false;
+  // the default precision would switch to the exponent notation after a few minutes
+  out << std::fixed << std::setprecision(3);
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &buffer : buffers) {
+    std::lock_guard lock(buffer->mutex);
+    out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+        << buffer->id << ",\"args\":{\"name\":\"";
+    writeEscaped(out, buffer->name);
+    out << "\"}}";
+    first = false;
+
+    for (const Event &event : buffer->events) {
+      out << ",\n{\"name\":\"";
+      writeEscaped(out, event.name);
+      // timestamps are in microseconds
+      out << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+          << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0;
+      writeArgs(out, event);
+      out << "}";
+    }
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+void writeToEnvironmentPath() {
+  const char *path = std::getenv(PATH_VARIABLE);
+  if (path != nullptr && *path != '\0')
+    writeChromeTrace(path);
+}
+} // namespace trace
+
+#else
+
+namespace trace {
+Scope::Scope(const char *name) : name(name), parent(nullptr), start(0) {}
+Scope::~Scope() {}
+bool isCompiledIn() { return false; }
+const std::atomic<const char *> &activeScope() {
+  static const std::atomic<const char *> none = nullptr;
+  return none;
+}
+void setThreadName(const std::string &) {}
+bool writeChromeTrace(const std::string &) { return false; }
+void writeToEnvironmentPath() {}
+} // namespace trace
+
+#endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "allocations.hpp"
+#include "perfCounters.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped tracing of where the time goes, exported in the Chrome trace event format which can be
+// opened in chrome://tracing or https://ui.perfetto.dev.
+//
+// Every thread records into its own ring buffer of the most recent events, so recording is cheap
+// and tracing can stay on all the time. Building without APO_TRACING defined removes the
+// TRACE_* macros completely.
+namespace trace {
+// number of the most recent events kept for every thread
+const std::size_t EVENTS_PER_THREAD = 1 << 16;
+// number of the most recently exited threads whose events are kept
+const std::size_t RETIRED_THREADS = 16;
+// environment variable with a path the trace is written to when the program exits
+const char *const PATH_VARIABLE = "APO_TRACE";
+
+// records the time between its construction and destruction, the pixels allocated in the
+// meantime if allocations are counted and hardware counters if APO_PERF_COUNTERS is set,
+// `name` has to outlive the program, e.g. a string literal
+class Scope {
+public:
+  explicit Scope(const char *name);
+  ~Scope();
+  Scope(const Scope &) = delete;
+  Scope &operator=(const Scope &) = delete;
+
+private:
+  const char *name;
+  // scope active on the thread before this one
+  const char *parent;
+  std::uint64_t start;
+  allocations::Measurement allocated;
+  perfCounters::Sample counters;
+};
+
+bool isCompiledIn();
+// name shown for the calling thread in the trace
+void setThreadName(const std::string &name);
+// innermost scope currently active on the calling thread, can be read from any other thread for
+// as long as the calling thread runs, always null without APO_TRACING
+const std::atomic<const char *> &activeScope();
+// writes events of all threads, returns false if the file couldn't be written
+bool writeChromeTrace(const std::string &path);
+// writes the trace to the path from APO_TRACE if it's set
+void writeToEnvironmentPath();
+} // namespace trace
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef APO_TRACING
+#define TRACE_SCOPE(name) ::trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#endif
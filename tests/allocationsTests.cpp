@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+#include <optional>
+
+#include "../src/allocations.hpp"
+
+class AllocationsTest : public ::testing::Test {
+protected:
+  void SetUp() override { allocations::install(); }
+
+  void TearDown() override {}
+};
+
+TEST_F(AllocationsTest, CountsMatrices) {
+  allocations::Measurement measurement;
+  cv::Mat kept(100, 100, CV_8UC1);
+  {
+    cv::Mat temporary(200, 200, CV_8UC3);
+  }
+  allocations::Counters counters = measurement.stop();
+  EXPECT_EQ(counters.count, 2u);
+  EXPECT_EQ(counters.bytes, 100u * 100 + 200 * 200 * 3);
+  EXPECT_EQ(counters.peak, 100 * 100 + 200 * 200 * 3);
+  EXPECT_EQ(counters.growth, 100 * 100);
+}
+
+TEST_F(AllocationsTest, IgnoresUserData) {
+  std::vector<uchar> data(64 * 64);
+  allocations::Measurement measurement;
+  cv::Mat wrapped(64, 64, CV_8UC1, data.data());
+  cv::Mat header = wrapped(cv::Rect(0, 0, 32, 32));
+  EXPECT_EQ(measurement.stop().count, 0u);
+}
+
+TEST_F(AllocationsTest, NestedMeasurementsKeepTheOuterPeak) {
+  allocations::Measurement outer;
+  {
+    cv::Mat first(1000, 1000, CV_8UC1);
+  }
+  allocations::Measurement inner;
+  cv::Mat second(10, 10, CV_8UC1);
+  EXPECT_EQ(inner.stop().peak, 10 * 10);
+  allocations::Counters counters = outer.stop();
+  EXPECT_EQ(counters.count, 2u);
+  EXPECT_EQ(counters.peak, 1000 * 1000);
+}
+
+TEST_F(AllocationsTest, OverlappingMeasurementsKeepTheirOwnPeaks) {
+  std::optional<allocations::Measurement> first(std::in_place);
+  {
+    cv::Mat large(1000, 1000, CV_8UC1);
+  }
+  allocations::Measurement second;
+  cv::Mat small(10, 10, CV_8UC1);
+  // stopped before the measurement started after it, which a shared peak would have reset
+  EXPECT_EQ(first->stop().peak, 1000 * 1000);
+  first.reset();
+  EXPECT_EQ(second.stop().peak, 10 * 10);
+}
+
+TEST_F(AllocationsTest, ExternalAllocations) {
+  allocations::Measurement measurement;
+  allocations::recordExternal(1234);
+  allocations::Counters counters = measurement.stop();
+  EXPECT_EQ(counters.count, 1u);
+  EXPECT_EQ(counters.bytes, 1234u);
+  EXPECT_EQ(counters.growth, 0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/autoThreshold.hpp"
+
+class AutoThresholdTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+
+  cv::RNG rng{13};
+
+  // two blobs of values around random means on a noisy background
+  cv::Mat bimodalMat(int rows, int cols) {
+    cv::Mat mat(rows, cols, CV_8UC1);
+    int low = rng.uniform(20, 100), high = rng.uniform(140, 230);
+    double spread = rng.uniform(3., 25.);
+    for (int y = 0; y < rows; ++y)
+      for (int x = 0; x < cols; ++x) {
+        double v = (rng.uniform(0., 1.) < 0.3 ? high : low) + rng.gaussian(spread);
+        mat.at<uchar>(y, x) = cv::saturate_cast<uchar>(v);
+      }
+    return mat;
+  }
+
+  static std::vector<int> histogram(const cv::Mat &mat) {
+    std::vector<int> hist(256, 0);
+    for (int y = 0; y < mat.rows; ++y)
+      for (int x = 0; x < mat.cols * mat.channels(); ++x)
+        hist[mat.ptr<uchar>(y)[x]]++;
+    return hist;
+  }
+
+  // sum of w * mu² of the classes `thresholds` split the values into
+  static double classScore(const std::vector<int> &hist, const std::vector<int> &thresholds) {
+    double score = 0;
+    int a = 0;
+    for (std::size_t k = 0; k <= thresholds.size(); ++k) {
+      int b = k < thresholds.size() ? thresholds[k] : 255;
+      double w = 0, s = 0;
+      for (int v = a; v <= b; ++v) {
+        w += hist[v];
+        s += static_cast<double>(v) * hist[v];
+      }
+      if (w > 0)
+        score += s * s / w;
+      a = b + 1;
+    }
+    return score;
+  }
+};
+
+TEST_F(AutoThresholdTest, OtsuMatchesOpenCV) {
+  for (int i = 0; i < 50; ++i) {
+    cv::Mat mat = bimodalMat(64, 64);
+    cv::Mat out;
+    double expected = cv::threshold(mat, out, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+    EXPECT_EQ(autoThreshold::threshold(histogram(mat), autoThreshold::Method::Otsu), expected);
+  }
+}
+
+TEST_F(AutoThresholdTest, TriangleMatchesOpenCV) {
+  for (int i = 0; i < 50; ++i) {
+    cv::Mat mat = bimodalMat(64, 64);
+    cv::Mat out;
+    double expected = cv::threshold(mat, out, 0, 255, cv::THRESH_BINARY | cv::THRESH_TRIANGLE);
+    EXPECT_EQ(autoThreshold::threshold(histogram(mat), autoThreshold::Method::Triangle), expected);
+  }
+}
+
+TEST_F(AutoThresholdTest, MethodsSplitSeparatedModes) {
+  // two narrow peaks with nothing in between
+  std::vector<int> hist(256, 0);
+  for (int d = -5; d <= 5; ++d) {
+    hist[60 + d] = 1000 - 150 * std::abs(d);
+    hist[190 + d] = 600 - 90 * std::abs(d);
+  }
+  for (autoThreshold::Method method :
+       {autoThreshold::Method::Otsu, autoThreshold::Method::Li, autoThreshold::Method::Yen,
+        autoThreshold::Method::Huang, autoThreshold::Method::Mean}) {
+    SCOPED_TRACE(autoThreshold::toString(method));
+    // between the centres of the peaks, some methods cut off a tail of one of them
+    int t = autoThreshold::threshold(hist, method);
+    EXPECT_GE(t, 60);
+    EXPECT_LT(t, 190);
+  }
+}
+
+TEST_F(AutoThresholdTest, HuangMinimizesFuzzyEntropy) {
+  // entropy of the memberships of all values split at t, straight from Huang & Wang
+  auto fuzzyEntropy = [](const std::vector<int> &hist, int t, int first, int last) {
+    double entropy = 0;
+    for (auto [a, b] : {std::pair(first, t), std::pair(t + 1, last)}) {
+      double count = 0, sum = 0;
+      for (int v = a; v <= b; ++v) {
+        count += hist[v];
+        sum += static_cast<double>(v) * hist[v];
+      }
+      for (int v = a; v <= b; ++v) {
+        double mu = 1. / (1. + std::abs(v - sum / count) / (last - first));
+        if (hist[v] > 0 && mu < 1)
+          entropy += (-mu * std::log(mu) - (1 - mu) * std::log(1 - mu)) * hist[v];
+      }
+    }
+    return entropy;
+  };
+
+  for (int i = 0; i < 20; ++i) {
+    std::vector<int> hist = histogram(bimodalMat(64, 64));
+    int first = 0, last = 255;
+    while (hist[first] == 0)
+      ++first;
+    while (hist[last] == 0)
+      --last;
+    int expected = first;
+    for (int t = first; t < last; ++t)
+      if (fuzzyEntropy(hist, t, first, last) < fuzzyEntropy(hist, expected, first, last))
+        expected = t;
+    EXPECT_EQ(autoThreshold::threshold(hist, autoThreshold::Method::Huang), expected);
+  }
+}
+
+TEST_F(AutoThresholdTest, DegenerateHistograms) {
+  std::vector<int> empty(256, 0), constant(256, 0);
+  constant[77] = 100;
+  for (autoThreshold::Method method : autoThreshold::METHODS) {
+    SCOPED_TRACE(autoThreshold::toString(method));
+    EXPECT_EQ(autoThreshold::threshold(empty, method), 0);
+    int t = autoThreshold::threshold(constant, method);
+    EXPECT_GE(t, -1);
+    EXPECT_LE(t, 255);
+  }
+  EXPECT_THROW(autoThreshold::threshold(std::vector<int>(10, 1), autoThreshold::Method::Otsu),
+               std::invalid_argument);
+}
+
+TEST_F(AutoThresholdTest, MultiOtsuFindsTheBestSplit) {
+  for (int i = 0; i < 5; ++i) {
+    std::vector<int> hist(256);
+    for (int &count : hist)
+      count = rng.uniform(0, 1000);
+    std::vector<int> thresholds = autoThreshold::multiOtsu(hist, 3);
+    ASSERT_EQ(thresholds.size(), 2u);
+    EXPECT_LT(thresholds[0], thresholds[1]);
+
+    double best = 0;
+    for (int t1 = 0; t1 < 255; ++t1)
+      for (int t2 = t1 + 1; t2 < 255; ++t2)
+        best = std::max(best, classScore(hist, {t1, t2}));
+    EXPECT_NEAR(classScore(hist, thresholds), best, best * 1e-12);
+  }
+}
+
+TEST_F(AutoThresholdTest, MultiOtsuOfTwoClassesIsOtsu) {
+  for (int i = 0; i < 20; ++i) {
+    std::vector<int> hist = histogram(bimodalMat(64, 64));
+    std::vector<int> thresholds = autoThreshold::multiOtsu(hist, 2);
+    ASSERT_EQ(thresholds.size(), 1u);
+    // values between the modes may give the same split, so the scores are compared
+    int otsu = autoThreshold::threshold(hist, autoThreshold::Method::Otsu);
+    double score = classScore(hist, {otsu});
+    EXPECT_NEAR(classScore(hist, thresholds), score, score * 1e-12);
+  }
+}
+
+TEST_F(AutoThresholdTest, MultiOtsuSeparatesModes) {
+  std::vector<int> hist(256, 0);
+  for (int mode : {30, 100, 170, 240})
+    for (int d = -3; d <= 3; ++d)
+      hist[mode + d] = 100;
+  std::vector<int> thresholds = autoThreshold::multiOtsu(hist, 4);
+  ASSERT_EQ(thresholds.size(), 3u);
+  EXPECT_TRUE(thresholds[0] >= 33 && thresholds[0] < 97);
+  EXPECT_TRUE(thresholds[1] >= 103 && thresholds[1] < 167);
+  EXPECT_TRUE(thresholds[2] >= 173 && thresholds[2] < 237);
+  EXPECT_THROW(autoThreshold::multiOtsu(hist, 1), std::invalid_argument);
+}
+
+TEST_F(AutoThresholdTest, LevelsAreEvenlySpaced) {
+  std::vector<uchar> binary = autoThreshold::levelsLUT({100});
+  EXPECT_EQ(binary[100], 0);
+  EXPECT_EQ(binary[101], 255);
+
+  std::vector<uchar> levels = autoThreshold::levelsLUT({50, 150});
+  EXPECT_EQ(levels[0], 0);
+  EXPECT_EQ(levels[50], 0);
+  EXPECT_EQ(levels[51], 128);
+  EXPECT_EQ(levels[150], 128);
+  EXPECT_EQ(levels[151], 255);
+}
+
+TEST_F(AutoThresholdTest, ApplyMatchesPerChannelLUTs) {
+  cv::Mat mat(37, 53, CV_8UC3);
+  rng.fill(mat, cv::RNG::UNIFORM, 0, 256);
+
+  // the same threshold for every channel is the same as cv::threshold
+  cv::Mat expected;
+  cv::threshold(mat, expected, 90, 255, cv::THRESH_BINARY);
+  EXPECT_EQ(cv::norm(autoThreshold::apply(mat, {{90}, {90}, {90}}), expected, cv::NORM_INF), 0);
+
+  std::vector<std::vector<int>> thresholds = {{40}, {10, 200}, {-1}};
+  cv::Mat out = autoThreshold::apply(mat, thresholds);
+  ASSERT_EQ(out.type(), mat.type());
+  for (int c = 0; c < 3; ++c) {
+    std::vector<uchar> lut = autoThreshold::levelsLUT(thresholds[c]);
+    for (int y = 0; y < mat.rows; ++y)
+      for (int x = 0; x < mat.cols; ++x)
+        ASSERT_EQ(out.at<cv::Vec3b>(y, x)[c], lut[mat.at<cv::Vec3b>(y, x)[c]]);
+  }
+
+  EXPECT_THROW(autoThreshold::apply(mat, {{90}}), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include <QDir>
+#include <QTemporaryDir>
+
+#include "../src/batch.hpp"
+#include "../src/operations.hpp"
+
+class BatchTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+};
+
+TEST_F(BatchTest, ParseStep) {
+  auto step = batch::parseStep("blurGaussian:3, 4,1.5");
+  ASSERT_TRUE(step.has_value());
+  EXPECT_EQ(step->operation, "blurGaussian");
+  ASSERT_EQ(step->params.size(), 3);
+  EXPECT_EQ(step->params.at(2).toDouble(), 1.5);
+
+  auto noParams = batch::parseStep("equalize");
+  ASSERT_TRUE(noParams.has_value());
+  EXPECT_TRUE(noParams->params.isEmpty());
+
+  EXPECT_FALSE(batch::parseStep("foo:1"));
+  EXPECT_FALSE(batch::parseStep("blurMean:5,x"));
+}
+
+TEST_F(BatchTest, ProcessesEveryImage) {
+  QTemporaryDir input, output;
+  ASSERT_TRUE(input.isValid() && output.isValid());
+
+  std::vector<cv::Mat> mats;
+  for (int i = 0; i < 12; ++i) {
+    cv::Mat mat(32, 48, CV_8UC1);
+    cv::randu(mat, 0, 256);
+    ASSERT_TRUE(cv::imwrite(QDir(input.path()).filePath(QString("%1.png").arg(i)).toStdString(),
+                            mat));
+    mats.push_back(mat);
+  }
+
+  batch::Options options;
+  options.inputDir = input.path();
+  options.outputDir = output.path();
+  options.pipeline.append(batch::parseStep("blurMedian:3").value());
+  options.decodeThreads = 2;
+  options.processThreads = 3;
+  options.encodeThreads = 2;
+  options.queueCapacity = 2;
+
+  batch::Summary summary = batch::run(options);
+  EXPECT_EQ(summary.processed, 12);
+  EXPECT_EQ(summary.failed, 0);
+
+  for (int i = 0; i < 12; ++i) {
+    cv::Mat result = cv::imread(
+        QDir(output.path()).filePath(QString("%1.png").arg(i)).toStdString(), cv::IMREAD_ANYCOLOR);
+    ASSERT_FALSE(result.empty());
+    EXPECT_EQ(cv::norm(result, operations::blurMedian(mats[i], 3), cv::NORM_INF), 0);
+  }
+}
+
+TEST_F(BatchTest, FailsImagesItCantProcess) {
+  QTemporaryDir input, output;
+  ASSERT_TRUE(input.isValid() && output.isValid());
+  QDir inputDir(input.path());
+
+  cv::Mat gray(16, 16, CV_8UC1, cv::Scalar(100));
+  ASSERT_TRUE(cv::imwrite(inputDir.filePath("a.png").toStdString(), gray));
+  // a.bmp would be written to the same a.png
+  ASSERT_TRUE(cv::imwrite(inputDir.filePath("a.bmp").toStdString(), gray));
+  // 4 channels aren't supported
+  cv::Mat bgra(16, 16, CV_8UC4, cv::Scalar(1, 2, 3, 4));
+  ASSERT_TRUE(cv::imwrite(inputDir.filePath("b.png").toStdString(), bgra));
+
+  batch::Options options;
+  options.inputDir = input.path();
+  options.outputDir = output.path();
+  options.format = "png";
+  options.pipeline.append(batch::parseStep("negate").value());
+
+  batch::Summary summary = batch::run(options);
+  EXPECT_EQ(summary.processed, 1);
+  EXPECT_EQ(summary.failed, 2);
+  // files are taken in the order of their names, the first one is kept
+  cv::Mat result =
+      cv::imread(QDir(output.path()).filePath("a.png").toStdString(), cv::IMREAD_ANYCOLOR);
+  ASSERT_FALSE(result.empty());
+  EXPECT_EQ(result.at<uchar>(0, 0), 155);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
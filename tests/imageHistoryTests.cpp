@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/imageHistory.hpp"
+#include "../src/imageProcessor.hpp"
+#include "../src/imageWrapper.hpp"
+
+class ImageHistoryTest : public ::testing::Test {
+protected:
+  void SetUp() override { ImageHistory::setMemoryBudget(64 * 1024 * 1024); }
+
+  void TearDown() override {}
+};
+
+namespace {
+bool matsEqual(const cv::Mat &a, const cv::Mat &b) {
+  if (a.size() != b.size() || a.type() != b.type())
+    return false;
+  cv::Mat diff;
+  cv::compare(a, b, diff, cv::CMP_NE);
+  return cv::countNonZero(diff.reshape(1)) == 0;
+}
+} // namespace
+
+TEST_F(ImageHistoryTest, UndoRedoPartialChange) {
+  cv::Mat before(600, 700, CV_8UC3);
+  cv::randu(before, 0, 256);
+  cv::Mat after = before.clone();
+  cv::rectangle(after, cv::Rect(10, 300, 50, 50), cv::Scalar(1, 2, 3), cv::FILLED);
+
+  ImageHistory history;
+  history.push(ImageWrapper(before), ImageWrapper(after));
+  ASSERT_TRUE(history.canUndo());
+
+  auto undone = history.undo(ImageWrapper(after));
+  ASSERT_TRUE(undone.has_value());
+  EXPECT_TRUE(matsEqual(undone->getMat(), before));
+  ASSERT_TRUE(history.canRedo());
+
+  auto redone = history.redo(undone.value());
+  ASSERT_TRUE(redone.has_value());
+  EXPECT_TRUE(matsEqual(redone->getMat(), after));
+}
+
+TEST_F(ImageHistoryTest, UndoFormatChange) {
+  cv::Mat bgr(100, 100, CV_8UC3);
+  cv::randu(bgr, 0, 256);
+  ImageWrapper before(bgr);
+  ImageWrapper after = before.toGrayscale();
+
+  ImageHistory history;
+  history.push(before, after);
+
+  auto undone = history.undo(after);
+  ASSERT_TRUE(undone.has_value());
+  EXPECT_EQ(undone->getFormat(), PixelFormat::BGR24);
+  EXPECT_TRUE(matsEqual(undone->getMat(), bgr));
+}
+
+TEST_F(ImageHistoryTest, InvertibleLUTStoresNoPixels) {
+  cv::Mat mat(2000, 2000, CV_8UC1);
+  cv::randu(mat, 0, 256);
+  auto lut = imageProcessor::negate();
+  ImageWrapper before(mat);
+  ImageWrapper after = imageProcessor::applyLUT(before, lut);
+
+  std::size_t usedBefore = ImageHistory::getUsedMemory();
+  ImageHistory history;
+  history.pushLUT(before, after, lut);
+  EXPECT_LT(ImageHistory::getUsedMemory() - usedBefore, std::size_t(4096));
+
+  auto undone = history.undo(after);
+  ASSERT_TRUE(undone.has_value());
+  EXPECT_TRUE(matsEqual(undone->getMat(), mat));
+}
+
+TEST_F(ImageHistoryTest, UndoingLUTDerivesHistograms) {
+  cv::Mat mat(100, 100, CV_8UC1);
+  cv::randu(mat, 0, 256);
+  auto lut = imageProcessor::negate();
+  ImageWrapper before(mat);
+  ImageWrapper after = imageProcessor::applyLUT(before, lut);
+  after.getStats()->setHistograms(imageProcessor::channelHistograms(after.getMat()));
+
+  ImageHistory history;
+  history.pushLUT(before, after, lut);
+  auto undone = history.undo(after);
+  ASSERT_TRUE(undone.has_value());
+  auto histograms = undone->getStats()->cachedHistograms();
+  ASSERT_TRUE(histograms.has_value());
+  EXPECT_EQ(histograms.value(), imageProcessor::channelHistograms(mat));
+}
+
+TEST_F(ImageHistoryTest, BudgetDropsOldestSteps) {
+  ImageHistory::setMemoryBudget(1024 * 1024);
+  ImageHistory history;
+  ImageWrapper current(cv::Mat(1000, 1000, CV_8UC1, cv::Scalar(0)));
+  for (int i = 0; i < 10; ++i) {
+    cv::Mat noise(1000, 1000, CV_8UC1);
+    cv::randu(noise, 0, 256);
+    ImageWrapper next(noise);
+    history.push(current, next);
+    current = next;
+  }
+  EXPECT_LE(ImageHistory::getUsedMemory(), ImageHistory::getMemoryBudget());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
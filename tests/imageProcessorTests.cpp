@@ -68,6 +68,92 @@ TEST_F(ImageProcessorTest, ApplyNegateLUT) {
   ASSERT_EQ(negationMat.at<uchar>(0, 3), 255 - testData[3]);
 }
 
+TEST_F(ImageProcessorTest, HistogramsFollowLUT) {
+  cv::Mat testMat(64, 64, CV_8UC3);
+  cv::randu(testMat, 0, 256);
+  ImageWrapper image(testMat);
+  image.getStats()->setHistograms(imageProcessor::channelHistograms(image.getMat()));
+
+  for (const LUT &lut : {imageProcessor::negate(), imageProcessor::posterize(5),
+                         imageProcessor::stretch(30, 200, 0, 255)}) {
+    ImageWrapper result = imageProcessor::applyLUT(image, lut);
+    auto derived = result.getStats()->cachedHistograms();
+    ASSERT_TRUE(derived.has_value());
+    EXPECT_EQ(derived.value(), imageProcessor::channelHistograms(result.getMat()));
+  }
+}
+
+TEST_F(ImageProcessorTest, HistogramsAreOnlyDerivedFromKnownOnes) {
+  cv::Mat testMat(8, 8, CV_8UC1, cv::Scalar(3));
+  ImageWrapper image(testMat);
+  ImageWrapper result = imageProcessor::applyLUT(image, imageProcessor::negate());
+  EXPECT_FALSE(result.getStats()->cachedHistograms().has_value());
+}
+
+TEST_F(ImageProcessorTest, ChannelOperationsUseImageStats) {
+  cv::Mat testMat(50, 40, CV_8UC3);
+  cv::randu(testMat, 30, 200);
+  ImageWrapper image(testMat);
+
+  ImageWrapper normalized = imageProcessor::normalizeChannels(image);
+  EXPECT_EQ(cv::norm(normalized.getMat(), imageProcessor::normalizeChannels(testMat),
+                     cv::NORM_INF),
+            0);
+  ImageWrapper equalized = imageProcessor::equalizeChannels(image);
+  EXPECT_EQ(cv::norm(equalized.getMat(), imageProcessor::equalizeChannels(testMat),
+                     cv::NORM_INF),
+            0);
+  // both were computed from the same histograms, which the results got too
+  EXPECT_EQ(image.getStats()->getScans(), 1);
+  auto derived = equalized.getStats()->cachedHistograms();
+  ASSERT_TRUE(derived.has_value());
+  EXPECT_EQ(derived.value(), imageProcessor::channelHistograms(equalized.getMat()));
+}
+
+TEST_F(ImageProcessorTest, SampledHistogramsStayWithinTheirBound) {
+  // smooth content with noise, so the sample has something to miss
+  cv::Mat testMat(1500, 2000, CV_8UC3);
+  cv::randn(testMat, cv::Scalar(60, 128, 190), cv::Scalar(20, 40, 10));
+  for (int y = 0; y < testMat.rows; ++y) {
+    cv::Mat row = testMat.row(y);
+    row += cv::Scalar::all(y / 20);
+  }
+
+  auto sampled = imageProcessor::sampleHistograms(testMat, 1 << 16);
+  auto exact = imageProcessor::channelHistograms(testMat);
+  ASSERT_EQ(sampled.hists.size(), 3u);
+  EXPECT_GE(sampled.samples, 1u << 16);
+  EXPECT_GT(sampled.cdfError, 0);
+  EXPECT_LT(sampled.cdfError, 0.01);
+
+  for (int c = 0; c < 3; ++c) {
+    long long sampledTotal = 0, exactTotal = 0, total = static_cast<long long>(testMat.total());
+    double worst = 0;
+    for (int v = 0; v < 256; ++v) {
+      sampledTotal += sampled.hists[c][v];
+      exactTotal += exact[c][v];
+      worst = std::max(worst, std::abs(static_cast<double>(sampledTotal - exactTotal)) / total);
+    }
+    EXPECT_NEAR(static_cast<double>(sampledTotal), total, total * 1e-3);
+    EXPECT_LE(worst, sampled.cdfError) << "channel " << c;
+  }
+
+  // small images are counted exactly
+  cv::Mat small = testMat(cv::Rect(0, 0, 100, 100));
+  auto counted = imageProcessor::sampleHistograms(small, 1 << 16);
+  EXPECT_EQ(counted.cdfError, 0);
+  EXPECT_EQ(counted.hists, imageProcessor::channelHistograms(small));
+}
+
+TEST_F(ImageProcessorTest, NormalizeLUTMatchesMinMax) {
+  cv::Mat testMat(30, 30, CV_8UC1);
+  cv::randu(testMat, 40, 170);
+  LUT lut = imageProcessor::normalizeLUT(imageProcessor::histogram(testMat));
+  EXPECT_EQ(cv::norm(imageProcessor::applyLUTcv(testMat, lut),
+                     imageProcessor::normalizeChannels(testMat), cv::NORM_INF),
+            0);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
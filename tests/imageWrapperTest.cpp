@@ -106,6 +106,47 @@ TEST_F(ImageWrapperTest, GenerateQImage_BGR_Gradient_BIG) {
   }
 }
 
+TEST_F(ImageWrapperTest, StatsAreComputedOncePerContent) {
+  cv::Mat mat(40, 30, CV_8UC3, cv::Scalar(10, 20, 30));
+  mat(cv::Rect(0, 0, 30, 10)).setTo(cv::Scalar(40, 50, 60));
+  ImageWrapper image(mat);
+
+  ImageStats::Histograms histograms = image.histograms();
+  ASSERT_EQ(histograms.size(), 3u);
+  EXPECT_EQ(histograms[0][10], 900);
+  EXPECT_EQ(histograms[2][60], 300);
+
+  // copies have the same pixels, so they share the stats
+  ImageWrapper copy(image);
+  std::vector<ImageStats::Channel> channels = copy.channelStats();
+  EXPECT_EQ(channels[1].minValue, 20);
+  EXPECT_EQ(channels[1].maxValue, 50);
+  EXPECT_DOUBLE_EQ(channels[1].mean, (20.0 * 900 + 50.0 * 300) / 1200);
+  EXPECT_EQ(image.getStats()->getScans(), 1);
+
+  // new content gets new stats
+  copy = ImageWrapper(cv::Mat(5, 5, CV_8UC3, cv::Scalar(1, 2, 3)));
+  EXPECT_EQ(copy.channelStats()[0].minValue, 1);
+  EXPECT_EQ(image.channelStats()[0].minValue, 10);
+}
+
+TEST_F(ImageWrapperTest, IsBinaryComesFromKnownHistograms) {
+  cv::Mat mat(20, 20, CV_8UC1, cv::Scalar(0));
+  mat(cv::Rect(5, 5, 10, 10)).setTo(255);
+  ImageWrapper image(mat);
+  image.histograms();
+
+  ASSERT_TRUE(image.toBinary().has_value());
+  EXPECT_EQ(image.toBinary()->getFormat(), PixelFormat::Binary);
+  EXPECT_EQ(image.getStats()->getScans(), 1);
+
+  mat.at<uchar>(0, 0) = 7;
+  ImageWrapper notBinary(mat);
+  EXPECT_FALSE(notBinary.toBinary().has_value());
+  EXPECT_FALSE(notBinary.isBinary());
+  EXPECT_EQ(notBinary.getStats()->getScans(), 1);
+}
+
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/integralHistogram.hpp"
+
+class IntegralHistogramTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+
+  cv::RNG rng{7};
+
+  cv::Mat randomMat(int rows, int cols, int channels) {
+    cv::Mat mat(rows, cols, CV_8UC(channels));
+    rng.fill(mat, cv::RNG::UNIFORM, 0, 256);
+    return mat;
+  }
+
+  static std::vector<std::vector<int>> countPixels(const cv::Mat &mat, cv::Rect rect) {
+    rect &= cv::Rect(0, 0, mat.cols, mat.rows);
+    std::vector<std::vector<int>> hists(mat.channels(), std::vector<int>(256, 0));
+    for (int y = rect.y; y < rect.y + rect.height; ++y)
+      for (int x = rect.x; x < rect.x + rect.width; ++x)
+        for (int c = 0; c < mat.channels(); ++c)
+          hists[c][mat.ptr<uchar>(y)[x * mat.channels() + c]]++;
+    return hists;
+  }
+};
+
+TEST_F(IntegralHistogramTest, MatchesCountedPixels) {
+  for (int i = 0; i < 100; ++i) {
+    int channels = rng.uniform(0, 2) == 0 ? 1 : 3;
+    cv::Mat mat = randomMat(rng.uniform(1, 120), rng.uniform(1, 120), channels);
+    int tileSide = rng.uniform(1, 50);
+    IntegralHistogram index(mat, tileSide);
+
+    for (int q = 0; q < 20; ++q) {
+      // partly outside of the image now and then
+      cv::Rect rect(rng.uniform(-5, mat.cols), rng.uniform(-5, mat.rows),
+                    rng.uniform(0, mat.cols + 10), rng.uniform(0, mat.rows + 10));
+      SCOPED_TRACE("image " + std::to_string(i) + ", tile side " + std::to_string(tileSide));
+      ASSERT_EQ(index.histograms(rect), countPixels(mat, rect))
+          << rect.x << ", " << rect.y << ", " << rect.width << "x" << rect.height;
+    }
+    ASSERT_EQ(index.histograms(cv::Rect(0, 0, mat.cols, mat.rows)),
+              countPixels(mat, cv::Rect(0, 0, mat.cols, mat.rows)));
+  }
+}
+
+TEST_F(IntegralHistogramTest, WorksOnViews) {
+  cv::Mat full = randomMat(200, 150, 3);
+  cv::Mat view = full(cv::Rect(13, 27, 101, 77));
+  IntegralHistogram index(view, 16);
+  cv::Rect rect(5, 9, 80, 60);
+  EXPECT_EQ(index.histograms(rect), countPixels(view, rect));
+}
+
+TEST_F(IntegralHistogramTest, MeanMatchesOpenCV) {
+  cv::Mat mat = randomMat(300, 200, 3);
+  IntegralHistogram index(mat);
+  cv::Rect rect(17, 40, 150, 222);
+  cv::Scalar expected = cv::mean(mat(rect));
+  std::vector<double> mean = index.mean(rect);
+  ASSERT_EQ(mean.size(), 3u);
+  for (int c = 0; c < 3; ++c)
+    EXPECT_NEAR(mean[c], expected[c], 1e-9);
+
+  EXPECT_EQ(index.mean(cv::Rect(500, 500, 10, 10)), std::vector<double>(3, 0));
+}
+
+TEST_F(IntegralHistogramTest, KeepsOnlyTileCorners) {
+  cv::Mat mat = randomMat(1000, 1000, 1);
+  IntegralHistogram index(mat, 32);
+  // 33 x 33 corners with 256 counts each
+  EXPECT_EQ(index.getBytes(), 33u * 33u * 256u * sizeof(int));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "../src/interactionLatency.hpp"
+#include <QFile>
+#include <QTemporaryDir>
+
+class InteractionLatencyTest : public ::testing::Test {
+protected:
+  void SetUp() override { interactionLatency::clear(); }
+
+  void TearDown() override { interactionLatency::clear(); }
+};
+
+TEST_F(InteractionLatencyTest, NearestRankPercentiles) {
+  std::vector<double> values;
+  for (int i = 100; i >= 1; i--)
+    values.push_back(i);
+  interactionLatency::Percentiles p = interactionLatency::percentiles(values);
+  EXPECT_EQ(p.count, 100u);
+  EXPECT_DOUBLE_EQ(p.p50, 50);
+  EXPECT_DOUBLE_EQ(p.p95, 95);
+  EXPECT_DOUBLE_EQ(p.p99, 99);
+  EXPECT_DOUBLE_EQ(p.max, 100);
+
+  interactionLatency::Percentiles single = interactionLatency::percentiles({7});
+  EXPECT_DOUBLE_EQ(single.p50, 7);
+  EXPECT_DOUBLE_EQ(single.p99, 7);
+  EXPECT_EQ(interactionLatency::percentiles({}).count, 0u);
+}
+
+TEST_F(InteractionLatencyTest, SummarizesEveryDialogSeparately) {
+  for (int i = 1; i <= 10; i++)
+    interactionLatency::record("Blur", {1.0 * i, 2.0 * i, 3.0 * i});
+  interactionLatency::record("Canny", {5, 6, 7});
+
+  std::vector<interactionLatency::Summary> summaries = interactionLatency::summarize();
+  ASSERT_EQ(summaries.size(), 2u);
+  EXPECT_EQ(summaries[0].dialog, "Blur");
+  EXPECT_EQ(summaries[0].painted.count, 10u);
+  EXPECT_DOUBLE_EQ(summaries[0].computed.p50, 5);
+  EXPECT_DOUBLE_EQ(summaries[0].converted.p50, 10);
+  EXPECT_DOUBLE_EQ(summaries[0].painted.max, 30);
+  EXPECT_EQ(summaries[1].dialog, "Canny");
+  EXPECT_DOUBLE_EQ(summaries[1].painted.p99, 7);
+}
+
+TEST_F(InteractionLatencyTest, KeepsMostRecentSamples) {
+  for (std::size_t i = 0; i < interactionLatency::SAMPLES_PER_DIALOG; i++)
+    interactionLatency::record("Blur", {1000, 1000, 1000});
+  for (std::size_t i = 0; i < interactionLatency::SAMPLES_PER_DIALOG; i++)
+    interactionLatency::record("Blur", {1, 1, 1});
+
+  std::vector<interactionLatency::Summary> summaries = interactionLatency::summarize();
+  ASSERT_EQ(summaries.size(), 1u);
+  EXPECT_EQ(summaries[0].painted.count, interactionLatency::SAMPLES_PER_DIALOG);
+  EXPECT_DOUBLE_EQ(summaries[0].painted.max, 1);
+}
+
+TEST_F(InteractionLatencyTest, WritesReport) {
+  interactionLatency::record("Gaussian \"blur\"", {1, 2, 3});
+
+  QTemporaryDir dir;
+  QString path = dir.filePath("latency.csv");
+  ASSERT_TRUE(interactionLatency::writeReport(path.toStdString()));
+  QFile file(path);
+  ASSERT_TRUE(file.open(QIODevice::ReadOnly));
+  QStringList lines = QString(file.readAll()).split('\n', Qt::SkipEmptyParts);
+  ASSERT_EQ(lines.size(), 4);
+  EXPECT_EQ(lines[0], "dialog,stage,count,p50_ms,p95_ms,p99_ms,max_ms");
+  EXPECT_EQ(lines[1], "\"Gaussian \"\"blur\"\"\",computed,1,1.000,1.000,1.000,1.000");
+  EXPECT_EQ(lines[3], "\"Gaussian \"\"blur\"\"\",painted,1,3.000,3.000,3.000,3.000");
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/imageProcessor.hpp"
+#include "../src/imageWrapper.hpp"
+#include "../src/kernels.hpp"
+#include "../src/operations.hpp"
+
+// Fuzzes the optimized kernels against the reference ones on random sizes, channel counts and
+// views into bigger images, whose rows aren't continuous.
+class KernelDifferentialTest : public ::testing::Test {
+protected:
+  void SetUp() override { kernels::setVerification(0); }
+
+  void TearDown() override { kernels::setVerification(0); }
+
+  static const int ITERATIONS = 300;
+  cv::RNG rng{42};
+
+  cv::Mat randomMat(int channels) {
+    // now and then wider than the blocks the kernels work in
+    int maxCols = rng.uniform(0, 10) == 0 ? 2100 : 70;
+    int rows = rng.uniform(1, 40), cols = rng.uniform(1, maxCols);
+    cv::Mat full(rows + 7, cols + 13, CV_8UC(channels));
+    rng.fill(full, cv::RNG::UNIFORM, 0, 256);
+    cv::Mat view = full(cv::Rect(rng.uniform(0, 14), rng.uniform(0, 8), cols, rows));
+    return rng.uniform(0, 2) == 0 ? view : view.clone();
+  }
+
+  // mostly 0 and 255, sometimes with a single other value
+  cv::Mat randomBinaryMat() {
+    cv::Mat mat = randomMat(1);
+    cv::threshold(mat, mat, 127, 255, cv::THRESH_BINARY);
+    if (rng.uniform(0, 2) == 0)
+      mat.at<uchar>(rng.uniform(0, mat.rows), rng.uniform(0, mat.cols)) = rng.uniform(1, 255);
+    return mat;
+  }
+
+  imageProcessor::LUT randomLUT() {
+    imageProcessor::LUT lut(256);
+    for (auto &v : lut)
+      v = static_cast<uchar>(rng.uniform(0, 256));
+    return lut;
+  }
+
+  // inverse of a random transformation close to the identity
+  std::vector<double> randomInverse() {
+    return {rng.uniform(0.5, 1.5),  rng.uniform(-0.5, 0.5), rng.uniform(-10.0, 10.0),
+            rng.uniform(-0.5, 0.5), rng.uniform(0.5, 1.5),  rng.uniform(-10.0, 10.0)};
+  }
+
+  static std::size_t rowLength(const cv::Mat &mat) {
+    return static_cast<std::size_t>(mat.cols) * mat.channels();
+  }
+};
+
+TEST_F(KernelDifferentialTest, RowKernelsMatchReference) {
+  const kernels::KernelTable &reference = kernels::reference();
+  for (const kernels::Implementation &impl : kernels::implementations()) {
+    const kernels::KernelTable &k = *impl.table;
+    for (int i = 0; i < ITERATIONS; ++i) {
+      SCOPED_TRACE(std::string(impl.name) + ", iteration " + std::to_string(i));
+      int channels = rng.uniform(1, 5);
+      cv::Mat mat = randomMat(channels);
+      imageProcessor::LUT lut = randomLUT();
+      auto threshold = static_cast<uchar>(rng.uniform(0, 256));
+      cv::Mat binary = randomBinaryMat();
+      std::vector<double> inverse = randomInverse();
+      kernels::WarpSource source{mat.data, mat.step[0], mat.cols, mat.rows, channels};
+
+      for (int y = 0; y < mat.rows; ++y) {
+        std::size_t n = rowLength(mat);
+        const uchar *row = mat.ptr<uchar>(y);
+        std::vector<uchar> expected(n), actual(n);
+
+        reference.applyLUT(row, expected.data(), n, lut.data());
+        k.applyLUT(row, actual.data(), n, lut.data());
+        ASSERT_EQ(actual, expected) << "applyLUT, row " << y;
+
+        std::vector<int> expectedHist(256, 0), actualHist(256, 0);
+        reference.histogram(row, n, 1, n, expectedHist.data());
+        k.histogram(row, n, 1, n, actualHist.data());
+        ASSERT_EQ(actualHist, expectedHist) << "histogram, row " << y;
+
+        if (channels == 3) {
+          std::vector<int> expectedHist3(3 * 256, 0), actualHist3(3 * 256, 0);
+          reference.histogram3(row, mat.cols, 1, n, expectedHist3.data());
+          k.histogram3(row, mat.cols, 1, n, actualHist3.data());
+          ASSERT_EQ(actualHist3, expectedHist3) << "histogram3, row " << y;
+        }
+
+        reference.threshold(row, expected.data(), n, threshold, 255);
+        k.threshold(row, actual.data(), n, threshold, 255);
+        ASSERT_EQ(actual, expected) << "threshold " << int(threshold) << ", row " << y;
+
+        if (channels == 1 || channels == 3) {
+          std::fill(expected.begin(), expected.end(), 7);
+          std::fill(actual.begin(), actual.end(), 7);
+          reference.warpAffineRow(source, inverse.data(), y, expected.data(), mat.cols);
+          k.warpAffineRow(source, inverse.data(), y, actual.data(), mat.cols);
+          ASSERT_EQ(actual, expected) << "warpAffineRow, row " << y;
+        }
+      }
+
+      // the whole view at once, skipping the bytes between its rows
+      std::vector<int> expectedHist(3 * 256, 0), actualHist(3 * 256, 0);
+      reference.histogram(mat.data, rowLength(mat), mat.rows, mat.step[0], expectedHist.data());
+      k.histogram(mat.data, rowLength(mat), mat.rows, mat.step[0], actualHist.data());
+      ASSERT_EQ(actualHist, expectedHist) << "histogram of " << mat.rows << " rows";
+      if (channels == 3) {
+        reference.histogram3(mat.data, mat.cols, mat.rows, mat.step[0], expectedHist.data());
+        k.histogram3(mat.data, mat.cols, mat.rows, mat.step[0], actualHist.data());
+        ASSERT_EQ(actualHist, expectedHist) << "histogram3 of " << mat.rows << " rows";
+      }
+
+      for (int y = 0; y < binary.rows; ++y) {
+        const uchar *row = binary.ptr<uchar>(y);
+        ASSERT_EQ(k.isBinary(row, binary.cols), reference.isBinary(row, binary.cols))
+            << "isBinary, row " << y;
+      }
+    }
+  }
+}
+
+TEST_F(KernelDifferentialTest, ImageProcessorMatchesOpenCV) {
+  for (int i = 0; i < ITERATIONS; ++i) {
+    SCOPED_TRACE("iteration " + std::to_string(i));
+    int channels = std::vector<int>{1, 3, 4}[rng.uniform(0, 3)];
+    cv::Mat mat = randomMat(channels);
+
+    imageProcessor::LUT lut = randomLUT();
+    cv::Mat expected;
+    cv::LUT(mat, lut, expected);
+    ASSERT_EQ(cv::norm(imageProcessor::applyLUTcv(mat, lut), expected, cv::NORM_INF), 0);
+
+    int threshold = rng.uniform(-5, 260);
+    cv::threshold(mat, expected, threshold, 255, cv::THRESH_BINARY);
+    ASSERT_EQ(cv::norm(operations::thresholdManual(mat, threshold), expected, cv::NORM_INF), 0);
+
+    cv::Mat gray = mat.channels() == 1 ? mat : randomMat(1);
+    std::vector<int> expectedHist(256, 0);
+    for (int y = 0; y < gray.rows; ++y)
+      for (int x = 0; x < gray.cols; ++x)
+        expectedHist[gray.at<uchar>(y, x)]++;
+    ASSERT_EQ(imageProcessor::histogram(gray), expectedHist);
+
+    if (channels == 3) {
+      std::vector<cv::Mat> planes;
+      cv::split(mat, planes);
+      std::vector<std::vector<int>> expectedHists;
+      for (const cv::Mat &plane : planes)
+        expectedHists.push_back(imageProcessor::histogram(plane));
+      ASSERT_EQ(imageProcessor::channelHistograms(mat), expectedHists);
+    } else if (channels == 4) {
+      ASSERT_TRUE(imageProcessor::channelHistograms(mat).empty());
+    }
+
+    cv::Mat binary = randomBinaryMat();
+    bool isBinary = cv::countNonZero((binary != 0) & (binary != 255)) == 0;
+    ASSERT_EQ(ImageWrapper(binary).toBinary().has_value(), isBinary);
+  }
+}
+
+TEST_F(KernelDifferentialTest, VerificationFindsNoMismatches) {
+  kernels::setVerification(1);
+  kernels::VerificationStats before = kernels::getVerificationStats();
+  for (int i = 0; i < ITERATIONS / 10; ++i) {
+    cv::Mat mat = randomMat(rng.uniform(0, 2) == 0 ? 1 : 3);
+    imageProcessor::applyLUTcv(mat, randomLUT());
+    operations::thresholdManual(mat, rng.uniform(0, 255));
+    imageProcessor::affineTransform(
+        mat, {{0, 0}, {10, 0}, {0, 10}},
+        {{rng.uniform(-2.f, 2.f), rng.uniform(-2.f, 2.f)}, {10, rng.uniform(-2.f, 2.f)}, {0, 10}});
+    imageProcessor::histogram(randomMat(1));
+    imageProcessor::channelHistograms(randomMat(3));
+    ImageWrapper(randomBinaryMat()).toBinary();
+  }
+  kernels::VerificationStats after = kernels::getVerificationStats();
+  EXPECT_GT(after.checked, before.checked);
+  EXPECT_EQ(after.mismatches, before.mismatches);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
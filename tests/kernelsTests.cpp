@@ -0,0 +1,157 @@
+#include <gtest/gtest.h>
+
+#include "../src/kernels.hpp"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using cpuDispatch::IsaLevel;
+
+class KernelsTest : public ::testing::TestWithParam<IsaLevel> {
+protected:
+  void SetUp() override {
+    if (!cpuDispatch::isSupported(GetParam()))
+      GTEST_SKIP() << cpuDispatch::name(GetParam()) << " isn't supported by this CPU";
+  }
+
+  void TearDown() override {}
+
+  const kernels::KernelTable &table() const { return kernels::forLevel(GetParam()); }
+
+  // lengths around the vector widths and the block of isBinary
+  static std::vector<std::size_t> lengths() { return {0, 1, 3, 15, 33, 64, 127, 1023, 1025, 5000}; }
+
+  static std::vector<std::uint8_t> randomBytes(std::size_t n, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::vector<std::uint8_t> bytes(n);
+    for (auto &b : bytes)
+      b = static_cast<std::uint8_t>(rng());
+    return bytes;
+  }
+};
+
+TEST_P(KernelsTest, ApplyLUT) {
+  std::vector<std::uint8_t> lut = randomBytes(256, 1);
+  for (std::size_t n : lengths()) {
+    std::vector<std::uint8_t> src = randomBytes(n, n), dst(n);
+    table().applyLUT(src.data(), dst.data(), n, lut.data());
+    for (std::size_t i = 0; i < n; ++i)
+      ASSERT_EQ(dst[i], lut[src[i]]) << "n = " << n << ", i = " << i;
+  }
+}
+
+TEST_P(KernelsTest, Histogram) {
+  for (std::size_t n : lengths()) {
+    std::vector<std::uint8_t> src = randomBytes(n, n);
+    std::vector<int> hist(256, 1), expected(256, 1);
+    for (std::uint8_t v : src)
+      expected[v]++;
+    table().histogram(src.data(), n, 1, n, hist.data());
+    ASSERT_EQ(hist, expected) << "n = " << n;
+  }
+}
+
+TEST_P(KernelsTest, Histogram3) {
+  for (std::size_t pixels : lengths()) {
+    std::vector<std::uint8_t> src = randomBytes(pixels * 3, pixels);
+    std::vector<int> hist(3 * 256, 1), expected(3 * 256, 1);
+    for (std::size_t i = 0; i < src.size(); ++i)
+      expected[i % 3 * 256 + src[i]]++;
+    table().histogram3(src.data(), pixels, 1, pixels * 3, hist.data());
+    ASSERT_EQ(hist, expected) << "pixels = " << pixels;
+  }
+}
+
+TEST_P(KernelsTest, HistogramOfRows) {
+  // rows padded with values that mustn't be counted
+  const std::size_t padding = 5;
+  for (std::size_t n : lengths()) {
+    for (std::size_t rows : {1, 2, 7}) {
+      std::vector<std::uint8_t> src = randomBytes((n + padding) * rows, n + rows);
+      std::vector<int> hist(256, 0), expected(256, 0);
+      std::vector<int> hist3(3 * 256, 0), expected3(3 * 256, 0);
+      for (std::size_t y = 0; y < rows; ++y)
+        for (std::size_t i = 0; i < n; ++i) {
+          expected[src[y * (n + padding) + i]]++;
+          if (i < n / 3 * 3)
+            expected3[i % 3 * 256 + src[y * (n + padding) + i]]++;
+        }
+      table().histogram(src.data(), n, rows, n + padding, hist.data());
+      ASSERT_EQ(hist, expected) << "n = " << n << ", rows = " << rows;
+      table().histogram3(src.data(), n / 3, rows, n + padding, hist3.data());
+      ASSERT_EQ(hist3, expected3) << "pixels = " << n / 3 << ", rows = " << rows;
+    }
+  }
+}
+
+TEST_P(KernelsTest, Threshold) {
+  for (std::size_t n : lengths()) {
+    std::vector<std::uint8_t> src = randomBytes(n, n), dst(n);
+    table().threshold(src.data(), dst.data(), n, 100, 200);
+    for (std::size_t i = 0; i < n; ++i)
+      ASSERT_EQ(dst[i], src[i] > 100 ? 200 : 0) << "n = " << n << ", i = " << i;
+  }
+}
+
+TEST_P(KernelsTest, IsBinary) {
+  for (std::size_t n : lengths()) {
+    std::vector<std::uint8_t> src = randomBytes(n, n);
+    for (auto &v : src)
+      v = v & 1 ? 255 : 0;
+    EXPECT_TRUE(table().isBinary(src.data(), n)) << "n = " << n;
+    if (n == 0)
+      continue;
+    for (std::uint8_t invalid : {1, 128, 254}) {
+      src[n - 1] = invalid;
+      EXPECT_FALSE(table().isBinary(src.data(), n)) << "n = " << n;
+      src[n - 1] = 0;
+    }
+  }
+}
+
+TEST_P(KernelsTest, WarpAffineRowMatchesBaseline) {
+  const int cols = 37, rows = 23;
+  const double inverse[] = {0.9, -0.2, 3.5, 0.25, 1.1, -2.25};
+  for (int channels : {1, 3}) {
+    std::vector<std::uint8_t> src = randomBytes(cols * channels * rows, channels);
+    kernels::WarpSource source{src.data(), static_cast<std::size_t>(cols * channels), cols, rows,
+                               channels};
+    for (int y = 0; y < rows; ++y) {
+      std::vector<std::uint8_t> row(cols * channels, 7), expected(cols * channels, 7);
+      table().warpAffineRow(source, inverse, y, row.data(), cols);
+      kernels::forLevel(IsaLevel::Baseline)
+          .warpAffineRow(source, inverse, y, expected.data(), cols);
+      ASSERT_EQ(row, expected) << "channels = " << channels << ", y = " << y;
+    }
+  }
+}
+
+TEST_P(KernelsTest, WarpAffineRowIdentity) {
+  const int cols = 9, rows = 4;
+  const double identity[] = {1, 0, 0, 0, 1, 0};
+  std::vector<std::uint8_t> src = randomBytes(cols * rows, 3);
+  kernels::WarpSource source{src.data(), cols, cols, rows, 1};
+  std::vector<std::uint8_t> row(cols, 0);
+  table().warpAffineRow(source, identity, 1, row.data(), cols);
+  // the last column has no right neighbour to interpolate with
+  for (int x = 0; x + 1 < cols; ++x)
+    EXPECT_EQ(row[x], src[cols + x]);
+  EXPECT_EQ(row[cols - 1], 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Levels, KernelsTest,
+                         ::testing::Values(IsaLevel::Baseline, IsaLevel::AVX2, IsaLevel::AVX512),
+                         [](const auto &info) { return std::string(cpuDispatch::name(info.param)); });
+
+TEST(CpuDispatchTest, ParsesNames) {
+  for (IsaLevel level : {IsaLevel::Baseline, IsaLevel::AVX2, IsaLevel::AVX512})
+    EXPECT_EQ(cpuDispatch::parse(cpuDispatch::name(level)), level);
+  EXPECT_FALSE(cpuDispatch::parse("sse9").has_value());
+  EXPECT_TRUE(cpuDispatch::isSupported(IsaLevel::Baseline));
+  EXPECT_TRUE(cpuDispatch::isSupported(cpuDispatch::active()));
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/autoThreshold.hpp"
+#include "../src/layerStack.hpp"
+#include "../src/operations.hpp"
+
+class LayerStackTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    mat = cv::Mat(120, 160, CV_8UC1);
+    cv::randu(mat, 0, 256);
+    layers.setBase(ImageWrapper(mat.clone()));
+  }
+
+  void TearDown() override {}
+
+  cv::Mat mat;
+  LayerStack layers;
+};
+
+TEST_F(LayerStackTest, FullScaleRenderMatchesMaterialized) {
+  layers.push({"blurMean", ParamCodec::encodeParams(std::make_tuple(5, 4))});
+  layers.push({"thresholdManual", ParamCodec::encodeParams(std::make_tuple(128))});
+  cv::Mat expected = layers.materialize().getMat();
+
+  // local operations are only evaluated around the requested area
+  cv::Rect2d area(40, 30, 50, 40);
+  auto view = layers.render(area, 1.0);
+  EXPECT_EQ(view.area, area);
+  EXPECT_EQ(view.image.getFormat(), PixelFormat::Binary);
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+
+  // equalization needs the whole image
+  layers.push({"equalize", {}});
+  view = layers.render(area, 1.0);
+  expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+}
+
+TEST_F(LayerStackTest, HistogramLayersAtTheBottomAreRenderedLocally) {
+  layers.push({"normalize", {}});
+  layers.push({"equalize", {}});
+  layers.push({"blurMean", ParamCodec::encodeParams(std::make_tuple(3, 4))});
+  cv::Rect2d area(40, 30, 50, 40);
+  auto view = layers.render(area, 1.0);
+  cv::Mat expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+
+  // the LUTs follow the layers below them
+  layers.setEnabled(0, false);
+  view = layers.render(area, 1.0);
+  expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+}
+
+TEST_F(LayerStackTest, HistogramLayersOfLargeImagesUseSampledHistograms) {
+  cv::Mat large(1200, 1000, CV_8UC1);
+  cv::randn(large, 100, 30);
+  layers.setBase(ImageWrapper(large));
+  layers.push({"equalize", {}});
+  cv::Rect2d area(500, 600, 64, 48);
+  auto view = layers.render(area, 1.0);
+  cv::Mat expected = layers.materialize().getMat();
+  // 1M samples keep the CDF within a fraction of a percent, so within a value or two
+  EXPECT_LE(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 2);
+}
+
+TEST_F(LayerStackTest, HistogramLayersUseExactHistogramsOnceKnown) {
+  cv::Mat large(1200, 1000, CV_8UC1);
+  cv::randn(large, 100, 30);
+  ImageWrapper image(large);
+  // the layers share the stats of the image they were given
+  layers.setBase(image.sharedCopy());
+  layers.push({"normalize", {}});
+  cv::Rect2d area(500, 600, 64, 48);
+  layers.render(area, 1.0);
+
+  // counted in the background while the sampled ones are shown
+  image.histograms();
+  auto view = layers.render(area, 1.0);
+  cv::Mat expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+  EXPECT_EQ(layers.topHistograms(), imageProcessor::channelHistograms(expected));
+}
+
+TEST_F(LayerStackTest, AutoThresholdLayersUseHistogramsOfTheWholeImage) {
+  cv::Mat large(1200, 1000, CV_8UC1);
+  cv::randn(large, 100, 30);
+  ImageWrapper image(large);
+  layers.setBase(image.sharedCopy());
+  // known histograms of the image are used rather than a sample
+  image.histograms();
+  EXPECT_EQ(layers.topHistograms(), imageProcessor::channelHistograms(large));
+
+  layers.setBase(ImageWrapper(mat.clone()));
+  layers.push({"equalize", {}});
+  // the preview picks its thresholds from the same histograms
+  ImageStats::Histograms hists = layers.topHistograms();
+  EXPECT_EQ(hists, imageProcessor::channelHistograms(layers.materialize().getMat()));
+
+  auto method = autoThreshold::Method::Otsu;
+  layers.push({"thresholdAuto", ParamCodec::encodeParams(std::make_tuple(method))});
+  cv::Rect2d area(40, 30, 50, 40);
+  auto view = layers.render(area, 1.0);
+  EXPECT_EQ(view.area, area);
+  EXPECT_EQ(view.image.getFormat(), PixelFormat::Binary);
+  cv::Mat expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+  expected = autoThreshold::thresholdChannels(operations::equalize(mat), hists,
+                                              autoThreshold::Method::Otsu);
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+
+  cv::Mat color(90, 110, CV_8UC3);
+  cv::randu(color, 0, 256);
+  layers.clear();
+  layers.setBase(ImageWrapper(color));
+  layers.push({"thresholdMultiOtsu", ParamCodec::encodeParams(std::make_tuple(3))});
+  view = layers.render(area, 1.0);
+  expected = layers.materialize().getMat();
+  EXPECT_EQ(cv::norm(view.image.getMat(), expected(cv::Rect(area)), cv::NORM_INF), 0);
+}
+
+TEST_F(LayerStackTest, RendersAtDisplayResolution) {
+  layers.push({"negate", {}});
+  auto view = layers.render(cv::Rect2d(0, 0, 160, 120), 0.25);
+  EXPECT_EQ(view.image.getWidth(), 40);
+  EXPECT_EQ(view.image.getHeight(), 30);
+  EXPECT_EQ(view.area, cv::Rect2d(0, 0, 160, 120));
+}
+
+TEST_F(LayerStackTest, EditingLayers) {
+  layers.push({"posterize", ParamCodec::encodeParams(std::make_tuple(2))});
+  layers.push({"negate", {}});
+  cv::Rect2d all(0, 0, 160, 120);
+  layers.render(all, 1.0);
+
+  layers.setParams(0, ParamCodec::encodeParams(std::make_tuple(4)));
+  cv::Mat expected = 255 - operations::posterize(mat, 4);
+  EXPECT_EQ(cv::norm(layers.render(all, 1.0).image.getMat(), expected, cv::NORM_INF), 0);
+
+  layers.setEnabled(1, false);
+  expected = operations::posterize(mat, 4);
+  EXPECT_EQ(cv::norm(layers.render(all, 1.0).image.getMat(), expected, cv::NORM_INF), 0);
+  EXPECT_EQ(layers.toPipeline().getSteps().size(), 1u);
+
+  layers.remove(0);
+  EXPECT_EQ(cv::norm(layers.render(all, 1.0).image.getMat(), mat, cv::NORM_INF), 0);
+
+  layers.setParams(0, {});
+  layers.setEnabled(0, true);
+  layers.push({"blurMean", ParamCodec::encodeParams(std::make_tuple(3))});
+  EXPECT_THROW(layers.render(all, 1.0), std::invalid_argument);
+}
+
+TEST_F(LayerStackTest, MaterializedUntilLayersChange) {
+  layers.push({"negate", {}});
+  cv::Mat first = layers.materialize().getMat();
+  // rendering other areas and scales doesn't change the result
+  layers.render(cv::Rect2d(10, 10, 40, 30), 0.5);
+  EXPECT_EQ(layers.materialize().getMat().data, first.data);
+
+  layers.setEnabled(0, false);
+  cv::Mat disabled = layers.materialize().getMat();
+  EXPECT_NE(disabled.data, first.data);
+  EXPECT_EQ(cv::norm(disabled, mat, cv::NORM_INF), 0);
+
+  layers.setEnabled(0, true);
+  layers.push({"posterize", ParamCodec::encodeParams(std::make_tuple(2))});
+  cv::Mat expected = operations::posterize(255 - mat, 2);
+  EXPECT_EQ(cv::norm(layers.materialize().getMat(), expected, cv::NORM_INF), 0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include "../src/perfCounters.hpp"
+#include <vector>
+
+class PerfCountersTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+};
+
+TEST_F(PerfCountersTest, MissingCountersStayMissing) {
+  perfCounters::Sample start, end;
+  start.cycles = 100;
+  end.cycles = 300;
+  start.instructions = 50;
+  end.instructions = 650;
+  end.cacheMisses = 10;
+  perfCounters::Sample counted = perfCounters::difference(start, end);
+  EXPECT_EQ(counted.cycles, 200u);
+  EXPECT_EQ(counted.instructions, 600u);
+  EXPECT_FALSE(counted.cacheMisses.has_value());
+  EXPECT_FALSE(counted.branchMisses.has_value());
+  EXPECT_DOUBLE_EQ(counted.ipc().value(), 3.0);
+  EXPECT_FALSE(counted.memoryBytesPerPixel(100).has_value());
+  EXPECT_TRUE(perfCounters::Sample().isEmpty());
+}
+
+TEST_F(PerfCountersTest, MemoryBytesPerPixel) {
+  perfCounters::Sample sample;
+  sample.cacheMisses = 1000;
+  EXPECT_DOUBLE_EQ(sample.memoryBytesPerPixel(64000).value(), 1.0);
+  EXPECT_FALSE(sample.memoryBytesPerPixel(0).has_value());
+}
+
+// counters can't be relied on in every environment, but reading them never fails
+TEST_F(PerfCountersTest, ReadingCountsWorkIfAvailable) {
+  perfCounters::Sample start = perfCounters::read();
+  std::vector<int> values(1 << 20, 1);
+  long sum = 0;
+  for (int value : values)
+    sum += value;
+  perfCounters::Sample counted = perfCounters::difference(start, perfCounters::read());
+  EXPECT_EQ(sum, 1 << 20);
+  if (counted.instructions.has_value()) {
+    EXPECT_GT(counted.instructions.value(), 1u << 20);
+  }
+  if (start.isEmpty()) {
+    EXPECT_TRUE(counted.isEmpty());
+  }
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
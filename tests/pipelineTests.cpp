@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/operations.hpp"
+#include "../src/pipeline.hpp"
+#include <QJsonObject>
+
+class PipelineTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+};
+
+TEST_F(PipelineTest, JsonRoundTrip) {
+  cv::Mat kernel = (cv::Mat_<char>(3, 3) << -1, -1, -1, 0, 0, 0, 1, 1, 1);
+  Pipeline pipeline;
+  pipeline.append({"blurGaussian", ParamCodec::encodeParams(std::make_tuple(3u, 4, 1.5))});
+  pipeline.append({"convolve", ParamCodec::encodeParams(std::make_tuple(kernel, 4))});
+
+  auto decoded = Pipeline::fromJson(pipeline.toJson());
+  ASSERT_TRUE(decoded.has_value());
+  ASSERT_EQ(decoded->getSteps().size(), 2u);
+  EXPECT_EQ(decoded->getSteps()[0].operation, "blurGaussian");
+  EXPECT_EQ(decoded->getSteps()[0].params.at(2).toDouble(), 1.5);
+
+  cv::Mat decodedKernel = ParamCodec::decode<cv::Mat>(decoded->getSteps()[1].params.at(0));
+  ASSERT_EQ(decodedKernel.type(), kernel.type());
+  EXPECT_EQ(cv::countNonZero(decodedKernel != kernel), 0);
+}
+
+TEST_F(PipelineTest, RejectsUnknownOperations) {
+  EXPECT_FALSE(Pipeline::fromJson(R"({"steps": [{"operation": "foo", "params": []}]})"));
+  EXPECT_FALSE(Pipeline::fromJson("not json"));
+}
+
+TEST_F(PipelineTest, RemoveFromReturnsTheRemovedSteps) {
+  Pipeline pipeline;
+  for (const char *operation : {"negate", "normalize", "equalize"})
+    pipeline.append({operation, {}});
+
+  EXPECT_TRUE(pipeline.removeFrom(5).empty());
+  std::vector<PipelineStep> removed = pipeline.removeFrom(1);
+  ASSERT_EQ(removed.size(), 2u);
+  EXPECT_EQ(removed[0].operation, "normalize");
+  EXPECT_EQ(removed[1].operation, "equalize");
+  ASSERT_EQ(pipeline.size(), 1u);
+  EXPECT_EQ(pipeline.getSteps()[0].operation, "negate");
+}
+
+TEST_F(PipelineTest, ApplyMatchesOperations) {
+  cv::Mat mat(64, 64, CV_8UC1);
+  cv::randu(mat, 0, 256);
+
+  Pipeline pipeline;
+  pipeline.append({"negate", {}});
+  pipeline.append({"blurMean", ParamCodec::encodeParams(std::make_tuple(3, 4))});
+  pipeline.append({"thresholdManual", ParamCodec::encodeParams(std::make_tuple(128))});
+  ImageWrapper result = pipeline.apply(ImageWrapper(mat));
+
+  cv::Mat negated = 255 - mat;
+  cv::Mat expected =
+      operations::thresholdManual(operations::blurMean(negated, 3, cv::BORDER_REFLECT_101), 128);
+  EXPECT_EQ(result.getFormat(), PixelFormat::Binary);
+  EXPECT_EQ(cv::countNonZero(result.getMat() != expected), 0);
+}
+
+TEST_F(PipelineTest, ApplyThrowsOnInvalidParams) {
+  Pipeline pipeline;
+  pipeline.append({"blurMean", ParamCodec::encodeParams(std::make_tuple(3))});
+  EXPECT_THROW(pipeline.apply(ImageWrapper(cv::Mat(8, 8, CV_8UC1, cv::Scalar(0)))),
+               std::invalid_argument);
+}
+
+TEST_F(PipelineTest, RejectsFractionalIntegers) {
+  EXPECT_EQ(ParamCodec::decode<int>(QJsonValue(3.0)), 3);
+  EXPECT_EQ(ParamCodec::decode<double>(QJsonValue(3.5)), 3.5);
+  EXPECT_THROW(ParamCodec::decode<int>(QJsonValue(3.5)), std::invalid_argument);
+  EXPECT_THROW(ParamCodec::decode<cv::BorderTypes>(QJsonValue(0.5)), std::invalid_argument);
+
+  Pipeline pipeline;
+  pipeline.append({"blurMean", QJsonArray{3.5, 4}});
+  EXPECT_THROW(pipeline.apply(ImageWrapper(cv::Mat(8, 8, CV_8UC1, cv::Scalar(0)))),
+               std::invalid_argument);
+}
+
+TEST_F(PipelineTest, RejectsMalformedMasks) {
+  auto mask = [](int rows, int cols, int type, QJsonArray data) {
+    QJsonObject object;
+    object["rows"] = rows;
+    object["cols"] = cols;
+    object["type"] = type;
+    object["data"] = data;
+    return QJsonValue(object);
+  };
+  EXPECT_EQ(ParamCodec::decode<cv::Mat>(mask(1, 2, CV_8S, {-1, 1})).type(), CV_8S);
+  for (const QJsonValue &malformed :
+       {mask(0, 0, CV_8S, {}), mask(-1, -2, CV_8S, {1, 2}), mask(1, 2, CV_8SC3, {1, 2}),
+        mask(1, 2, 42, {1, 2}), mask(2, 2, CV_8S, {1, 2, 3}), mask(1, 2, CV_8S, {1, "a"}),
+        QJsonValue(3)})
+    EXPECT_THROW(ParamCodec::decode<cv::Mat>(malformed), std::invalid_argument);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
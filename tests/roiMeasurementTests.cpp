@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/roiMeasurement.hpp"
+#include <sstream>
+
+class RoiMeasurementTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+
+  cv::RNG rng{11};
+
+  cv::Mat randomMat(int rows, int cols, int channels) {
+    cv::Mat mat(rows, cols, CV_8UC(channels));
+    rng.fill(mat, cv::RNG::UNIFORM, 0, 256);
+    return mat;
+  }
+
+  cv::Rect randomRect(const cv::Mat &mat) {
+    // partly outside of the image now and then
+    return cv::Rect(rng.uniform(-10, mat.cols), rng.uniform(-10, mat.rows),
+                    rng.uniform(1, mat.cols / 2), rng.uniform(1, mat.rows / 2));
+  }
+
+  // compares `m` with what OpenCV gives for the pixels of `mask`
+  static void expectMeasured(const cv::Mat &mat, const cv::Mat &mask,
+                             const roi::Measurement &m) {
+    ASSERT_EQ(m.area, cv::countNonZero(mask));
+    ASSERT_EQ(m.channels.size(), static_cast<std::size_t>(mat.channels()));
+    std::vector<cv::Mat> planes;
+    cv::split(mat, planes);
+    for (int c = 0; c < mat.channels(); ++c) {
+      cv::Scalar mean, stdDev;
+      cv::meanStdDev(planes[c], mean, stdDev, mask);
+      double min, max;
+      cv::minMaxLoc(planes[c], &min, &max, nullptr, nullptr, mask);
+      EXPECT_NEAR(m.channels[c].mean, mean[0], 1e-9);
+      EXPECT_NEAR(m.channels[c].stdDev, stdDev[0], 1e-6);
+      EXPECT_EQ(m.channels[c].min, min);
+      EXPECT_EQ(m.channels[c].max, max);
+      EXPECT_DOUBLE_EQ(m.channels[c].integratedDensity, cv::sum(planes[c] & mask)[0]);
+    }
+  }
+};
+
+TEST_F(RoiMeasurementTest, RectanglesMatchOpenCV) {
+  for (int channels : {1, 3}) {
+    cv::Mat mat = randomMat(rng.uniform(50, 200), rng.uniform(50, 200), channels);
+    std::vector<roi::Roi> rois;
+    for (int i = 0; i < 200; ++i)
+      rois.push_back(roi::Roi::rectangle(std::to_string(i), randomRect(mat)));
+
+    std::vector<roi::Measurement> measurements = roi::measure(mat, rois);
+    ASSERT_EQ(measurements.size(), rois.size());
+    for (std::size_t i = 0; i < rois.size(); ++i) {
+      SCOPED_TRACE("roi " + rois[i].name);
+      cv::Mat mask = cv::Mat::zeros(mat.size(), CV_8UC1);
+      mask(rois[i].rect & cv::Rect(0, 0, mat.cols, mat.rows)).setTo(255);
+      expectMeasured(mat, mask, measurements[i]);
+    }
+  }
+}
+
+TEST_F(RoiMeasurementTest, PolygonsMatchOpenCV) {
+  cv::Mat mat = randomMat(120, 160, 3);
+  std::vector<roi::Roi> rois;
+  for (int i = 0; i < 50; ++i) {
+    std::vector<cv::Point> polygon;
+    for (int p = 0; p < rng.uniform(3, 8); ++p)
+      polygon.emplace_back(rng.uniform(-10, mat.cols + 10), rng.uniform(-10, mat.rows + 10));
+    rois.push_back(roi::Roi::fromPolygon(std::to_string(i), polygon));
+  }
+  // mixed with rectangles, which are measured separately
+  rois.push_back(roi::Roi::rectangle("rect", cv::Rect(10, 10, 30, 20)));
+
+  std::vector<roi::Measurement> measurements = roi::measure(mat, rois);
+  for (std::size_t i = 0; i + 1 < rois.size(); ++i) {
+    SCOPED_TRACE("polygon " + rois[i].name);
+    cv::Mat mask = cv::Mat::zeros(mat.size(), CV_8UC1);
+    cv::fillPoly(mask, std::vector<std::vector<cv::Point>>{rois[i].polygon}, 255);
+    expectMeasured(mat, mask, measurements[i]);
+  }
+  EXPECT_EQ(measurements.back().area, 30 * 20);
+}
+
+TEST_F(RoiMeasurementTest, RoisOutsideOfImageAreEmpty) {
+  cv::Mat mat = randomMat(20, 20, 1);
+  std::vector<roi::Measurement> measurements =
+      roi::measure(mat, {roi::Roi::rectangle("out", cv::Rect(30, 30, 5, 5)),
+                         roi::Roi::fromPolygon("out", {{-5, -5}, {-1, -5}, {-1, -1}})});
+  for (const roi::Measurement &m : measurements) {
+    EXPECT_EQ(m.area, 0);
+    ASSERT_EQ(m.channels.size(), 1u);
+    EXPECT_EQ(m.channels[0].min, -1);
+    EXPECT_EQ(m.channels[0].max, -1);
+  }
+}
+
+TEST_F(RoiMeasurementTest, GridCoversArea) {
+  std::vector<roi::Roi> rois = roi::grid(cv::Rect(5, 7, 103, 51), 4, 6);
+  ASSERT_EQ(rois.size(), 24u);
+  EXPECT_EQ(rois.front().name, "r1c1");
+  EXPECT_EQ(rois.back().name, "r4c6");
+  int area = 0;
+  for (const roi::Roi &roi : rois)
+    area += roi.rect.area();
+  EXPECT_EQ(area, 103 * 51);
+  EXPECT_EQ(rois.front().rect.tl(), cv::Point(5, 7));
+  EXPECT_EQ(rois.back().rect.br(), cv::Point(108, 58));
+}
+
+TEST_F(RoiMeasurementTest, WritesCsv) {
+  cv::Mat mat(2, 2, CV_8UC3, cv::Scalar(10, 20, 30));
+  std::vector<roi::Roi> rois = {roi::Roi::rectangle("a \"b\"", cv::Rect(0, 0, 2, 1)),
+                                roi::Roi::rectangle("out", cv::Rect(5, 5, 1, 1))};
+  std::ostringstream out;
+  roi::writeCsv(out, rois, roi::measure(mat, rois), {"B", "G", "R"});
+  EXPECT_EQ(out.str(),
+            "name,type,x,y,width,height,area,"
+            "mean_B,std_dev_B,min_B,max_B,int_den_B,"
+            "mean_G,std_dev_G,min_G,max_G,int_den_G,"
+            "mean_R,std_dev_R,min_R,max_R,int_den_R\n"
+            "\"a \"\"b\"\"\",rectangle,0,0,2,1,2,"
+            "10.000,0.000,10,10,20,20.000,0.000,20,20,40,30.000,0.000,30,30,60\n"
+            "\"out\",rectangle,5,5,1,1,0,,,,,0,,,,,0,,,,,0\n");
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include "../src/stallWatchdog.hpp"
+#include <QtGlobal>
+#include <fstream>
+#include <sstream>
+
+using namespace std::chrono_literals;
+
+class StallWatchdogTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+
+  std::atomic<const char *> activeScope = nullptr;
+
+  // keeps beating like an idle event loop would for `duration`
+  static void idle(StallWatchdog &watchdog, std::chrono::milliseconds duration) {
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+      watchdog.heartbeat();
+      std::this_thread::sleep_for(2ms);
+    }
+    watchdog.heartbeat();
+  }
+};
+
+TEST_F(StallWatchdogTest, IgnoresResponsiveThread) {
+  StallWatchdog watchdog(20ms, activeScope);
+  idle(watchdog, 100ms);
+  EXPECT_TRUE(watchdog.getStalls().empty());
+}
+
+TEST_F(StallWatchdogTest, AttributesStallToOperationAndScope) {
+  StallWatchdog watchdog(20ms, activeScope);
+  idle(watchdog, 10ms);
+  watchdog.setOperation("Morphology Skeletonize");
+  activeScope = "imageProcessor::skeletonize";
+  std::this_thread::sleep_for(150ms);
+  activeScope = nullptr;
+  watchdog.heartbeat();
+  watchdog.setOperation("");
+  idle(watchdog, 50ms);
+
+  std::vector<StallWatchdog::Stall> stalls = watchdog.getStalls();
+  ASSERT_EQ(stalls.size(), 1u);
+  EXPECT_EQ(stalls[0].operation, "Morphology Skeletonize");
+  EXPECT_EQ(stalls[0].scope, "imageProcessor::skeletonize");
+  EXPECT_GE(stalls[0].duration, 150);
+}
+
+TEST_F(StallWatchdogTest, SeparatesConsecutiveStalls) {
+  StallWatchdog watchdog(20ms, activeScope);
+  watchdog.heartbeat();
+  std::this_thread::sleep_for(100ms);
+  watchdog.heartbeat();
+  std::this_thread::sleep_for(100ms);
+  idle(watchdog, 50ms);
+
+  std::vector<StallWatchdog::Stall> stalls = watchdog.getStalls();
+  ASSERT_EQ(stalls.size(), 2u);
+  EXPECT_LT(stalls[0].started, stalls[1].started);
+  EXPECT_TRUE(stalls[0].operation.empty());
+  EXPECT_TRUE(stalls[0].scope.empty());
+}
+
+TEST_F(StallWatchdogTest, WaitsForFirstHeartbeat) {
+  StallWatchdog watchdog(20ms, activeScope);
+  // e.g. the program is still starting
+  std::this_thread::sleep_for(100ms);
+  idle(watchdog, 50ms);
+  EXPECT_TRUE(watchdog.getStalls().empty());
+}
+
+TEST_F(StallWatchdogTest, RecordsStallInProgressWhenStopped) {
+  StallWatchdog watchdog(20ms, activeScope);
+  watchdog.heartbeat();
+  watchdog.setOperation("Blur");
+  std::this_thread::sleep_for(100ms);
+  watchdog.stop();
+
+  std::vector<StallWatchdog::Stall> stalls = watchdog.getStalls();
+  ASSERT_EQ(stalls.size(), 1u);
+  EXPECT_EQ(stalls[0].operation, "Blur");
+  EXPECT_GE(stalls[0].duration, 100);
+}
+
+TEST_F(StallWatchdogTest, WritesReport) {
+  std::string path = ::testing::TempDir() + "stalls.csv";
+  {
+    StallWatchdog watchdog(20ms, activeScope);
+    watchdog.heartbeat();
+    watchdog.setOperation("Filter \"Canny\"");
+    std::this_thread::sleep_for(100ms);
+    idle(watchdog, 50ms);
+    ASSERT_TRUE(watchdog.writeReport(path));
+  }
+  std::ifstream in(path);
+  std::string header, row;
+  std::getline(in, header);
+  std::getline(in, row);
+  EXPECT_EQ(header, "started_ms,duration_ms,operation,scope");
+  EXPECT_NE(row.find(",\"Filter \"\"Canny\"\"\",\"\""), std::string::npos) << row;
+}
+
+TEST_F(StallWatchdogTest, ThresholdFromEnvironment) {
+  // setenv isn't available on Windows
+  qunsetenv(StallWatchdog::THRESHOLD_VARIABLE);
+  EXPECT_EQ(StallWatchdog::thresholdFromEnvironment(), StallWatchdog::DEFAULT_THRESHOLD);
+  qputenv(StallWatchdog::THRESHOLD_VARIABLE, "50");
+  EXPECT_EQ(StallWatchdog::thresholdFromEnvironment(), 50ms);
+  qputenv(StallWatchdog::THRESHOLD_VARIABLE, "fast");
+  EXPECT_EQ(StallWatchdog::thresholdFromEnvironment(), StallWatchdog::DEFAULT_THRESHOLD);
+  qunsetenv(StallWatchdog::THRESHOLD_VARIABLE);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
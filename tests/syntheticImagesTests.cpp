@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/imageWrapper.hpp"
+#include "../src/syntheticImages.hpp"
+
+class SyntheticImagesTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override { cv::setNumThreads(-1); }
+};
+
+TEST_F(SyntheticImagesTest, Reproducible) {
+  for (synthetic::Kind kind : synthetic::allKinds()) {
+    synthetic::Spec spec;
+    spec.kind = kind;
+    spec.size = {333, 217};
+    spec.channels = 3;
+    spec.seed = 7;
+    spec.defectFraction = 1e-3;
+
+    cv::Mat parallel = synthetic::generate(spec);
+    cv::setNumThreads(1);
+    cv::Mat serial = synthetic::generate(spec);
+    cv::setNumThreads(-1);
+    ASSERT_EQ(parallel.type(), CV_8UC3) << synthetic::toString(kind);
+    EXPECT_EQ(cv::norm(parallel, serial, cv::NORM_INF), 0) << synthetic::toString(kind);
+
+    if (kind != synthetic::Kind::Gradient) {
+      spec.seed = 8;
+      EXPECT_GT(cv::norm(parallel, synthetic::generate(spec), cv::NORM_INF), 0)
+          << synthetic::toString(kind);
+    }
+  }
+}
+
+TEST_F(SyntheticImagesTest, BinaryKinds) {
+  synthetic::Spec spec;
+  spec.kind = synthetic::Kind::BinaryBlobs;
+  spec.size = {512, 512};
+  spec.thickness = 9;
+  cv::Mat blobs = synthetic::generate(spec);
+  EXPECT_GT(cv::countNonZero(blobs), 0);
+  EXPECT_TRUE(ImageWrapper(blobs).toBinary().has_value());
+
+  spec.kind = synthetic::Kind::NearBinary;
+  spec.defectFraction = 1e-4;
+  cv::Mat nearBinary = synthetic::generate(spec);
+  EXPECT_FALSE(ImageWrapper(nearBinary).toBinary().has_value());
+  // apart from the defects it's the same image
+  EXPECT_LE(cv::norm(nearBinary, blobs, cv::NORM_INF), 1);
+}
+
+TEST_F(SyntheticImagesTest, KindNames) {
+  for (synthetic::Kind kind : synthetic::allKinds())
+    EXPECT_EQ(synthetic::kindFromString(synthetic::toString(kind)), kind);
+  EXPECT_FALSE(synthetic::kindFromString("foo").has_value());
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
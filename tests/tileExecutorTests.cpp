@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <opencv2/opencv.hpp>
+
+#include "../src/imageProcessor.hpp"
+#include "../src/operations.hpp"
+#include "../src/pipeline.hpp"
+#include "../src/tileExecutor.hpp"
+
+class TileExecutorTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    mat = cv::Mat(157, 211, CV_8UC1);
+    cv::randu(mat, 0, 256);
+  }
+
+  void TearDown() override {}
+
+  cv::Mat mat;
+};
+
+TEST_F(TileExecutorTest, MatchesSequentialForEveryBorderType) {
+  const cv::Mat kernel = (cv::Mat_<char>(3, 3) << -1, -1, -1, 0, 0, 0, 1, 1, 1);
+  for (int border : {cv::BORDER_CONSTANT, cv::BORDER_REPLICATE, cv::BORDER_REFLECT,
+                     cv::BORDER_REFLECT_101, cv::BORDER_ISOLATED}) {
+    TileExecutor executor({
+        {2, [border](const cv::Mat &m) { return operations::blurGaussian(m, 5, border, 1.5); }},
+        {1, [border](const cv::Mat &m) { return operations::convolve(m, kernel, border); }},
+        {0, [](const cv::Mat &m) { return operations::thresholdManual(m, 100); }},
+        {0, [](const cv::Mat &m) {
+           return imageProcessor::applyLUTcv(m, imageProcessor::negate());
+         }},
+    });
+    EXPECT_EQ(executor.getHalo(), 3);
+
+    cv::Mat expected = imageProcessor::applyLUTcv(
+        operations::thresholdManual(
+            operations::convolve(operations::blurGaussian(mat, 5, border, 1.5), kernel, border),
+            100),
+        imageProcessor::negate());
+
+    // odd tile sizes leave partial tiles at the right and bottom edges
+    for (int tileSide : {7, 32, 1000}) {
+      cv::Mat result = executor.run(mat, tileSide);
+      ASSERT_EQ(result.size(), mat.size());
+      EXPECT_EQ(cv::norm(result, expected, cv::NORM_INF), 0)
+          << "border " << border << ", tile " << tileSide;
+    }
+  }
+}
+
+TEST_F(TileExecutorTest, MorphologyOnColourImage) {
+  cv::Mat colour(64, 97, CV_8UC3);
+  cv::randu(colour, 0, 256);
+  cv::Mat element = cv::getStructuringElement(cv::MORPH_ELLIPSE, {5, 5});
+
+  TileExecutor executor({
+      {4, [&](const cv::Mat &m) { return operations::morphologyOpen(m, element, 1); }},
+      {1, [](const cv::Mat &m) { return operations::blurMean(m, 3, 1); }},
+  });
+  cv::Mat expected = operations::blurMean(operations::morphologyOpen(colour, element, 1), 3, 1);
+  EXPECT_EQ(cv::norm(executor.run(colour, 16), expected, cv::NORM_INF), 0);
+}
+
+TEST_F(TileExecutorTest, FusedPipelineMatchesSteps) {
+  Pipeline pipeline;
+  pipeline.append({"blurMedian", ParamCodec::encodeParams(std::make_tuple(5))});
+  pipeline.append({"edgeDetectSobel", ParamCodec::encodeParams(std::make_tuple(
+                                          3, 2, operations::SobelDirection::Vertical))});
+  pipeline.append({"posterize", ParamCodec::encodeParams(std::make_tuple(4))});
+  pipeline.append({"thresholdManual", ParamCodec::encodeParams(std::make_tuple(60))});
+
+  ImageWrapper stepByStep(mat.clone());
+  for (const PipelineStep &step : pipeline.getSteps()) {
+    Pipeline single;
+    single.append(step);
+    stepByStep = single.apply(stepByStep);
+  }
+
+  ImageWrapper fused = pipeline.apply(ImageWrapper(mat.clone()));
+  EXPECT_EQ(fused.getFormat(), stepByStep.getFormat());
+  EXPECT_EQ(fused.getFormat(), PixelFormat::Binary);
+  EXPECT_EQ(cv::norm(fused.getMat(), stepByStep.getMat(), cv::NORM_INF), 0);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include "../src/trace.hpp"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <thread>
+
+class TraceTest : public ::testing::Test {
+protected:
+  void SetUp() override {}
+
+  void TearDown() override {}
+
+  // events from the trace written to a temporary file
+  static QJsonArray writeAndRead() {
+    QTemporaryDir dir;
+    QString path = dir.filePath("trace.json");
+    EXPECT_TRUE(trace::writeChromeTrace(path.toStdString()));
+    QFile file(path);
+    EXPECT_TRUE(file.open(QIODevice::ReadOnly));
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    EXPECT_EQ(error.error, QJsonParseError::NoError) << error.errorString().toStdString();
+    return document.object()["traceEvents"].toArray();
+  }
+
+  static std::vector<QJsonObject> eventsNamed(const QJsonArray &events, const QString &name) {
+    std::vector<QJsonObject> found;
+    for (const QJsonValue &event : events)
+      if (event["name"].toString() == name)
+        found.push_back(event.toObject());
+    return found;
+  }
+};
+
+TEST_F(TraceTest, NestedScopes) {
+  {
+    TRACE_SCOPE("outer");
+    TRACE_SCOPE("inner");
+  }
+  QJsonArray events = writeAndRead();
+  auto outer = eventsNamed(events, "outer");
+  auto inner = eventsNamed(events, "inner");
+  ASSERT_EQ(outer.size(), 1u);
+  ASSERT_EQ(inner.size(), 1u);
+  EXPECT_EQ(outer[0]["ph"].toString(), "X");
+  EXPECT_EQ(outer[0]["tid"].toInt(), inner[0]["tid"].toInt());
+  EXPECT_LE(outer[0]["ts"].toDouble(), inner[0]["ts"].toDouble());
+  EXPECT_GE(outer[0]["ts"].toDouble() + outer[0]["dur"].toDouble(),
+            inner[0]["ts"].toDouble() + inner[0]["dur"].toDouble());
+}
+
+TEST_F(TraceTest, EventsOfFinishedThreads) {
+  std::thread worker([]() {
+    trace::setThreadName("worker \"1\"");
+    TRACE_SCOPE("onWorker");
+  });
+  worker.join();
+
+  QJsonArray events = writeAndRead();
+  auto onWorker = eventsNamed(events, "onWorker");
+  ASSERT_EQ(onWorker.size(), 1u);
+  bool named = false;
+  for (const QJsonObject &meta : eventsNamed(events, "thread_name"))
+    if (meta["tid"].toInt() == onWorker[0]["tid"].toInt())
+      named = meta["args"]["name"].toString() == "worker \"1\"";
+  EXPECT_TRUE(named);
+}
+
+TEST_F(TraceTest, KeepsMostRecentEvents) {
+  std::thread worker([]() {
+    for (std::size_t i = 0; i < trace::EVENTS_PER_THREAD; ++i) {
+      TRACE_SCOPE("old");
+    }
+    for (std::size_t i = 0; i < 10; ++i) {
+      TRACE_SCOPE("new");
+    }
+  });
+  worker.join();
+
+  QJsonArray events = writeAndRead();
+  EXPECT_EQ(eventsNamed(events, "new").size(), 10u);
+  EXPECT_EQ(eventsNamed(events, "old").size(), trace::EVENTS_PER_THREAD - 10);
+}
+
+TEST_F(TraceTest, KeepsMostRecentlyExitedThreads) {
+  for (std::size_t i = 0; i < trace::RETIRED_THREADS + 5; ++i)
+    std::thread([i]() {
+      trace::setThreadName("short-lived " + std::to_string(i));
+      TRACE_SCOPE("shortLived");
+    }).join();
+
+  QJsonArray events = writeAndRead();
+  EXPECT_EQ(eventsNamed(events, "shortLived").size(), trace::RETIRED_THREADS);
+  std::vector<QString> names;
+  for (const QJsonObject &meta : eventsNamed(events, "thread_name"))
+    names.push_back(meta["args"]["name"].toString());
+  EXPECT_EQ(std::count(names.begin(), names.end(), "short-lived 4"), 0);
+  EXPECT_EQ(std::count(names.begin(), names.end(),
+                       QString("short-lived %1").arg(trace::RETIRED_THREADS + 4)),
+            1);
+}
+
+TEST_F(TraceTest, ActiveScopeIsVisibleFromOtherThreads) {
+  const std::atomic<const char *> &active = trace::activeScope();
+  EXPECT_EQ(active.load(), nullptr);
+  {
+    TRACE_SCOPE("outer");
+    {
+      TRACE_SCOPE("inner");
+      std::thread([&active]() { EXPECT_STREQ(active.load(), "inner"); }).join();
+    }
+    EXPECT_STREQ(active.load(), "outer");
+  }
+  EXPECT_EQ(active.load(), nullptr);
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,79 @@
+#include "../src/syntheticImages.hpp"
+#include <chrono>
+#include <iostream>
+#include <opencv2/core/utility.hpp>
+#include <sstream>
+
+// Writes a reproducible set of synthetic images, e.g.
+//   apo_corpus --out=corpus --sizes=1024x1024,8192x8192 --channels=1,3 --kinds=blobs,text
+namespace {
+template <typename T>
+std::vector<T> parseList(const std::string &list, T (*parse)(const std::string &)) {
+  std::vector<T> values;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+    if (!item.empty())
+      values.push_back(parse(item));
+  return values;
+}
+
+cv::Size parseSize(const std::string &text) {
+  std::size_t x = text.find('x');
+  if (x == std::string::npos)
+    throw std::invalid_argument("Invalid size " + text + ", expected WIDTHxHEIGHT");
+  return {std::stoi(text.substr(0, x)), std::stoi(text.substr(x + 1))};
+}
+
+int parseInt(const std::string &text) { return std::stoi(text); }
+
+synthetic::Kind parseKind(const std::string &text) {
+  auto kind = synthetic::kindFromString(text);
+  if (!kind.has_value())
+    throw std::invalid_argument("Unknown kind " + text);
+  return kind.value();
+}
+} // namespace
+
+int main(int argc, char *argv[]) {
+  const std::string keys =
+      "{help h    |                                      | print this message}"
+      "{out o     | corpus                               | output directory}"
+      "{sizes     | 1024x1024                            | comma separated WIDTHxHEIGHT}"
+      "{channels  | 1                                    | comma separated channel counts}"
+      "{kinds     | noise,gradient,text,blobs,nearbinary | comma separated kinds}"
+      "{seed      | 0                                    | seed of the random numbers}"
+      "{thickness | 5                                    | stroke width of blobs}"
+      "{defects   | 0.000001                             | fraction of nearbinary's wrong pixels}";
+  cv::CommandLineParser parser(argc, argv, keys);
+  parser.about("Generates reproducible synthetic images for benchmarks and stress tests.");
+  if (parser.has("help")) {
+    parser.printMessage();
+    return 0;
+  }
+
+  try {
+    auto specs = synthetic::corpus(parseList(parser.get<std::string>("sizes"), parseSize),
+                                   parseList(parser.get<std::string>("channels"), parseInt),
+                                   parseList(parser.get<std::string>("kinds"), parseKind),
+                                   parser.get<std::uint64_t>("seed"));
+    for (synthetic::Spec &spec : specs) {
+      spec.thickness = parser.get<int>("thickness");
+      spec.defectFraction = parser.get<double>("defects");
+    }
+    if (!parser.check()) {
+      parser.printErrors();
+      return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::string &path : synthetic::writeCorpus(parser.get<std::string>("out"), specs))
+      std::cout << path << std::endl;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Wrote " << specs.size() << " images in " << elapsed.count() << " s" << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}